@@ -0,0 +1,52 @@
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include "../src/fasthash.h"
+
+// Reports the throughput of every hash kernel supported by this CPU.
+// Usage: FastHashBench [buffer MiB] [iterations]
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const int megabytes = args.size() > 1 ? args[1].toInt() : 64;
+    const int iterations = args.size() > 2 ? args[2].toInt() : 8;
+
+    QByteArray data(qint64(megabytes) * 1024 * 1024, Qt::Uninitialized);
+    QRandomGenerator generator(42);
+    generator.fillRange(reinterpret_cast<quint32 *>(data.data()), data.size() / sizeof(quint32));
+
+    QTextStream out(stdout);
+    out << QString("%1 MiB x %2 iterations\n").arg(megabytes).arg(iterations);
+
+    auto report = [&out, &data, iterations](const QString& name, qint64 nanoseconds) {
+        const double gigabytes = double(data.size()) * iterations / 1e9;
+        out << QString("%1 %2 GB/s\n").arg(name, -10).arg(gigabytes / (nanoseconds / 1e9), 0, 'f', 2);
+    };
+
+    for (FastHash::Kernel kernel : {FastHash::Scalar, FastHash::Sse2, FastHash::Avx2}) {
+        if (!FastHash::isSupported(kernel)) {
+            out << QString("%1 unsupported\n").arg(FastHash::kernelName(kernel), -10);
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; ++i) {
+            FastHash hash(kernel);
+            hash.addData(data);
+            hash.result();
+        }
+        report(FastHash::kernelName(kernel), timer.nsecsElapsed());
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+    }
+    report("sha256", timer.nsecsElapsed());
+
+    return 0;
+}
@@ -0,0 +1,359 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "../src/fasthash.h"
+#include "../src/filemanager.h"
+#include "../src/hashengine.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+// End-to-end benchmark of the FileManagerLib hot paths on a generated
+// corpus. The corpus is fully determined by the seed and the shape options,
+// so two builds run against identical trees. Every stage is repeated and
+// reported as one JSON document on stdout with files/s, GB/s, p50/p99
+// latencies and the peak RSS; progress goes to stderr. --dir keeps the
+// corpus, and only replaces a corpus there that an earlier run generated.
+// Usage: FileManagerBench [--files N] [--min-size B] [--max-size B]
+//        [--duplicates R] [--depth D] [--fanout F] [--repeat N] [--seed S] [--dir path]
+
+namespace {
+
+// Written next to the corpus, so --dir never deletes a tree it did not make
+constexpr char MarkerName[] = ".filemanager-bench";
+
+struct CorpusOptions {
+    int files = 2000;
+    qint64 minSize = 1024;
+    qint64 maxSize = 4 * 1024 * 1024;
+    double duplicateRatio = 0.2;
+    int depth = 3;
+    int fanout = 4;
+    quint64 seed = 1;
+};
+
+struct Corpus {
+    QStringList files;
+    QVector<qint64> sizes;
+    QStringList directories;
+    qint64 totalBytes = 0;
+    int duplicates = 0;
+};
+
+// splitmix64, cheap enough to fill gigabytes of content
+class Random {
+public:
+    explicit Random(quint64 seed)
+        : state(seed)
+    {
+    }
+
+    quint64 next() {
+        quint64 z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    double uniform() {
+        return double(next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    quint64 state;
+};
+
+void fillContent(QByteArray& data, qint64 size, quint64 contentSeed) {
+    data.resize(size);
+    Random random(contentSeed);
+    qint64 i = 0;
+    for (; i + 8 <= size; i += 8) {
+        const quint64 value = random.next();
+        memcpy(data.data() + i, &value, 8);
+    }
+    const quint64 tail = random.next();
+    memcpy(data.data() + i, &tail, size_t(size - i));
+}
+
+// Files are spread over a tree of fanout^depth leaves. Sizes are log-uniform
+// between minSize and maxSize; a duplicateRatio share of the files copies an
+// earlier unique file, so size collisions and real duplicates both occur.
+Corpus generateCorpus(const QString& root, const CorpusOptions& options) {
+    Corpus corpus;
+    QDir().mkpath(root);
+    corpus.directories.append(root);
+    for (int level = 0; level < options.depth; ++level) {
+        const QStringList parents = corpus.directories.mid(corpus.directories.size()
+                                                           - int(std::pow(options.fanout, level)));
+        for (const QString& parent : parents) {
+            for (int child = 0; child < options.fanout; ++child) {
+                const QString path = QString("%1/d%2").arg(parent).arg(child);
+                QDir().mkpath(path);
+                corpus.directories.append(path);
+            }
+        }
+    }
+
+    Random random(options.seed);
+    QVector<quint64> uniqueSeeds;
+    QVector<qint64> uniqueSizes;
+    const double logMin = std::log(double(qMax<qint64>(1, options.minSize)));
+    const double logMax = std::log(double(qMax(options.minSize, options.maxSize)));
+    QByteArray data;
+
+    for (int i = 0; i < options.files; ++i) {
+        quint64 contentSeed;
+        qint64 size;
+        if (!uniqueSeeds.isEmpty() && random.uniform() < options.duplicateRatio) {
+            const int source = int(random.next() % quint64(uniqueSeeds.size()));
+            contentSeed = uniqueSeeds[source];
+            size = uniqueSizes[source];
+            ++corpus.duplicates;
+        } else {
+            contentSeed = random.next();
+            size = qint64(std::exp(logMin + (logMax - logMin) * random.uniform()));
+            uniqueSeeds.append(contentSeed);
+            uniqueSizes.append(size);
+        }
+
+        const QString& directory = corpus.directories[i % corpus.directories.size()];
+        const QString path = QString("%1/f%2.bin").arg(directory).arg(i, 6, 10, QChar('0'));
+        fillContent(data, size, contentSeed);
+        QFile file(path);
+        if (!file.open(QFile::WriteOnly) || file.write(data) != size) {
+            qFatal("Cannot write %s", qPrintable(path));
+        }
+        corpus.files.append(path);
+        corpus.sizes.append(size);
+        corpus.totalBytes += size;
+    }
+    return corpus;
+}
+
+double percentile(QVector<double> samples, double fraction) {
+    if (samples.isEmpty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    const int rank = qBound(0, int(std::ceil(fraction * samples.size())) - 1, int(samples.size()) - 1);
+    return samples[rank];
+}
+
+qint64 peakRssKiB() {
+#ifdef Q_OS_UNIX
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // Linux reports KiB, macOS bytes
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+// Durations are in milliseconds; samples are per run unless noted otherwise
+QJsonObject stageReport(const QVector<double>& runs, int files, qint64 bytes,
+                        const QVector<double>& latencies = QVector<double>()) {
+    const QVector<double>& samples = latencies.isEmpty() ? runs : latencies;
+    const double median = percentile(runs, 0.5);
+    QJsonObject stage;
+    stage["runs"] = int(runs.size());
+    stage["median_ms"] = median;
+    stage["files_per_s"] = median > 0 ? files / (median / 1000.0) : 0.0;
+    stage["gb_per_s"] = median > 0 ? bytes / 1e9 / (median / 1000.0) : 0.0;
+    stage["p50_ms"] = percentile(samples, 0.5);
+    stage["p99_ms"] = percentile(samples, 0.99);
+    stage["latency_unit"] = latencies.isEmpty() ? "run" : "item";
+    return stage;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("FileManagerBench");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption filesOption("files", "Number of files", "count", "2000");
+    const QCommandLineOption minSizeOption("min-size", "Smallest file in bytes", "bytes", "1024");
+    const QCommandLineOption maxSizeOption("max-size", "Largest file in bytes", "bytes", "4194304");
+    const QCommandLineOption duplicatesOption("duplicates", "Share of files that copy another one", "ratio", "0.2");
+    const QCommandLineOption depthOption("depth", "Directory depth", "levels", "3");
+    const QCommandLineOption fanoutOption("fanout", "Subdirectories per directory", "count", "4");
+    const QCommandLineOption repeatOption("repeat", "Runs per stage", "count", "3");
+    const QCommandLineOption seedOption("seed", "Corpus seed", "seed", "1");
+    const QCommandLineOption dirOption("dir", "Generate the corpus below this directory and keep it", "path");
+    parser.addOptions({filesOption, minSizeOption, maxSizeOption, duplicatesOption, depthOption,
+                       fanoutOption, repeatOption, seedOption, dirOption});
+    parser.process(app);
+
+    CorpusOptions options;
+    options.files = qMax(1, parser.value(filesOption).toInt());
+    options.minSize = qMax<qint64>(1, parser.value(minSizeOption).toLongLong());
+    options.maxSize = qMax(options.minSize, parser.value(maxSizeOption).toLongLong());
+    options.duplicateRatio = qBound(0.0, parser.value(duplicatesOption).toDouble(), 1.0);
+    options.depth = qMax(0, parser.value(depthOption).toInt());
+    options.fanout = qMax(1, parser.value(fanoutOption).toInt());
+    options.seed = parser.value(seedOption).toULongLong();
+    const int repeat = qMax(1, parser.value(repeatOption).toInt());
+
+    QTemporaryDir temporary;
+    const QString root = parser.isSet(dirOption) ? parser.value(dirOption) : temporary.path();
+    const QString corpusRoot = root + "/corpus";
+    // The cache is never kept, even next to a --dir corpus
+    const QString cachePath = temporary.filePath("hashcache.bin");
+    const QString markerPath = root + "/" + MarkerName;
+    QTextStream err(stderr);
+    // A corpus left by an earlier run is replaced, anything else is kept
+    if (QFileInfo::exists(corpusRoot) && !QFileInfo::exists(markerPath)) {
+        err << corpusRoot << " was not generated by this benchmark, choose another --dir\n";
+        return 1;
+    }
+    QDir(corpusRoot).removeRecursively();
+    QDir().mkpath(root);
+    QFile marker(markerPath);
+    if (!marker.open(QIODevice::WriteOnly)) {
+        err << "Cannot write " << markerPath << "\n";
+        return 1;
+    }
+    marker.close();
+
+    QElapsedTimer timer;
+    timer.start();
+    const Corpus corpus = generateCorpus(corpusRoot, options);
+    const double generateMs = timer.nsecsElapsed() / 1e6;
+    err << QString("Generated %1 files, %2 bytes in %3 ms\n")
+               .arg(corpus.files.size()).arg(corpus.totalBytes).arg(generateMs, 0, 'f', 1);
+    err.flush();
+
+    FileManager manager;
+    manager.hashCache().setFilePath(cachePath);
+    QJsonObject stages;
+
+    // Per-file latency of calculateFileHash on the engine's worker pool
+    {
+        QVector<double> runs;
+        QVector<double> latencies;
+        QMutex mutex;
+        HashEngine engine;
+        engine.setMaxThreadCount(manager.hashThreadCount());
+        for (int run = 0; run < repeat; ++run) {
+            timer.restart();
+            engine.hashFiles(corpus.files, corpus.sizes, [&](const QString& filePath, qint64) {
+                QElapsedTimer fileTimer;
+                fileTimer.start();
+                const QByteArray hash = manager.calculateFileHash(filePath);
+                const double ms = fileTimer.nsecsElapsed() / 1e6;
+                QMutexLocker locker(&mutex);
+                latencies.append(ms);
+                return hash;
+            });
+            runs.append(timer.nsecsElapsed() / 1e6);
+        }
+        stages["hash_files"] = stageReport(runs, corpus.files.size(), corpus.totalBytes, latencies);
+        err << "hash_files done\n";
+        err.flush();
+    }
+
+    // Duplicate scans without the cache, then with a warm cache
+    int groupsFound = 0;
+    for (const bool cached : {false, true}) {
+        manager.hashCache().setEnabled(cached);
+        if (cached) {
+            manager.findDuplicateGroups(corpusRoot);
+        }
+        QVector<double> runs;
+        for (int run = 0; run < repeat; ++run) {
+            timer.restart();
+            groupsFound = manager.findDuplicateGroups(corpusRoot).size();
+            runs.append(timer.nsecsElapsed() / 1e6);
+        }
+        stages[cached ? "scan_warm_cache" : "scan_cold"] =
+            stageReport(runs, corpus.files.size(), corpus.totalBytes);
+        err << (cached ? "scan_warm_cache" : "scan_cold") << " done\n";
+        err.flush();
+    }
+
+    // One batch rename per directory, alternating between two patterns so
+    // every run renames every file
+    {
+        QVector<double> runs;
+        QVector<double> latencies;
+        for (int run = 0; run < repeat; ++run) {
+            const QString pattern = run % 2 == 0 ? "renamed_%n" : "file_%n";
+            timer.restart();
+            for (const QString& directory : corpus.directories) {
+                const QFileInfoList entries = QDir(directory).entryInfoList(QDir::Files, QDir::Name);
+                QStringList files;
+                for (const QFileInfo& entry : entries) {
+                    files.append(entry.filePath());
+                }
+                if (files.isEmpty()) {
+                    continue;
+                }
+                QElapsedTimer batchTimer;
+                batchTimer.start();
+                manager.batchRename(files, pattern);
+                latencies.append(batchTimer.nsecsElapsed() / 1e6);
+            }
+            runs.append(timer.nsecsElapsed() / 1e6);
+        }
+        stages["batch_rename"] = stageReport(runs, corpus.files.size(), 0, latencies);
+        err << "batch_rename done\n";
+        err.flush();
+    }
+
+    QJsonObject corpusInfo;
+    corpusInfo["files"] = int(corpus.files.size());
+    corpusInfo["directories"] = int(corpus.directories.size());
+    corpusInfo["bytes"] = double(corpus.totalBytes);
+    corpusInfo["duplicates"] = corpus.duplicates;
+    corpusInfo["duplicate_groups_found"] = groupsFound;
+    corpusInfo["min_size"] = double(options.minSize);
+    corpusInfo["max_size"] = double(options.maxSize);
+    corpusInfo["duplicate_ratio"] = options.duplicateRatio;
+    corpusInfo["depth"] = options.depth;
+    corpusInfo["fanout"] = options.fanout;
+    corpusInfo["seed"] = QString::number(options.seed);
+    corpusInfo["generate_ms"] = generateMs;
+
+    QJsonObject environment;
+    environment["qt"] = qVersion();
+    environment["hash_kernel"] = FastHash::kernelName(FastHash::bestKernel());
+    environment["threads"] = manager.hashThreadCount();
+    environment["io_backend"] = BatchReader::backendName(BatchReader(manager.readBackend()).backend());
+    environment["cpus"] = QThread::idealThreadCount();
+    environment["repeat"] = repeat;
+    environment["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+
+    QJsonObject report;
+    report["benchmark"] = "FileManagerBench";
+    report["version"] = 2;
+    report["environment"] = environment;
+    report["corpus"] = corpusInfo;
+    report["stages"] = stages;
+    report["peak_rss_kib"] = double(peakRssKiB());
+
+    QTextStream out(stdout);
+    out << QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    return 0;
+}
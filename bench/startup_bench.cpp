@@ -0,0 +1,187 @@
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QTimer>
+#include <functional>
+#include "../src/mainwindow.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Startup cost of the FileManager window: one launch per run, timed from
+// main() through QApplication, the MainWindow constructor, the first frame
+// on screen and the deferred startup work (file model rooted, last results
+// shown), with the RSS at the first frame, after --settle ms and at peak.
+// The report is one JSON document on stdout. --max-first-frame-ms and
+// --max-rss-mib turn it into a budget check that exits with 1 when the
+// launch is over. The launch reads the same session and snapshot as the
+// application. Headless runs use QT_QPA_PLATFORM=offscreen.
+// Usage: FileManagerStartupBench [--eager] [--settle ms]
+//        [--max-first-frame-ms N] [--max-rss-mib N]
+
+namespace {
+
+constexpr int TimeoutMs = 60000;
+
+double elapsedMs(const QElapsedTimer& timer) {
+    return timer.nsecsElapsed() / 1e6;
+}
+
+qint64 peakRssKiB() {
+#ifdef Q_OS_UNIX
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // Linux reports KiB, macOS bytes
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+qint64 currentRssKiB() {
+#ifdef Q_OS_LINUX
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields[1].toLongLong() * sysconf(_SC_PAGESIZE) / 1024;
+        }
+    }
+#endif
+    return -1;
+}
+
+// Calls back once the first paint of any widget has been flushed
+class FirstFrameWatcher : public QObject {
+public:
+    explicit FirstFrameWatcher(const std::function<void()>& callback)
+        : callback(callback)
+    {
+    }
+
+    bool eventFilter(QObject *watched, QEvent *event) override {
+        if (!painted && event->type() == QEvent::Paint) {
+            painted = true;
+            // Queued behind the rest of the frame, the backing store flush included
+            QTimer::singleShot(0, this, [this]() {
+                qApp->removeEventFilter(this);
+                callback();
+            });
+        }
+        return QObject::eventFilter(watched, event);
+    }
+
+private:
+    std::function<void()> callback;
+    bool painted = false;
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QElapsedTimer clock;
+    clock.start();
+    QApplication app(argc, argv);
+    const double applicationMs = elapsedMs(clock);
+    // The application's own name, so the window finds the session and the
+    // last scan snapshot a real launch would
+    QApplication::setApplicationName("FileManager");
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption eagerOption("eager", "Start the way the window did before fast start");
+    const QCommandLineOption settleOption("settle", "Keep running after startup for ms", "ms", "1000");
+    const QCommandLineOption frameBudgetOption("max-first-frame-ms", "Fail above this time to first frame", "ms");
+    const QCommandLineOption rssBudgetOption("max-rss-mib", "Fail above this peak RSS", "MiB");
+    parser.addOptions({eagerOption, settleOption, frameBudgetOption, rssBudgetOption});
+    parser.process(app);
+    const bool eager = parser.isSet(eagerOption);
+    if (eager) {
+        qputenv("FILEMANAGER_EAGER_START", "1");
+    }
+    QTextStream err(stderr);
+
+    double firstFrameMs = -1;
+    double readyMs = -1;
+    qint64 firstFrameRss = -1;
+    FirstFrameWatcher watcher([&]() {
+        firstFrameMs = elapsedMs(clock);
+        firstFrameRss = currentRssKiB();
+    });
+    app.installEventFilter(&watcher);
+
+    MainWindow window;
+    const double windowMs = elapsedMs(clock);
+    if (eager) {
+        // Everything already ran in the constructor
+        readyMs = windowMs;
+    }
+    QObject::connect(&window, &MainWindow::startupFinished, &app, [&]() { readyMs = elapsedMs(clock); });
+    window.show();
+
+    // Wait for the frame and the deferred work, then let background work settle
+    bool timedOut = false;
+    bool settling = false;
+    QTimer poll;
+    poll.setInterval(5);
+    QObject::connect(&poll, &QTimer::timeout, &app, [&]() {
+        if (!settling && firstFrameMs >= 0 && readyMs >= 0) {
+            settling = true;
+            poll.stop();
+            QTimer::singleShot(qMax(0, parser.value(settleOption).toInt()), &app, &QApplication::quit);
+        }
+    });
+    poll.start();
+    QTimer::singleShot(TimeoutMs, &app, [&]() {
+        timedOut = true;
+        app.quit();
+    });
+    app.exec();
+
+    QJsonObject environment;
+    environment["qt"] = qVersion();
+    environment["platform"] = QGuiApplication::platformName();
+    environment["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+
+    QJsonObject report;
+    report["benchmark"] = "FileManagerStartupBench";
+    report["version"] = 1;
+    report["mode"] = eager ? "eager" : "fast";
+    report["environment"] = environment;
+    report["application_ms"] = applicationMs;
+    report["window_ms"] = windowMs;
+    report["first_frame_ms"] = firstFrameMs;
+    report["ready_ms"] = readyMs;
+    report["rss_first_frame_kib"] = double(firstFrameRss);
+    report["rss_settled_kib"] = double(currentRssKiB());
+    report["peak_rss_kib"] = double(peakRssKiB());
+
+    bool withinBudget = !timedOut;
+    if (timedOut) {
+        err << "The window did not finish starting within " << TimeoutMs << " ms\n";
+    }
+    if (parser.isSet(frameBudgetOption) && firstFrameMs > parser.value(frameBudgetOption).toDouble()) {
+        err << "First frame after " << firstFrameMs << " ms, budget " << parser.value(frameBudgetOption) << " ms\n";
+        withinBudget = false;
+    }
+    if (parser.isSet(rssBudgetOption) && peakRssKiB() > parser.value(rssBudgetOption).toLongLong() * 1024) {
+        err << "Peak RSS " << peakRssKiB() / 1024 << " MiB, budget " << parser.value(rssBudgetOption) << " MiB\n";
+        withinBudget = false;
+    }
+    report["within_budget"] = withinBudget;
+
+    QTextStream out(stdout);
+    out << QJsonDocument(report).toJson(QJsonDocument::Indented);
+    return withinBudget ? 0 : 1;
+}
@@ -0,0 +1,363 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QtEndian>
+#include <cstdio>
+#include "../src/filemanager.h"
+
+// Headless front end for scripted and nightly runs. Results are streamed to
+// stdout as they are produced, one record per duplicate group followed by a
+// final result record, either as JSON Lines or in a compact binary form:
+//
+//   "FMR1" then records of  u8 tag | payload, all integers little endian
+//   tag 1 (group):   u32 file count, per file u32 length + UTF-8 path
+//   tag 2 (result):  u8 success, u32 length + UTF-8 message
+//
+// dedup reads groups in either format, keeps the first file of each group
+// and reclaims the rest, so "scan | dedup" works as a pipeline. snapshot
+// hashes every file into a ScanSnapshot; merge combines the snapshots of
+// several hosts and reports the duplicates across them.
+//
+// --stats and --trace report where the time went, see ScanStats.
+//
+// Usage: FileManagerCli scan [options] <directory>...
+//        FileManagerCli dedup [--mode delete|hardlink|reflink] [--input file]
+//        FileManagerCli rename [--match regex] <pattern> <files...>
+//        FileManagerCli snapshot <output> <directory>...
+//        FileManagerCli merge <output> <snapshot>...
+
+namespace {
+
+constexpr char BinaryMagic[] = "FMR1";
+constexpr quint8 GroupTag = 1;
+constexpr quint8 ResultTag = 2;
+
+class ResultWriter {
+public:
+    explicit ResultWriter(bool binary)
+        : binary(binary)
+    {
+        setvbuf(stdout, nullptr, _IOFBF, 1 << 16);
+        if (binary) {
+            std::fwrite(BinaryMagic, 1, 4, stdout);
+        }
+    }
+
+    ~ResultWriter() {
+        std::fflush(stdout);
+    }
+
+    void writeGroups(const QList<QStringList>& groups) {
+        for (const QStringList& group : groups) {
+            if (binary) {
+                writeByte(GroupTag);
+                writeUInt32(quint32(group.size()));
+                for (const QString& path : group) {
+                    writeString(path);
+                }
+            } else {
+                QJsonObject record;
+                record["type"] = "group";
+                record["files"] = QJsonArray::fromStringList(group);
+                writeLine(record);
+            }
+        }
+    }
+
+    void writeResult(const QString& command, bool success, const QString& message) {
+        if (binary) {
+            writeByte(ResultTag);
+            writeByte(success ? 1 : 0);
+            writeString(message);
+        } else {
+            QJsonObject record;
+            record["type"] = "result";
+            record["command"] = command;
+            record["success"] = success;
+            record["message"] = message;
+            writeLine(record);
+        }
+        std::fflush(stdout);
+    }
+
+private:
+    void writeByte(quint8 value) {
+        std::fputc(value, stdout);
+    }
+
+    void writeUInt32(quint32 value) {
+        const quint32 little = qToLittleEndian(value);
+        std::fwrite(&little, sizeof(little), 1, stdout);
+    }
+
+    void writeString(const QString& text) {
+        const QByteArray utf8 = text.toUtf8();
+        writeUInt32(quint32(utf8.size()));
+        std::fwrite(utf8.constData(), 1, size_t(utf8.size()), stdout);
+    }
+
+    void writeLine(const QJsonObject& record) {
+        const QByteArray line = QJsonDocument(record).toJson(QJsonDocument::Compact);
+        std::fwrite(line.constData(), 1, size_t(line.size()), stdout);
+        std::fputc('\n', stdout);
+    }
+
+    bool binary;
+};
+
+bool readUInt32(QIODevice& in, quint32& value) {
+    char bytes[4];
+    if (in.read(bytes, 4) != 4) {
+        return false;
+    }
+    value = qFromLittleEndian<quint32>(bytes);
+    return true;
+}
+
+bool readString(QIODevice& in, QString& text) {
+    quint32 length = 0;
+    if (!readUInt32(in, length)) {
+        return false;
+    }
+    const QByteArray utf8 = in.read(length);
+    if (utf8.size() != qsizetype(length)) {
+        return false;
+    }
+    text = QString::fromUtf8(utf8);
+    return true;
+}
+
+// Accepts the output of "scan" in either format; result records are skipped
+bool readGroups(QIODevice& in, QList<QStringList>& groups, QString& error) {
+    if (in.peek(4) == QByteArray(BinaryMagic, 4)) {
+        in.read(4);
+        // The writer ends every stream with a result record, without it the
+        // producer was cut off and the groups are not the complete set
+        bool complete = false;
+        char tag = 0;
+        while (in.getChar(&tag)) {
+            if (tag == char(ResultTag)) {
+                QString message;
+                if (!in.getChar(&tag) || !readString(in, message)) {
+                    error = "Truncated binary input";
+                    return false;
+                }
+                complete = true;
+                continue;
+            }
+            quint32 count = 0;
+            if (tag != char(GroupTag) || !readUInt32(in, count)) {
+                error = "Malformed binary input";
+                return false;
+            }
+            QStringList group;
+            for (quint32 i = 0; i < count; ++i) {
+                QString path;
+                if (!readString(in, path)) {
+                    error = "Truncated binary input";
+                    return false;
+                }
+                group.append(path);
+            }
+            groups.append(group);
+        }
+        if (!complete) {
+            error = "Truncated binary input, no result record";
+            return false;
+        }
+        return true;
+    }
+
+    int lineNumber = 0;
+    while (!in.atEnd()) {
+        const QByteArray line = in.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty()) {
+            continue;
+        }
+        const QJsonObject record = QJsonDocument::fromJson(line).object();
+        if (record.isEmpty()) {
+            error = QString("Invalid JSON on line %1").arg(lineNumber);
+            return false;
+        }
+        if (record["type"].toString() != "group") {
+            continue;
+        }
+        QStringList group;
+        for (const QJsonValue& file : record["files"].toArray()) {
+            group.append(file.toString());
+        }
+        groups.append(group);
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("FileManagerCli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless duplicate scans, deduplication and batch renames");
+    parser.addHelpOption();
+    parser.addPositionalArgument("command", "scan, dedup, rename, snapshot or merge");
+    const QCommandLineOption formatOption("format", "Output format: jsonl (default) or binary", "format", "jsonl");
+    const QCommandLineOption similarOption("similar", "scan: group near-duplicates instead of exact copies");
+    const QCommandLineOption metadataOption("metadata", "scan: group by size and name only");
+    const QCommandLineOption contentOption("content", "scan: confirm candidates byte for byte");
+    const QCommandLineOption sha256Option("sha256", "Use SHA-256 instead of the fast 128-bit hash");
+    const QCommandLineOption threadsOption("threads", "Worker threads", "count");
+    const QCommandLineOption ioOption("io", "File reads: auto (default), io_uring or threads", "backend", "auto");
+    const QCommandLineOption indexMemoryOption("index-memory",
+        "scan: keep candidate indexes within MiB, spilling to the temp directory beyond", "MiB");
+    const QCommandLineOption flatOption("no-recursive", "scan: do not descend into subdirectories");
+    const QCommandLineOption noCacheOption("no-cache", "Do not read or update the hash cache");
+    const QCommandLineOption modeOption("mode", "dedup: delete (default), hardlink or reflink", "mode", "delete");
+    const QCommandLineOption inputOption("input", "dedup: read groups from file instead of stdin", "file");
+    const QCommandLineOption matchOption("match", "rename: regular expression whose captures %1..%9 insert", "regex");
+    const QCommandLineOption progressOption("progress", "Report progress on stderr");
+    const QCommandLineOption statsOption("stats", "Print per-stage statistics on stderr when done");
+    const QCommandLineOption traceOption("trace", "Write a Chrome trace of the run to file", "file");
+    parser.addOptions({formatOption, similarOption, metadataOption, contentOption, sha256Option,
+                       threadsOption, ioOption, indexMemoryOption, flatOption, noCacheOption, modeOption, inputOption, matchOption, progressOption,
+                       statsOption, traceOption});
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    const QString command = arguments.value(0);
+    QTextStream err(stderr);
+    auto usageError = [&err](const QString& message) {
+        err << message << "\n";
+        return 2;
+    };
+
+    const QString format = parser.value(formatOption);
+    if (format != "jsonl" && format != "binary") {
+        return usageError("Unknown format: " + format);
+    }
+
+    const QString io = parser.value(ioOption);
+    BatchReader::Backend backend = BatchReader::Backend::Auto;
+    if (io == BatchReader::backendName(BatchReader::Backend::IoUring)) {
+        backend = BatchReader::Backend::IoUring;
+    } else if (io == BatchReader::backendName(BatchReader::Backend::ThreadPool)) {
+        backend = BatchReader::Backend::ThreadPool;
+    } else if (io != BatchReader::backendName(BatchReader::Backend::Auto)) {
+        return usageError("Unknown I/O backend: " + io);
+    }
+
+    FileManager manager;
+    manager.setReadBackend(backend);
+    manager.setHashAlgorithm(parser.isSet(sha256Option) ? FileManager::HashAlgorithm::Sha256
+                                                        : FileManager::HashAlgorithm::Fast128);
+    if (parser.isSet(contentOption)) {
+        manager.setConfirmationMode(FileManager::ConfirmationMode::ConfirmByContent);
+    }
+    if (parser.isSet(threadsOption)) {
+        manager.setHashThreadCount(parser.value(threadsOption).toInt());
+    }
+    if (parser.isSet(indexMemoryOption)) {
+        bool valid = false;
+        const qint64 mebibytes = parser.value(indexMemoryOption).toLongLong(&valid);
+        if (!valid || mebibytes <= 0) {
+            return usageError("Invalid index memory limit: " + parser.value(indexMemoryOption));
+        }
+        manager.setIndexMemoryLimit(mebibytes * 1024 * 1024);
+    }
+    manager.setRecursiveScan(!parser.isSet(flatOption));
+    manager.hashCache().setEnabled(!parser.isSet(noCacheOption));
+    manager.scanStats().setTracing(parser.isSet(traceOption));
+
+    // Everything runs on this thread, so results are written as they are emitted
+    ResultWriter writer(format == "binary");
+    bool success = false;
+    QObject::connect(&manager, &FileManager::duplicateGroupsFound, &manager,
+                     [&writer](const QList<QStringList>& groups) { writer.writeGroups(groups); });
+    QObject::connect(&manager, &FileManager::operationCompleted, &manager,
+                     [&writer, &success, &command](bool ok, const QString& message) {
+                         success = ok;
+                         writer.writeResult(command, ok, message);
+                     });
+    if (parser.isSet(progressOption)) {
+        QObject::connect(&manager, &FileManager::progressUpdated, &manager, [&err](int done, int total) {
+            err << (total > 0 ? QString("%1/%2\n").arg(done).arg(total) : QString("%1\n").arg(done));
+            err.flush();
+        });
+    }
+
+    if (command == "scan") {
+        const bool singleRoot = parser.isSet(similarOption) || parser.isSet(metadataOption);
+        if (arguments.size() < 2 || (singleRoot && arguments.size() != 2)) {
+            return usageError("Usage: FileManagerCli scan [options] <directory>...");
+        }
+        if (parser.isSet(similarOption)) {
+            manager.findSimilarGroups(arguments[1]);
+        } else if (parser.isSet(metadataOption)) {
+            manager.findMetadataGroups(arguments[1]);
+        } else {
+            manager.findDuplicateGroups(arguments.mid(1));
+        }
+    } else if (command == "dedup") {
+        const QString mode = parser.value(modeOption);
+        const QStringList modes = {"delete", "hardlink", "reflink"};
+        if (!modes.contains(mode)) {
+            return usageError("Unknown mode: " + mode);
+        }
+
+        QFile in;
+        bool opened = false;
+        if (parser.isSet(inputOption)) {
+            in.setFileName(parser.value(inputOption));
+            opened = in.open(QIODevice::ReadOnly);
+        } else {
+            opened = in.open(stdin, QIODevice::ReadOnly);
+        }
+        if (!opened) {
+            return usageError("Cannot read " + (in.fileName().isEmpty() ? QString("stdin") : in.fileName()));
+        }
+        QList<QStringList> input;
+        QString error;
+        if (!readGroups(in, input, error)) {
+            return usageError(error);
+        }
+
+        QList<DuplicateRemover::Group> groups;
+        for (const QStringList& files : std::as_const(input)) {
+            if (files.size() > 1) {
+                groups.append({files.first(), files.mid(1)});
+            }
+        }
+        manager.setRemovalMode(DuplicateRemover::Mode(modes.indexOf(mode)));
+        manager.removeDuplicates(groups);
+    } else if (command == "rename") {
+        if (arguments.size() < 3) {
+            return usageError("Usage: FileManagerCli rename [--match regex] <pattern> <files...>");
+        }
+        manager.batchRename(arguments.mid(2), arguments[1], parser.value(matchOption));
+    } else if (command == "snapshot") {
+        if (arguments.size() < 3) {
+            return usageError("Usage: FileManagerCli snapshot <output> <directory>...");
+        }
+        manager.exportSnapshot(arguments.mid(2), arguments[1]);
+    } else if (command == "merge") {
+        if (arguments.size() < 3) {
+            return usageError("Usage: FileManagerCli merge <output> <snapshot>...");
+        }
+        manager.mergeSnapshots(arguments.mid(2), arguments[1]);
+    } else {
+        parser.showHelp(2);
+    }
+
+    if (parser.isSet(statsOption)) {
+        err << manager.scanStats().snapshot().summary() << "\n";
+    }
+    if (parser.isSet(traceOption) && !manager.scanStats().writeChromeTrace(parser.value(traceOption))) {
+        err << "Cannot write " << parser.value(traceOption) << "\n";
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,734 @@
+#include "batchreader.h"
+#include "scanstats.h"
+#include <QFile>
+#include <QThread>
+#include <QThreadPool>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// One aligned buffer per file slot, reused for every read of that slot
+class BufferPool {
+public:
+    BufferPool(int count, qint64 size)
+        : size(size)
+    {
+        for (int i = 0; i < count; ++i) {
+            buffers.push_back(static_cast<char *>(
+                ::operator new(size_t(size), std::align_val_t(BatchReader::BufferAlignment))));
+        }
+    }
+
+    ~BufferPool() {
+        for (char *buffer : buffers) {
+            ::operator delete(buffer, std::align_val_t(BatchReader::BufferAlignment));
+        }
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    char *at(int index) const { return buffers[size_t(index)]; }
+    int count() const { return int(buffers.size()); }
+    qint64 bufferSize() const { return size; }
+
+private:
+    std::vector<char *> buffers;
+    qint64 size;
+};
+
+// Blocking read of one whole file through buffer, used by the thread pool
+// backend and by io_uring workers whose ring could not be set up
+bool readWhole(const QString& path, char *buffer, qint64 bufferSize, ScanStats *stats,
+               const std::function<void(const char *, qint64)>& chunk,
+               const BatchReader::Checkpoint& checkpoint) {
+#ifdef Q_OS_LINUX
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    qint64 offset = 0;
+    bool ok = true;
+    for (;;) {
+        ssize_t bytes;
+        {
+            ScanStats::Scope reading(stats, ScanStats::Read);
+            bytes = ::pread(fd, buffer, size_t(bufferSize), offset);
+        }
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            ok = bytes == 0;
+            break;
+        }
+        if (stats) {
+            stats->add(ScanStats::BytesRead, quint64(bytes));
+        }
+        chunk(buffer, bytes);
+        offset += bytes;
+        if (checkpoint && !checkpoint()) {
+            ok = false;
+            break;
+        }
+    }
+    ::close(fd);
+    return ok;
+#else
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    for (;;) {
+        qint64 bytes;
+        {
+            ScanStats::Scope reading(stats, ScanStats::Read);
+            bytes = file.read(buffer, bufferSize);
+        }
+        if (bytes <= 0) {
+            return bytes == 0;
+        }
+        if (stats) {
+            stats->add(ScanStats::BytesRead, quint64(bytes));
+        }
+        chunk(buffer, bytes);
+        if (checkpoint && !checkpoint()) {
+            return false;
+        }
+    }
+#endif
+}
+
+#if defined(Q_OS_LINUX) && defined(__NR_io_uring_setup)
+#define BATCHREADER_HAVE_IO_URING
+
+// Minimal io_uring binding over the raw syscalls, enough for one thread
+// that submits and reaps its own requests
+class Ring {
+public:
+    Ring() = default;
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) {
+            ::munmap(sqes, sqesSize);
+        }
+        if (cqRing != MAP_FAILED && cqRing != sqRing) {
+            ::munmap(cqRing, cqRingSize);
+        }
+        if (sqRing != MAP_FAILED) {
+            ::munmap(sqRing, sqRingSize);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = int(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return false;
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            sqRingSize = cqRingSize = qMax(sqRingSize, cqRingSize);
+        }
+        sqRing = ::mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            return false;
+        }
+        cqRing = singleMap ? sqRing
+                           : ::mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                    fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            return false;
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+
+        char *sq = static_cast<char *>(sqRing);
+        sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        sqEntries = params.sq_entries;
+        char *cq = static_cast<char *>(cqRing);
+        cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        localTail = *sqTail;
+        return true;
+    }
+
+    // Pins the buffers so reads can use IORING_OP_READ_FIXED; fails when
+    // RLIMIT_MEMLOCK is too small, plain reads work then
+    bool registerBuffers(const BufferPool& pool) {
+        std::vector<iovec> vectors(size_t(pool.count()));
+        for (int i = 0; i < pool.count(); ++i) {
+            vectors[size_t(i)].iov_base = pool.at(i);
+            vectors[size_t(i)].iov_len = size_t(pool.bufferSize());
+        }
+        return ::syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                         vectors.data(), unsigned(vectors.size())) == 0;
+    }
+
+    bool supports(std::initializer_list<int> opcodes) const {
+        constexpr int ProbeOps = 256;
+        std::vector<char> storage(sizeof(io_uring_probe) + ProbeOps * sizeof(io_uring_probe_op), 0);
+        auto *probe = reinterpret_cast<io_uring_probe *>(storage.data());
+        if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, ProbeOps) < 0) {
+            return false;
+        }
+        for (int opcode : opcodes) {
+            if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Null when the submission queue is full
+    io_uring_sqe *nextSqe() {
+        const unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        if (localTail - head >= sqEntries) {
+            return nullptr;
+        }
+        const unsigned slot = localTail & sqMask;
+        io_uring_sqe *sqe = static_cast<io_uring_sqe *>(sqes) + slot;
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray[slot] = slot;
+        ++localTail;
+        return sqe;
+    }
+
+    // Publishes queued entries and waits for at least minComplete completions.
+    // Entries a busy ring left unconsumed are offered again.
+    int submit(unsigned minComplete) {
+        const unsigned toSubmit = localTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        __atomic_store_n(sqTail, localTail, __ATOMIC_RELEASE);
+        int result;
+        do {
+            result = int(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+                                   minComplete ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0));
+        } while (result < 0 && errno == EINTR);
+        return result < 0 ? -errno : result;
+    }
+
+    bool popCompletion(io_uring_cqe& cqe) {
+        const unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        cqe = cqes[head & cqMask];
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    int fd = -1;
+    void *sqRing = MAP_FAILED;
+    void *cqRing = MAP_FAILED;
+    void *sqes = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned localTail = 0;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe *cqes = nullptr;
+};
+
+bool ioUringAvailable() {
+    static const bool available = []() {
+        Ring ring;
+        return ring.init(4) && ring.supports({IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ,
+                                              IORING_OP_READ_FIXED, IORING_OP_CLOSE});
+    }();
+    return available;
+}
+
+// Drives the files of one worker through a private ring. Every slot owns
+// one buffer and has either its open + statx pair or a single read in
+// flight, so a slot's chunks complete in order.
+class RingWorker {
+public:
+    RingWorker(const QStringList& files, std::atomic<int>& next, std::atomic<bool>& stopped,
+               int slotCount, qint64 chunkSize, ScanStats *stats, const BatchReader::Checkpoint& checkpoint,
+               const BatchReader::ChunkHandler& chunk, const BatchReader::DoneHandler& done)
+        : files(files)
+        , next(next)
+        , stopped(stopped)
+        , stats(stats)
+        , checkpoint(checkpoint)
+        , chunk(chunk)
+        , done(done)
+        , buffers(slotCount, chunkSize)
+        , slots(size_t(slotCount))
+    {
+    }
+
+    void run() {
+        // Each slot needs at most two entries at once plus its close
+        unsigned entries = 8;
+        while (entries < unsigned(3 * slots.size() + 8)) {
+            entries <<= 1;
+        }
+        if (!ring.init(entries)) {
+            runBlocking(buffers.at(0));
+            return;
+        }
+        fixedBuffers = ring.registerBuffers(buffers);
+
+        for (size_t slot = 0; slot < slots.size(); ++slot) {
+            if (!startFile(int(slot))) {
+                break;
+            }
+        }
+
+        while (active > 0 || closing > 0) {
+            int result;
+            {
+                ScanStats::Scope waiting(stats, ScanStats::Read);
+                result = ring.submit(1);
+            }
+            if (result < 0 && result != -EBUSY && result != -EAGAIN) {
+                abandon();
+                return;
+            }
+            io_uring_cqe cqe;
+            while (ring.popCompletion(cqe)) {
+                complete(cqe);
+            }
+            if (checkpoint && !stopped.load(std::memory_order_relaxed) && !checkpoint()) {
+                stopped.store(true, std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    enum Operation : quint64 {
+        Open = 1,
+        Stat,
+        Read,
+        Close
+    };
+
+    struct Slot {
+        int file = -1;
+        QByteArray path;
+        int fd = -1;
+        qint64 size = -1;
+        qint64 offset = 0;
+        int pending = 0;
+        bool failed = false;
+        struct statx status;
+    };
+
+    static quint64 userData(int slot, Operation operation) {
+        return (quint64(slot) << 3) | operation;
+    }
+
+    // Callers guarantee room: slots * 3 entries never exceed the ring
+    io_uring_sqe *prepare(int slot, Operation operation, int fd, const void *address,
+                          unsigned length, quint64 offset) {
+        io_uring_sqe *sqe = ring.nextSqe();
+        switch (operation) {
+        case Open: sqe->opcode = IORING_OP_OPENAT; break;
+        case Stat: sqe->opcode = IORING_OP_STATX; break;
+        case Read: sqe->opcode = fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ; break;
+        case Close: sqe->opcode = IORING_OP_CLOSE; break;
+        }
+        sqe->fd = fd;
+        sqe->addr = quint64(quintptr(address));
+        sqe->len = length;
+        sqe->off = offset;
+        sqe->user_data = userData(slot, operation);
+        return sqe;
+    }
+
+    bool startFile(int slot) {
+        if (stopped.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        const int index = next.fetch_add(1);
+        if (index >= files.size()) {
+            return false;
+        }
+
+        Slot& state = slots[size_t(slot)];
+        state = Slot();
+        state.file = index;
+        state.path = QFile::encodeName(files[index]);
+        prepare(slot, Open, AT_FDCWD, state.path.constData(), 0, 0)->open_flags = O_RDONLY | O_CLOEXEC;
+        prepare(slot, Stat, AT_FDCWD, state.path.constData(), STATX_TYPE | STATX_SIZE,
+                quint64(quintptr(&state.status)))->statx_flags = AT_STATX_SYNC_AS_STAT;
+        state.pending = 2;
+        ++active;
+        return true;
+    }
+
+    void submitRead(int slot) {
+        Slot& state = slots[size_t(slot)];
+        const qint64 length = qMin(buffers.bufferSize(), state.size - state.offset);
+        io_uring_sqe *sqe = prepare(slot, Read, state.fd, buffers.at(slot), unsigned(length),
+                                    quint64(state.offset));
+        if (fixedBuffers) {
+            sqe->buf_index = quint16(slot);
+        }
+        ++state.pending;
+    }
+
+    void complete(const io_uring_cqe& cqe) {
+        const Operation operation = Operation(cqe.user_data & 7);
+        if (operation == Close) {
+            --closing;
+            return;
+        }
+        const int slot = int(cqe.user_data >> 3);
+        Slot& state = slots[size_t(slot)];
+        --state.pending;
+        bool endOfFile = false;
+
+        switch (operation) {
+        case Open:
+            if (cqe.res < 0) {
+                state.failed = true;
+            } else {
+                state.fd = cqe.res;
+            }
+            break;
+        case Stat:
+            if (cqe.res < 0 || !S_ISREG(state.status.stx_mode)) {
+                state.failed = true;
+            } else {
+                state.size = qint64(state.status.stx_size);
+            }
+            break;
+        case Read:
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                submitRead(slot);
+                return;
+            }
+            if (cqe.res < 0) {
+                state.failed = true;
+            } else if (cqe.res == 0) {
+                // Shrunk since statx; what was read is all there is
+                endOfFile = true;
+            } else {
+                if (stats) {
+                    stats->add(ScanStats::BytesRead, quint64(cqe.res));
+                }
+                chunk(state.file, buffers.at(slot), cqe.res);
+                state.offset += cqe.res;
+            }
+            break;
+        case Close:
+            break;
+        }
+
+        if (state.pending > 0) {
+            return;
+        }
+        if (stopped.load(std::memory_order_relaxed)) {
+            state.failed = true;
+        }
+        if (state.failed || endOfFile || state.offset >= state.size) {
+            finish(slot);
+        } else {
+            submitRead(slot);
+        }
+    }
+
+    void finish(int slot) {
+        Slot& state = slots[size_t(slot)];
+        if (state.fd >= 0) {
+            prepare(slot, Close, state.fd, nullptr, 0, 0);
+            ++closing;
+        }
+        // The slot is free from here on, abandon() must not report it again
+        const int file = state.file;
+        const bool failed = state.failed;
+        state.fd = -1;
+        state.file = -1;
+        done(file, !failed);
+        --active;
+        startFile(slot);
+    }
+
+    // The ring broke down. The kernel may still write into the buffers and
+    // hand out descriptors until every request in flight completes, so those
+    // are waited for first; then what is open is closed and the unfinished
+    // files are reported as failed.
+    void abandon() {
+        const bool drained = drain();
+        for (Slot& state : slots) {
+            if (state.file < 0) {
+                continue;
+            }
+            if (state.fd >= 0) {
+                ::close(state.fd);
+            }
+            done(state.file, false);
+            state = Slot();
+        }
+        if (drained) {
+            runBlocking(buffers.at(0));
+            return;
+        }
+        // Requests may still be in flight, the pool is not reused
+        BufferPool spare(1, buffers.bufferSize());
+        runBlocking(spare.at(0));
+    }
+
+    // Reaps completions until no request is in flight; false when the ring
+    // cannot even wait for them
+    bool drain() {
+        int outstanding = closing;
+        for (const Slot& state : slots) {
+            outstanding += state.pending;
+        }
+        while (outstanding > 0) {
+            const int result = ring.submit(1);
+            if (result < 0 && result != -EBUSY && result != -EAGAIN) {
+                return false;
+            }
+            io_uring_cqe cqe;
+            while (ring.popCompletion(cqe)) {
+                --outstanding;
+                const Operation operation = Operation(cqe.user_data & 7);
+                if (operation == Close) {
+                    --closing;
+                    continue;
+                }
+                Slot& state = slots[size_t(cqe.user_data >> 3)];
+                --state.pending;
+                if (operation == Open && cqe.res >= 0) {
+                    state.fd = cqe.res;
+                }
+            }
+        }
+        return true;
+    }
+
+    void runBlocking(char *buffer) {
+        for (;;) {
+            if (stopped.load(std::memory_order_relaxed)) {
+                return;
+            }
+            const int index = next.fetch_add(1);
+            if (index >= files.size()) {
+                return;
+            }
+            done(index, readWhole(files[index], buffer, buffers.bufferSize(), stats,
+                                  [this, index](const char *data, qint64 length) { chunk(index, data, length); },
+                                  checkpoint));
+        }
+    }
+
+    const QStringList& files;
+    std::atomic<int>& next;
+    std::atomic<bool>& stopped;
+    ScanStats *stats;
+    const BatchReader::Checkpoint& checkpoint;
+    const BatchReader::ChunkHandler& chunk;
+    const BatchReader::DoneHandler& done;
+
+    Ring ring;
+    BufferPool buffers;
+    std::vector<Slot> slots;
+    bool fixedBuffers = false;
+    int active = 0;
+    int closing = 0;
+};
+
+#endif
+
+} // namespace
+
+BatchReader::BatchReader(Backend backend, const Checkpoint& checkpoint)
+    : selected(backend)
+    , checkpoint(checkpoint)
+    , threads(QThread::idealThreadCount())
+{
+    if (selected == Backend::Auto || !isSupported(selected)) {
+        selected = isSupported(Backend::IoUring) ? Backend::IoUring : Backend::ThreadPool;
+    }
+}
+
+BatchReader::Backend BatchReader::backend() const {
+    return selected;
+}
+
+void BatchReader::setThreadCount(int count) {
+    threads = qMax(1, count);
+}
+
+int BatchReader::threadCount() const {
+    return threads;
+}
+
+void BatchReader::setQueueDepth(int queueDepth) {
+    depth = qMax(1, queueDepth);
+}
+
+int BatchReader::queueDepth() const {
+    return depth;
+}
+
+void BatchReader::setChunkSize(qint64 size) {
+    chunkSize = qMax<qint64>(BufferAlignment, (size + BufferAlignment - 1) / BufferAlignment * BufferAlignment);
+}
+
+void BatchReader::setStats(ScanStats *scanStats) {
+    stats = scanStats;
+}
+
+bool BatchReader::read(const QStringList& files, const ChunkHandler& chunk, const DoneHandler& done,
+                       const Progress& progress) {
+    if (files.isEmpty()) {
+        return !checkpoint || checkpoint();
+    }
+    // Completions are counted here so progress can be reported from this thread
+    std::atomic<int> finished{0};
+    const DoneHandler counted = [&done, &finished](int index, bool ok) {
+        done(index, ok);
+        finished.fetch_add(1, std::memory_order_relaxed);
+    };
+    return selected == Backend::IoUring ? readIoUring(files, chunk, counted, progress, finished)
+                                        : readThreadPool(files, chunk, counted, progress, finished);
+}
+
+bool BatchReader::readThreadPool(const QStringList& files, const ChunkHandler& chunk,
+                                 const DoneHandler& done, const Progress& progress,
+                                 const std::atomic<int>& finished) {
+    // Blocked reads occupy threads rather than cores, so the queue depth
+    // rather than the core count decides how many run at once
+    const int workers = qMin(qMax(threads, depth), int(files.size()));
+    std::atomic<int> next{0};
+    std::atomic<bool> stopped{false};
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(workers);
+    for (int worker = 0; worker < workers; ++worker) {
+        pool.start([&]() {
+            BufferPool buffer(1, chunkSize);
+            for (;;) {
+                if (stopped.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                const int index = next.fetch_add(1);
+                if (index >= files.size()) {
+                    return;
+                }
+                if (checkpoint && !checkpoint()) {
+                    stopped.store(true, std::memory_order_relaxed);
+                    return;
+                }
+                done(index, readWhole(files[index], buffer.at(0), chunkSize, stats,
+                                      [&chunk, index](const char *data, qint64 length) {
+                                          chunk(index, data, length);
+                                      },
+                                      checkpoint));
+            }
+        });
+    }
+    waitForPool(pool, files.size(), progress, finished);
+    return !stopped.load() && (!checkpoint || checkpoint());
+}
+
+bool BatchReader::readIoUring(const QStringList& files, const ChunkHandler& chunk,
+                              const DoneHandler& done, const Progress& progress,
+                              const std::atomic<int>& finished) {
+#ifdef BATCHREADER_HAVE_IO_URING
+    // Hashing happens on the ring threads, so they scale with the cores
+    // while the queue depth is shared out between them
+    const int workers = qMax(1, qMin(threads, int(files.size())));
+    const int slotsPerWorker = qMax(1, qMin((depth + workers - 1) / workers,
+                                            int((files.size() + workers - 1) / workers)));
+    std::atomic<int> next{0};
+    std::atomic<bool> stopped{false};
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(workers);
+    for (int worker = 0; worker < workers; ++worker) {
+        pool.start([&]() {
+            RingWorker ringWorker(files, next, stopped, slotsPerWorker, chunkSize, stats,
+                                  checkpoint, chunk, done);
+            ringWorker.run();
+        });
+    }
+    waitForPool(pool, files.size(), progress, finished);
+    return !stopped.load() && (!checkpoint || checkpoint());
+#else
+    return readThreadPool(files, chunk, done, progress, finished);
+#endif
+}
+
+void BatchReader::waitForPool(QThreadPool& pool, int total, const Progress& progress,
+                              const std::atomic<int>& finished) {
+    while (!pool.waitForDone(ProgressInterval)) {
+        if (progress) {
+            progress(finished.load(std::memory_order_relaxed), total);
+        }
+    }
+    if (progress) {
+        progress(finished.load(), total);
+    }
+}
+
+bool BatchReader::isSupported(Backend backend) {
+    switch (backend) {
+    case Backend::Auto:
+    case Backend::ThreadPool:
+        return true;
+    case Backend::IoUring:
+#ifdef BATCHREADER_HAVE_IO_URING
+        return ioUringAvailable();
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+QString BatchReader::backendName(Backend backend) {
+    switch (backend) {
+    case Backend::Auto: return "auto";
+    case Backend::IoUring: return "io_uring";
+    case Backend::ThreadPool: return "threads";
+    }
+    return QString();
+}
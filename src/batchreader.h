@@ -0,0 +1,81 @@
+#ifndef BATCHREADER_H
+#define BATCHREADER_H
+
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <functional>
+
+class QThreadPool;
+class ScanStats;
+
+// Streams the contents of many files to a consumer while keeping a deep
+// queue of reads in flight across files. Each worker owns a set of file
+// slots and a pool of aligned, recycled buffers; a completed buffer is handed
+// straight to the consumer and then reused for the next read.
+//
+// The io_uring backend gives every worker its own ring and submits the
+// open, statx, read and close of each file through it, so one thread keeps
+// QueueDepth / threads files in flight. The fallback runs one blocking
+// pread loop per thread and gets its depth from the thread count instead.
+// Chunks of one file always arrive in order on a single thread; different
+// files are delivered concurrently from all workers.
+class BatchReader {
+public:
+    enum class Backend {
+        Auto,
+        IoUring,
+        ThreadPool
+    };
+
+    using Checkpoint = std::function<bool()>;
+    // Consecutive chunks of files[index], starting at offset 0
+    using ChunkHandler = std::function<void(int index, const char *data, qint64 length)>;
+    // Called once per file after its last chunk; ok is false if any step failed
+    using DoneHandler = std::function<void(int index, bool ok)>;
+    using Progress = std::function<void(int finished, int total)>;
+
+    explicit BatchReader(Backend backend = Backend::Auto, const Checkpoint& checkpoint = Checkpoint());
+
+    Backend backend() const;
+    void setThreadCount(int count);
+    int threadCount() const;
+    // Files kept in flight at once, across all workers
+    void setQueueDepth(int depth);
+    int queueDepth() const;
+    // Rounded up to BufferAlignment
+    void setChunkSize(qint64 size);
+    // Receives BytesRead and the time blocked waiting for reads
+    void setStats(ScanStats *stats);
+
+    // Returns false if the checkpoint stopped the batch; files not yet
+    // started then get no callbacks at all. progress is called from the
+    // calling thread.
+    bool read(const QStringList& files, const ChunkHandler& chunk, const DoneHandler& done,
+              const Progress& progress = Progress());
+
+    static bool isSupported(Backend backend);
+    static QString backendName(Backend backend);
+
+    static constexpr int DefaultQueueDepth = 64;
+    static constexpr qint64 DefaultChunkSize = 1024 * 1024;
+    static constexpr qint64 BufferAlignment = 4096;
+    static constexpr int ProgressInterval = 50;
+
+private:
+    bool readThreadPool(const QStringList& files, const ChunkHandler& chunk, const DoneHandler& done,
+                        const Progress& progress, const std::atomic<int>& finished);
+    bool readIoUring(const QStringList& files, const ChunkHandler& chunk, const DoneHandler& done,
+                     const Progress& progress, const std::atomic<int>& finished);
+    static void waitForPool(QThreadPool& pool, int total, const Progress& progress,
+                            const std::atomic<int>& finished);
+
+    Backend selected;
+    Checkpoint checkpoint;
+    int threads;
+    int depth = DefaultQueueDepth;
+    qint64 chunkSize = DefaultChunkSize;
+    ScanStats *stats = nullptr;
+};
+
+#endif // BATCHREADER_H
@@ -0,0 +1,106 @@
+#include "contentchunker.h"
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+// FastCDC masks for an 8 KiB average: 15 bits below it, 11 bits above it
+constexpr quint64 MaskSmall = 0x0003590703530000ULL;
+constexpr quint64 MaskLarge = 0x0000d90003530000ULL;
+
+struct GearTable {
+    quint64 values[256];
+};
+
+constexpr GearTable makeGearTable() {
+    GearTable table{};
+    quint64 state = 0x4765617243444331ULL;
+    for (int i = 0; i < 256; ++i) {
+        state += 0x9E3779B97F4A7C15ULL;
+        quint64 z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        table.values[i] = z ^ (z >> 31);
+    }
+    return table;
+}
+
+constexpr GearTable kGear = makeGearTable();
+
+} // namespace
+
+ContentChunker::ContentChunker() {
+    reset();
+}
+
+void ContentChunker::reset() {
+    chunkHash.reset();
+    minHash = SimilarityIndex::emptySignature();
+    gear = 0;
+    current = 0;
+    chunks = 0;
+}
+
+void ContentChunker::addData(const char *data, qsizetype length) {
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+    qsizetype start = 0;
+    qsizetype i = 0;
+    while (i < length) {
+        // No boundary can fall inside the minimum chunk, skip it unhashed
+        if (current < MinChunk) {
+            const qsizetype skip = qMin<qsizetype>(length - i, MinChunk - current);
+            current += skip;
+            i += skip;
+            continue;
+        }
+
+        // Scan up to the next size threshold with the mask that applies
+        // there, so the inner loop is only the rolling hash and one test
+        const bool small = current < AverageChunk;
+        const quint64 mask = small ? MaskSmall : MaskLarge;
+        const qsizetype end = i + qMin<qsizetype>(length - i, (small ? AverageChunk : MaxChunk) - current);
+        quint64 hash = gear;
+        qsizetype j = i;
+        bool boundary = false;
+        while (j < end) {
+            hash = (hash << 1) + kGear.values[bytes[j++]];
+            if ((hash & mask) == 0) {
+                boundary = true;
+                break;
+            }
+        }
+        gear = hash;
+        current += j - i;
+        i = j;
+
+        if (boundary || current >= MaxChunk) {
+            chunkHash.addData(data + start, i - start);
+            start = i;
+            finishChunk();
+        }
+    }
+    chunkHash.addData(data + start, length - start);
+}
+
+SimilarityIndex::Signature ContentChunker::signature() {
+    if (current > 0) {
+        finishChunk();
+    }
+    return minHash;
+}
+
+int ContentChunker::chunkCount() const {
+    return chunks;
+}
+
+void ContentChunker::finishChunk() {
+    const QByteArray digest = chunkHash.result();
+    quint64 fingerprint;
+    std::memcpy(&fingerprint, digest.constData(), sizeof(fingerprint));
+    SimilarityIndex::addFingerprint(minHash, qFromLittleEndian(fingerprint));
+
+    chunkHash.reset();
+    gear = 0;
+    current = 0;
+    ++chunks;
+}
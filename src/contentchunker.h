@@ -0,0 +1,39 @@
+#ifndef CONTENTCHUNKER_H
+#define CONTENTCHUNKER_H
+
+#include <QtGlobal>
+#include "fasthash.h"
+#include "similarityindex.h"
+
+// Content-defined chunking with the FastCDC Gear rolling hash. Boundaries
+// depend only on the bytes around them, so an insertion early in a file
+// shifts only the chunks it touches. Normalised chunking uses a stricter
+// mask below AverageChunk and a looser one above it, and no boundary is
+// searched for in the first MinChunk bytes of a chunk. Each chunk is
+// fingerprinted and folded into a MinHash signature as data streams in, so
+// the chunker can ride along on the read loop of the exact hash.
+class ContentChunker {
+public:
+    ContentChunker();
+
+    void reset();
+    void addData(const char *data, qsizetype length);
+    // Closes the last chunk; the chunker must be reset before reuse
+    SimilarityIndex::Signature signature();
+    int chunkCount() const;
+
+    static constexpr qint64 MinChunk = 2 * 1024;
+    static constexpr qint64 AverageChunk = 8 * 1024;
+    static constexpr qint64 MaxChunk = 64 * 1024;
+
+private:
+    void finishChunk();
+
+    FastHash chunkHash;
+    SimilarityIndex::Signature minHash;
+    quint64 gear = 0;
+    qint64 current = 0;
+    int chunks = 0;
+};
+
+#endif // CONTENTCHUNKER_H
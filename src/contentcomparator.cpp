@@ -0,0 +1,185 @@
+#include "contentcomparator.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QVector>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+ContentComparator::ContentComparator(const Checkpoint& checkpointFunction)
+    : checkpoint(checkpointFunction)
+{
+}
+
+QList<QStringList> ContentComparator::partition(const QStringList& files) {
+    // The first member of each class stands for it in later batches
+    QList<QStringList> classes;
+    const int batchSize = files.size() <= MaxOpenFiles ? int(files.size()) : MaxOpenFiles / 2;
+    const int representatives = MaxOpenFiles - batchSize;
+    for (int start = 0; start < files.size(); start += batchSize) {
+        QStringList unmatched = files.mid(start, batchSize);
+        const int known = classes.size();
+        for (int first = 0; first < known && !unmatched.isEmpty(); first += representatives) {
+            const int count = qMin(representatives, known - first);
+            QStringList batch;
+            for (int c = first; c < first + count; ++c) {
+                batch.append(classes[c].first());
+            }
+            batch += unmatched;
+
+            QList<QVector<int>> parts;
+            if (!compare(batch, parts)) {
+                return QList<QStringList>();
+            }
+            unmatched.clear();
+            for (const QVector<int>& part : std::as_const(parts)) {
+                // Classes differ from each other, so a part holds at most one representative
+                int owner = -1;
+                for (int i : part) {
+                    if (i < count) {
+                        owner = first + i;
+                    }
+                }
+                for (int i : part) {
+                    if (i < count) {
+                        continue;
+                    }
+                    if (owner >= 0) {
+                        classes[owner].append(batch[i]);
+                    } else {
+                        unmatched.append(batch[i]);
+                    }
+                }
+            }
+        }
+
+        // Whatever matched no earlier class is split among itself
+        QList<QVector<int>> parts;
+        if (!compare(unmatched, parts)) {
+            return QList<QStringList>();
+        }
+        for (const QVector<int>& part : std::as_const(parts)) {
+            QStringList members;
+            for (int i : part) {
+                members.append(unmatched[i]);
+            }
+            classes.append(members);
+        }
+    }
+
+    QList<QStringList> result;
+    for (const QStringList& members : std::as_const(classes)) {
+        if (members.size() > 1) {
+            result.append(members);
+        }
+    }
+    return result;
+}
+
+bool ContentComparator::compare(const QStringList& files, QList<QVector<int>>& classes) {
+    std::vector<std::unique_ptr<QFile>> handles(files.size());
+    QVector<QByteArray> buffers(files.size());
+    QVector<qint64> lengths(files.size(), 0);
+
+    QVector<int> readable;
+    for (int i = 0; i < files.size(); ++i) {
+        handles[i] = std::make_unique<QFile>(files[i]);
+        if (!handles[i]->open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+            handles[i].reset();
+            if (!unreadable.contains(files[i])) {
+                unreadable.append(files[i]);
+            }
+            continue;
+        }
+#ifdef Q_OS_LINUX
+        ::posix_fadvise(handles[i]->handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        buffers[i].resize(ChunkSize);
+        readable.append(i);
+    }
+
+    QList<QVector<int>> open;
+    if (readable.size() > 1) {
+        open.append(readable);
+    } else if (!readable.isEmpty()) {
+        classes.append(readable);
+    }
+
+    while (!open.isEmpty()) {
+        if (checkpoint && !checkpoint()) {
+            return false;
+        }
+
+        for (const QVector<int>& members : std::as_const(open)) {
+            for (int i : members) {
+                lengths[i] = handles[i]->read(buffers[i].data(), ChunkSize);
+                if (lengths[i] > 0) {
+                    totalRead += lengths[i];
+                } else if (lengths[i] < 0 && !unreadable.contains(files[i])) {
+                    unreadable.append(files[i]);
+                }
+            }
+        }
+
+        QList<QVector<int>> next;
+        for (const QVector<int>& members : std::as_const(open)) {
+            // Compare each member against the representative of every
+            // sub-class seen so far; identical groups stay in one class
+            QList<QVector<int>> parts;
+            for (int i : members) {
+                if (lengths[i] < 0) {
+                    continue;
+                }
+                bool placed = false;
+                for (QVector<int>& part : parts) {
+                    const int representative = part.first();
+                    if (lengths[representative] == lengths[i]
+                        && std::memcmp(buffers[representative].constData(), buffers[i].constData(),
+                                       size_t(lengths[i])) == 0) {
+                        part.append(i);
+                        placed = true;
+                        break;
+                    }
+                }
+                if (!placed) {
+                    parts.append(QVector<int>{i});
+                }
+            }
+
+            for (const QVector<int>& part : std::as_const(parts)) {
+                if (part.size() > 1 && lengths[part.first()] > 0) {
+                    next.append(part);
+                    continue;
+                }
+                // Settled: all members reached the end of file together, or
+                // a single file differs from everything else
+                classes.append(part);
+                for (int i : part) {
+                    handles[i].reset();
+                    buffers[i] = QByteArray();
+                }
+            }
+        }
+        open = next;
+    }
+    return true;
+}
+
+bool ContentComparator::identical(const QString& file1, const QString& file2) {
+    if (QFileInfo(file1).size() != QFileInfo(file2).size()) {
+        return false;
+    }
+    return partition(QStringList{file1, file2}).size() == 1;
+}
+
+qint64 ContentComparator::bytesRead() const {
+    return totalRead;
+}
+
+QStringList ContentComparator::unreadableFiles() const {
+    return unreadable;
+}
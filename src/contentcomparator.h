@@ -0,0 +1,42 @@
+#ifndef CONTENTCOMPARATOR_H
+#define CONTENTCOMPARATOR_H
+
+#include <QList>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+
+// Byte-exact comparison of candidate duplicates. All members of a group are
+// read in lockstep with large unbuffered sequential reads and compared chunk
+// by chunk against the first member of their class, so a file stops being
+// read as soon as it differs from every other file in the group. No more
+// than MaxOpenFiles are open at once: a larger group is taken in batches,
+// each compared against the first member of every class found so far.
+class ContentComparator {
+public:
+    using Checkpoint = std::function<bool()>;
+
+    explicit ContentComparator(const Checkpoint& checkpoint = Checkpoint());
+
+    // Splits files into sets of identical content; files that differ from
+    // everything else or cannot be read are left out
+    QList<QStringList> partition(const QStringList& files);
+    bool identical(const QString& file1, const QString& file2);
+
+    qint64 bytesRead() const;
+    // Files that could not be opened or read, and so were left out
+    QStringList unreadableFiles() const;
+
+    static constexpr qint64 ChunkSize = 256 * 1024;
+    static constexpr int MaxOpenFiles = 64;
+
+private:
+    // Every class of identical files, single files included; false when cancelled
+    bool compare(const QStringList& files, QList<QVector<int>>& classes);
+
+    Checkpoint checkpoint;
+    qint64 totalRead = 0;
+    QStringList unreadable;
+};
+
+#endif // CONTENTCOMPARATOR_H
@@ -0,0 +1,470 @@
+#include "digestindex.h"
+#include <QDir>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <queue>
+
+namespace {
+
+// Fixed part of a run entry; the UTF-8 path follows
+constexpr int EntryHeaderSize = 8 + DigestIndex::DigestLength + 8 + 8 + 8 + 4;
+// Longer than any path the index writes, so a longer one is corruption
+constexpr quint32 MaxPathLength = 64 * 1024;
+// Runs merged at once, each with its own read buffer
+constexpr int MaxFanIn = 64;
+
+} // namespace
+
+// Buffered sequential reader over one run file
+class DigestIndex::RunReader {
+public:
+    explicit RunReader(QTemporaryFile *file)
+        : file(file)
+    {
+    }
+
+    bool open() {
+        return file->open();
+    }
+
+    // False at the end of the run or on an error, which failed() tells apart
+    bool next() {
+        if (!fill(EntryHeaderSize)) {
+            // Bytes short of a whole entry are a truncated run
+            broken = broken || buffer.size() > position;
+            return false;
+        }
+        const char *data = buffer.constData() + position;
+        std::memcpy(&key.size, data, 8);
+        std::memcpy(key.digest, data + 8, DigestLength);
+        data += 8 + DigestLength;
+        std::memcpy(&stamp.device, data, 8);
+        std::memcpy(&stamp.inode, data + 8, 8);
+        std::memcpy(&stamp.mtimeNs, data + 16, 8);
+        quint32 pathLength;
+        std::memcpy(&pathLength, data + 24, 4);
+        stamp.size = key.size;
+        position += EntryHeaderSize;
+
+        if (pathLength > MaxPathLength || !fill(int(pathLength))) {
+            broken = true;
+            return false;
+        }
+        path = QByteArray(buffer.constData() + position, int(pathLength));
+        position += int(pathLength);
+        return true;
+    }
+
+    bool failed() const {
+        return broken;
+    }
+
+    QString errorString() const {
+        return file->error() != QFileDevice::NoError ? file->errorString() : QString("Truncated run");
+    }
+
+    QString fileName() const {
+        return file->fileName();
+    }
+
+    Key key;
+    HashCache::FileStamp stamp;
+    QByteArray path;
+
+private:
+    bool fill(int bytes) {
+        if (buffer.size() - position >= bytes) {
+            return true;
+        }
+        buffer.remove(0, position);
+        position = 0;
+        const int wanted = qMax(bytes, RunBufferSize);
+        while (buffer.size() < bytes) {
+            const qsizetype filled = buffer.size();
+            buffer.resize(wanted);
+            const qint64 got = file->read(buffer.data() + filled, wanted - filled);
+            buffer.resize(filled + qMax<qint64>(0, got));
+            if (got < 0) {
+                broken = true;
+                return false;
+            }
+            if (got == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    QTemporaryFile *file;
+    QByteArray buffer;
+    int position = 0;
+    bool broken = false;
+};
+
+DigestIndex::DigestIndex(qint64 memoryLimit, const QString& directory)
+    : shardLimit(qMax<qint64>(64 * 1024, memoryLimit / ShardCount))
+    , spillDirectory(directory.isEmpty() ? QDir::tempPath() : directory)
+{
+}
+
+DigestIndex::~DigestIndex() = default;
+
+DigestIndex::Key DigestIndex::makeKey(qint64 size, const QByteArray& digest) {
+    Key key;
+    key.size = size;
+    std::memset(key.digest, 0, DigestLength);
+    std::memcpy(key.digest, digest.constData(), size_t(qMin<qsizetype>(digest.size(), DigestLength)));
+    return key;
+}
+
+quint64 DigestIndex::hashKey(const Key& key) {
+    quint64 low;
+    quint64 high;
+    std::memcpy(&low, key.digest, 8);
+    std::memcpy(&high, key.digest + 8, 8);
+    // splitmix64 finaliser over the folded key
+    quint64 x = quint64(key.size) ^ low ^ (high * 0x9e3779b97f4a7c15ULL);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+bool DigestIndex::sameKey(const Key& a, const Key& b) {
+    return a.size == b.size && std::memcmp(a.digest, b.digest, DigestLength) == 0;
+}
+
+bool DigestIndex::keyLess(const Key& a, const Key& b) {
+    if (a.size != b.size) {
+        return a.size < b.size;
+    }
+    return std::memcmp(a.digest, b.digest, DigestLength) < 0;
+}
+
+qint64 DigestIndex::usage(const Shard& shard) {
+    return qint64(shard.records.capacity() * sizeof(Record)) + shard.paths.capacity()
+        + qint64(shard.table.capacity() * sizeof(quint32));
+}
+
+void DigestIndex::growTable(Shard& shard) {
+    std::vector<quint32> old(qMax<size_t>(1024, shard.table.size() * 2), 0);
+    old.swap(shard.table);
+    const size_t mask = shard.table.size() - 1;
+    for (quint32 slot : old) {
+        if (slot == 0) {
+            continue;
+        }
+        size_t i = hashKey(shard.records[slot - 1].key) & mask;
+        while (shard.table[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        shard.table[i] = slot;
+    }
+}
+
+void DigestIndex::release(Shard& shard) {
+    std::vector<Record>().swap(shard.records);
+    shard.paths = QByteArray();
+    std::vector<quint32>().swap(shard.table);
+    shard.keys = 0;
+    shard.runs.clear();
+}
+
+bool DigestIndex::insert(qint64 size, const QByteArray& digest, const QString& path,
+                         const HashCache::FileStamp& stamp) {
+    const Key key = makeKey(size, digest);
+    const quint64 hash = hashKey(key);
+    // Top bits pick the shard, the low ones index its table
+    Shard& shard = shards[hash >> 60];
+    const QByteArray encoded = path.toUtf8();
+
+    QMutexLocker locker(&shard.mutex);
+    // Sizes rather than capacities, which a spill keeps for the next run.
+    // The arena is addressed with 32-bit offsets.
+    const qint64 used = qint64(shard.records.size() * sizeof(Record)) + shard.paths.size()
+        + qint64(shard.keys) * 2 * qint64(sizeof(quint32));
+    if ((used > shardLimit || quint64(shard.paths.size()) + quint64(encoded.size()) > 0xfff00000u)
+        && !spill(shard)) {
+        return false;
+    }
+
+    Record record;
+    record.key = key;
+    record.device = stamp.device;
+    record.inode = stamp.inode;
+    record.mtimeNs = stamp.mtimeNs;
+    record.pathOffset = quint32(shard.paths.size());
+    record.pathLength = quint32(encoded.size());
+    record.next = NoRecord;
+    shard.paths += encoded;
+
+    if (size_t(shard.keys + 1) * 2 > shard.table.size()) {
+        growTable(shard);
+    }
+    const quint32 index = quint32(shard.records.size());
+    const size_t mask = shard.table.size() - 1;
+    size_t i = hash & mask;
+    while (shard.table[i] != 0 && !sameKey(shard.records[shard.table[i] - 1].key, key)) {
+        i = (i + 1) & mask;
+    }
+    if (shard.table[i] == 0) {
+        ++shard.keys;
+    } else {
+        record.next = shard.table[i] - 1;
+    }
+    shard.table[i] = index + 1;
+    shard.records.push_back(record);
+    recordCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool DigestIndex::spill(Shard& shard) {
+    if (shard.records.empty()) {
+        return true;
+    }
+
+    std::vector<quint32> order(shard.records.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&shard](quint32 a, quint32 b) {
+        return keyLess(shard.records[a].key, shard.records[b].key);
+    });
+
+    std::unique_ptr<QTemporaryFile> run = createRun();
+    if (!run) {
+        return false;
+    }
+    QByteArray out;
+    out.reserve(RunBufferSize + 4096);
+    for (quint32 index : order) {
+        const Record& record = shard.records[index];
+        appendEntry(out, record.key, record.device, record.inode, record.mtimeNs,
+                    shard.paths.constData() + record.pathOffset, record.pathLength);
+        if (out.size() >= RunBufferSize && !writeRun(*run, out)) {
+            return false;
+        }
+    }
+    if (!writeRun(*run, out)) {
+        return false;
+    }
+    // Closed until the merge so large scans do not run out of descriptors
+    run->close();
+    shard.runs.push_back(std::move(run));
+    runs.fetch_add(1, std::memory_order_relaxed);
+
+    // Capacity is kept for the next run, it is within the limit by now
+    shard.records.clear();
+    shard.paths.resize(0);
+    std::fill(shard.table.begin(), shard.table.end(), 0u);
+    shard.keys = 0;
+    return true;
+}
+
+bool DigestIndex::forEachGroup(const GroupCallback& callback) {
+    for (Shard& shard : shards) {
+        QMutexLocker locker(&shard.mutex);
+        bool ok;
+        if (shard.runs.empty()) {
+            ok = groupInMemory(shard, callback);
+        } else {
+            ok = spill(shard) && mergeRuns(shard, callback);
+        }
+        recordCount.fetch_sub(qint64(shard.records.size()), std::memory_order_relaxed);
+        release(shard);
+        if (!ok) {
+            return false;
+        }
+    }
+    recordCount.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+bool DigestIndex::groupInMemory(Shard& shard, const GroupCallback& callback) {
+    QVector<Item> items;
+    for (quint32 slot : shard.table) {
+        if (slot == 0 || shard.records[slot - 1].next == NoRecord) {
+            continue;
+        }
+        items.clear();
+        for (quint32 index = slot - 1; index != NoRecord; index = shard.records[index].next) {
+            const Record& record = shard.records[index];
+            Item item;
+            item.path = QString::fromUtf8(shard.paths.constData() + record.pathOffset, int(record.pathLength));
+            item.stamp.device = record.device;
+            item.stamp.inode = record.inode;
+            item.stamp.size = record.key.size;
+            item.stamp.mtimeNs = record.mtimeNs;
+            items.append(item);
+        }
+        // Chains run newest first
+        std::reverse(items.begin(), items.end());
+        const Key& key = shard.records[slot - 1].key;
+        if (!callback(key.size, QByteArray(reinterpret_cast<const char *>(key.digest), DigestLength), items)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::unique_ptr<QTemporaryFile> DigestIndex::createRun() {
+    auto run = std::make_unique<QTemporaryFile>(spillDirectory + "/filemanager-index-XXXXXX");
+    if (!run->open()) {
+        setError("Cannot create " + run->fileTemplate() + ": " + run->errorString());
+        return nullptr;
+    }
+    return run;
+}
+
+void DigestIndex::appendEntry(QByteArray& out, const Key& key, quint64 device, quint64 inode, qint64 mtimeNs,
+                              const char *path, quint32 pathLength) {
+    out.append(reinterpret_cast<const char *>(&key.size), 8);
+    out.append(reinterpret_cast<const char *>(key.digest), DigestLength);
+    out.append(reinterpret_cast<const char *>(&device), 8);
+    out.append(reinterpret_cast<const char *>(&inode), 8);
+    out.append(reinterpret_cast<const char *>(&mtimeNs), 8);
+    out.append(reinterpret_cast<const char *>(&pathLength), 4);
+    out.append(path, int(pathLength));
+}
+
+bool DigestIndex::writeRun(QTemporaryFile& run, QByteArray& out) {
+    if (run.write(out) != out.size()) {
+        setError("Cannot write " + run.fileName() + ": " + run.errorString());
+        return false;
+    }
+    out.clear();
+    return true;
+}
+
+bool DigestIndex::mergeRuns(Shard& shard, const GroupCallback& callback) {
+    // Every open run holds a read buffer, so the memory limit caps how many
+    // are merged at once; more runs than that take extra passes, each
+    // merging fanIn runs into one
+    const int fanIn = int(qBound<qint64>(2, shardLimit / RunBufferSize, MaxFanIn));
+    while (shard.runs.size() > size_t(fanIn)) {
+        std::vector<std::unique_ptr<QTemporaryFile>> merged;
+        for (size_t first = 0; first < shard.runs.size(); first += size_t(fanIn)) {
+            const size_t count = qMin(size_t(fanIn), shard.runs.size() - first);
+            if (count == 1) {
+                merged.push_back(std::move(shard.runs[first]));
+                continue;
+            }
+            std::unique_ptr<QTemporaryFile> run = createRun();
+            if (!run) {
+                return false;
+            }
+            QByteArray out;
+            out.reserve(RunBufferSize + 4096);
+            const bool ok = mergeRange(shard, first, count, [&](const RunReader& reader) {
+                appendEntry(out, reader.key, reader.stamp.device, reader.stamp.inode, reader.stamp.mtimeNs,
+                            reader.path.constData(), quint32(reader.path.size()));
+                return out.size() < RunBufferSize || writeRun(*run, out);
+            });
+            if (!ok || !writeRun(*run, out)) {
+                return false;
+            }
+            run->close();
+            merged.push_back(std::move(run));
+            // The inputs are no longer needed, their disk space is
+            for (size_t i = first; i < first + count; ++i) {
+                shard.runs[i].reset();
+            }
+        }
+        shard.runs.swap(merged);
+    }
+
+    QVector<Item> items;
+    Key current;
+    auto flush = [&]() {
+        if (items.size() < 2) {
+            return true;
+        }
+        return callback(current.size, QByteArray(reinterpret_cast<const char *>(current.digest), DigestLength), items);
+    };
+    const bool ok = mergeRange(shard, 0, shard.runs.size(), [&](const RunReader& reader) {
+        if (items.isEmpty() || !sameKey(reader.key, current)) {
+            if (!flush()) {
+                return false;
+            }
+            items.clear();
+            current = reader.key;
+        }
+        items.append({QString::fromUtf8(reader.path), reader.stamp});
+        return true;
+    });
+    return ok && flush();
+}
+
+bool DigestIndex::mergeRange(Shard& shard, size_t first, size_t count,
+                             const std::function<bool(const RunReader&)>& visit) {
+    std::vector<std::unique_ptr<RunReader>> readers;
+    for (size_t i = first; i < first + count; ++i) {
+        QTemporaryFile *run = shard.runs[i].get();
+        readers.push_back(std::make_unique<RunReader>(run));
+        if (!readers.back()->open()) {
+            setError("Cannot reopen " + run->fileName() + ": " + run->errorString());
+            return false;
+        }
+    }
+    // A run that ends early would silently lose its files
+    auto advance = [this](RunReader& reader) {
+        if (reader.next()) {
+            return true;
+        }
+        if (reader.failed()) {
+            setError("Cannot read " + reader.fileName() + ": " + reader.errorString());
+        }
+        return false;
+    };
+
+    auto greater = [&readers](int a, int b) { return keyLess(readers[size_t(b)]->key, readers[size_t(a)]->key); };
+    std::priority_queue<int, std::vector<int>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < readers.size(); ++i) {
+        if (advance(*readers[i])) {
+            heap.push(int(i));
+        } else if (readers[i]->failed()) {
+            return false;
+        }
+    }
+    while (!heap.empty()) {
+        const int top = heap.top();
+        heap.pop();
+        RunReader& reader = *readers[size_t(top)];
+        if (!visit(reader)) {
+            return false;
+        }
+        if (advance(reader)) {
+            heap.push(top);
+        } else if (reader.failed()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+qint64 DigestIndex::count() const {
+    return recordCount.load(std::memory_order_relaxed);
+}
+
+qint64 DigestIndex::memoryUsage() const {
+    qint64 total = 0;
+    for (const Shard& shard : shards) {
+        QMutexLocker locker(&shard.mutex);
+        total += usage(shard);
+    }
+    return total;
+}
+
+int DigestIndex::runCount() const {
+    return runs.load(std::memory_order_relaxed);
+}
+
+QString DigestIndex::errorString() const {
+    QMutexLocker locker(&errorMutex);
+    return error;
+}
+
+void DigestIndex::setError(const QString& message) {
+    QMutexLocker locker(&errorMutex);
+    if (error.isEmpty()) {
+        error = message;
+    }
+}
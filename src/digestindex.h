@@ -0,0 +1,114 @@
+#ifndef DIGESTINDEX_H
+#define DIGESTINDEX_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <QTemporaryFile>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "hashcache.h"
+
+// Groups files by (size, digest) for scans too large to hold in memory.
+// Records are spread over ShardCount shards by a hash of their key; each
+// shard keeps its paths in one UTF-8 arena next to fixed-size records and an
+// open-addressing table that chains records with equal keys. A shard that
+// outgrows its share of the memory limit is sorted by key and written out
+// as a run, and forEachGroup() merges the runs of each shard, so the number
+// of files is bounded by disk space rather than RAM. Runs are merged as many
+// at a time as the memory limit has read buffers for, in several passes if
+// need be, and a run that cannot be read back fails the whole merge. Only
+// the first DigestLength bytes of a digest are kept.
+class DigestIndex {
+public:
+    struct Item {
+        QString path;
+        HashCache::FileStamp stamp;
+    };
+
+    // Return false to stop
+    using GroupCallback = std::function<bool(qint64 size, const QByteArray& digest, const QVector<Item>& items)>;
+
+    explicit DigestIndex(qint64 memoryLimit = DefaultMemoryLimit, const QString& spillDirectory = QString());
+    ~DigestIndex();
+    DigestIndex(const DigestIndex&) = delete;
+    DigestIndex& operator=(const DigestIndex&) = delete;
+
+    // Thread-safe; false once writing a run has failed
+    bool insert(qint64 size, const QByteArray& digest, const QString& path, const HashCache::FileStamp& stamp);
+    // Hands every key shared by two or more files to callback, one shard
+    // after the other, and empties the index as it goes
+    bool forEachGroup(const GroupCallback& callback);
+
+    qint64 count() const;
+    qint64 memoryUsage() const;
+    int runCount() const;
+    QString errorString() const;
+
+    static constexpr int ShardCount = 16;     // selected by the top four bits of the key hash
+    static constexpr int DigestLength = 16;
+    static constexpr qint64 DefaultMemoryLimit = 256 * 1024 * 1024;
+
+private:
+    struct Key {
+        qint64 size;
+        quint8 digest[DigestLength];
+    };
+
+    struct Record {
+        Key key;
+        quint64 device;
+        quint64 inode;
+        qint64 mtimeNs;
+        quint32 pathOffset;
+        quint32 pathLength;
+        quint32 next;           // earlier record with the same key
+    };
+
+    struct Shard {
+        mutable QMutex mutex;
+        std::vector<Record> records;
+        QByteArray paths;
+        std::vector<quint32> table;     // record index + 1 of each key's newest record
+        quint32 keys = 0;
+        std::vector<std::unique_ptr<QTemporaryFile>> runs;
+    };
+
+    class RunReader;
+
+    static Key makeKey(qint64 size, const QByteArray& digest);
+    static quint64 hashKey(const Key& key);
+    static bool sameKey(const Key& a, const Key& b);
+    static bool keyLess(const Key& a, const Key& b);
+    static qint64 usage(const Shard& shard);
+    static void growTable(Shard& shard);
+    static void release(Shard& shard);
+
+    static void appendEntry(QByteArray& out, const Key& key, quint64 device, quint64 inode, qint64 mtimeNs,
+                            const char *path, quint32 pathLength);
+
+    bool spill(Shard& shard);
+    std::unique_ptr<QTemporaryFile> createRun();
+    bool writeRun(QTemporaryFile& run, QByteArray& out);
+    bool groupInMemory(Shard& shard, const GroupCallback& callback);
+    bool mergeRuns(Shard& shard, const GroupCallback& callback);
+    // Hands the entries of runs [first, first + count) to visit in key order
+    bool mergeRange(Shard& shard, size_t first, size_t count, const std::function<bool(const RunReader&)>& visit);
+    void setError(const QString& message);
+
+    qint64 shardLimit;
+    QString spillDirectory;
+    Shard shards[ShardCount];
+    std::atomic<qint64> recordCount{0};
+    std::atomic<int> runs{0};
+    mutable QMutex errorMutex;
+    QString error;
+
+    static constexpr quint32 NoRecord = 0xffffffffu;
+    static constexpr int RunBufferSize = 1024 * 1024;
+};
+
+#endif // DIGESTINDEX_H
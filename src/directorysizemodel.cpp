@@ -0,0 +1,97 @@
+#include "directorysizemodel.h"
+#include <QLocale>
+
+DirectorySizeModel::DirectorySizeModel(DirectorySizeScanner *scanner, QObject *parent)
+    : QIdentityProxyModel(parent)
+    , scanner(scanner)
+{
+    connect(scanner, &DirectorySizeScanner::sizesChanged, this, &DirectorySizeModel::onSizesChanged);
+}
+
+void DirectorySizeModel::setSizeColumn(int sizeColumn) {
+    column = sizeColumn;
+}
+
+int DirectorySizeModel::sizeColumn() const {
+    return column;
+}
+
+void DirectorySizeModel::setPathRole(int role) {
+    pathRole = role;
+}
+
+QString DirectorySizeModel::filePath(const QModelIndex& index) const {
+    return index.isValid() ? index.sibling(index.row(), 0).data(pathRole).toString() : QString();
+}
+
+void DirectorySizeModel::refresh(const QModelIndex& index) {
+    scanner->revalidate(filePath(index));
+    for (int row = 0; row < rowCount(index); ++row) {
+        const QModelIndex child = this->index(row, 0, index);
+        if (isDirectory(child)) {
+            scanner->revalidate(filePath(child));
+        }
+    }
+}
+
+void DirectorySizeModel::setSourceModel(QAbstractItemModel *model) {
+    if (sourceModel()) {
+        disconnect(sourceModel(), nullptr, this, nullptr);
+    }
+    shown.clear();
+    QIdentityProxyModel::setSourceModel(model);
+    if (!model) {
+        return;
+    }
+
+    // An entry appearing or vanishing changes the directory's mtime
+    auto revalidateParent = [this](const QModelIndex& parent) {
+        if (parent.isValid()) {
+            scanner->revalidate(filePath(mapFromSource(parent)));
+        }
+    };
+    connect(model, &QAbstractItemModel::rowsInserted, this, revalidateParent);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, revalidateParent);
+    connect(model, &QAbstractItemModel::modelReset, this, [this]() { shown.clear(); });
+}
+
+QVariant DirectorySizeModel::data(const QModelIndex& index, int role) const {
+    if (index.column() != column || (role != Qt::DisplayRole && role != Qt::ToolTipRole)
+        || !isDirectory(index)) {
+        return QIdentityProxyModel::data(index, role);
+    }
+
+    const QString path = filePath(index);
+    if (!shown.contains(path)) {
+        shown.insert(path, QPersistentModelIndex(index));
+    }
+    DirectorySizeTree::Totals totals;
+    if (!scanner->totals(path, totals)) {
+        scanner->request(path);
+        return role == Qt::DisplayRole ? QVariant(QString::fromUtf8("…")) : QVariant();
+    }
+    if (role == Qt::ToolTipRole) {
+        return tr("%1 files in %2 folders").arg(totals.files).arg(totals.directories);
+    }
+    return QLocale().formattedDataSize(totals.bytes);
+}
+
+void DirectorySizeModel::onSizesChanged(const QStringList& directories) {
+    for (const QString& directory : directories) {
+        const auto it = shown.constFind(directory);
+        if (it == shown.constEnd()) {
+            continue;
+        }
+        if (!it->isValid()) {
+            shown.erase(it);
+            continue;
+        }
+        const QModelIndex index(*it);
+        emit dataChanged(index, index, {Qt::DisplayRole, Qt::ToolTipRole});
+    }
+}
+
+bool DirectorySizeModel::isDirectory(const QModelIndex& index) const {
+    // QFileSystemModel answers hasChildren() with isDir() for column 0
+    return index.isValid() && hasChildren(index.sibling(index.row(), 0));
+}
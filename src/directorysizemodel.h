@@ -0,0 +1,48 @@
+#ifndef DIRECTORYSIZEMODEL_H
+#define DIRECTORYSIZEMODEL_H
+
+#include <QHash>
+#include <QIdentityProxyModel>
+#include <QPersistentModelIndex>
+#include "directorysizescanner.h"
+
+// Shows recursive directory sizes in the size column of a file system
+// model, which leaves that column empty for directories. A directory is
+// handed to the scanner the first time a view asks for its row, and its
+// total needs its whole subtree listed: showing the children of the root
+// counts everything below them. Until its total arrives the cell shows an
+// ellipsis. The count runs in the background, newest request first, and is
+// not sampled. Rows inserted into or removed from a directory revalidate
+// it, and refresh() revalidates a directory with its visible
+// subdirectories, which is enough to catch changes below expanded rows.
+class DirectorySizeModel : public QIdentityProxyModel {
+    Q_OBJECT
+
+public:
+    explicit DirectorySizeModel(DirectorySizeScanner *scanner, QObject *parent = nullptr);
+
+    // Column replaced for directories, 1 in QFileSystemModel
+    void setSizeColumn(int column);
+    int sizeColumn() const;
+    // Role the source model returns absolute paths for,
+    // QFileSystemModel::FilePathRole by default
+    void setPathRole(int role);
+
+    QString filePath(const QModelIndex& index) const;
+    void refresh(const QModelIndex& index);
+
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+private:
+    void onSizesChanged(const QStringList& directories);
+    bool isDirectory(const QModelIndex& index) const;
+
+    DirectorySizeScanner *scanner;
+    int column = 1;
+    int pathRole = Qt::UserRole + 1;
+    // Rows a view has asked about, to tell it when their size arrives
+    mutable QHash<QString, QPersistentModelIndex> shown;
+};
+
+#endif // DIRECTORYSIZEMODEL_H
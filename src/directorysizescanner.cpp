@@ -0,0 +1,179 @@
+#include "directorysizescanner.h"
+#include "directorywalker.h"
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+
+#ifdef Q_OS_LINUX
+#include <sys/stat.h>
+#endif
+
+DirectorySizeScanner::DirectorySizeScanner(QObject *parent)
+    : QObject(parent)
+    , threads(QThread::idealThreadCount())
+{
+    pool.setMaxThreadCount(threads);
+    publishTimer.start();
+}
+
+DirectorySizeScanner::~DirectorySizeScanner() {
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        tasks.clear();
+    }
+    pool.waitForDone();
+}
+
+void DirectorySizeScanner::setThreadCount(int count) {
+    QMutexLocker locker(&mutex);
+    threads = qMax(1, count);
+    pool.setMaxThreadCount(threads);
+}
+
+int DirectorySizeScanner::threadCount() const {
+    QMutexLocker locker(&mutex);
+    return threads;
+}
+
+void DirectorySizeScanner::request(const QString& directory) {
+    QMutexLocker locker(&mutex);
+    const DirectorySizeTree::Node node = tree.insert(directory);
+    if (tree.request(node)) {
+        enqueue({tree.path(node), false});
+    }
+}
+
+void DirectorySizeScanner::revalidate(const QString& directory) {
+    QMutexLocker locker(&mutex);
+    const DirectorySizeTree::Node node = tree.find(directory);
+    if (tree.state(node) == DirectorySizeTree::State::Complete) {
+        enqueue({tree.path(node), true});
+    }
+}
+
+bool DirectorySizeScanner::totals(const QString& directory, DirectorySizeTree::Totals& totals) const {
+    QMutexLocker locker(&mutex);
+    const DirectorySizeTree::Node node = tree.find(directory);
+    const DirectorySizeTree::State state = tree.state(node);
+    if (node == DirectorySizeTree::NoNode
+        || (state != DirectorySizeTree::State::Complete && state != DirectorySizeTree::State::Stale)) {
+        return false;
+    }
+    totals = tree.totals(node);
+    return true;
+}
+
+DirectorySizeTree::State DirectorySizeScanner::state(const QString& directory) const {
+    QMutexLocker locker(&mutex);
+    const DirectorySizeTree::Node node = tree.find(directory);
+    return node == DirectorySizeTree::NoNode ? DirectorySizeTree::State::Unknown : tree.state(node);
+}
+
+bool DirectorySizeScanner::isIdle() const {
+    QMutexLocker locker(&mutex);
+    return running == 0;
+}
+
+void DirectorySizeScanner::clear() {
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        tasks.clear();
+    }
+    pool.waitForDone();
+    QMutexLocker locker(&mutex);
+    tree.clear();
+    changed.clear();
+    stopping = false;
+}
+
+void DirectorySizeScanner::enqueue(const Task& task) {
+    // Called with the mutex held
+    tasks.append(task);
+    if (running < threads) {
+        ++running;
+        pool.start([this]() { workerLoop(); });
+    }
+}
+
+void DirectorySizeScanner::workerLoop() {
+    for (;;) {
+        Task task;
+        QStringList batch;
+        {
+            QMutexLocker locker(&mutex);
+            if (stopping || tasks.isEmpty()) {
+                // The last worker out publishes what is left
+                if (--running == 0 && !stopping) {
+                    batch.swap(changed);
+                    publishTimer.restart();
+                }
+                locker.unlock();
+                if (!batch.isEmpty()) {
+                    emit sizesChanged(batch);
+                }
+                return;
+            }
+            task = tasks.takeLast();
+        }
+
+        if (task.validate) {
+            const qint64 mtimeNs = modificationTime(task.path);
+            QMutexLocker locker(&mutex);
+            if (!tree.revalidate(tree.find(task.path), mtimeNs)) {
+                continue;
+            }
+        }
+
+        const DirectorySizeTree::Listing listing = list(task.path);
+        {
+            QMutexLocker locker(&mutex);
+            for (const QString& subdirectory : tree.applyListing(task.path, listing, changed)) {
+                enqueue({subdirectory, false});
+            }
+            if (publishTimer.hasExpired(PublishInterval)) {
+                batch.swap(changed);
+                publishTimer.restart();
+            }
+        }
+        if (!batch.isEmpty()) {
+            emit sizesChanged(batch);
+        }
+    }
+}
+
+DirectorySizeTree::Listing DirectorySizeScanner::list(const QString& directory) {
+    DirectorySizeTree::Listing listing;
+    // Taken before reading the entries, so a change during the listing
+    // shows up as a moved mtime on the next revalidation
+    listing.mtimeNs = modificationTime(directory);
+
+    DirectoryWalker walker(directory, DirectoryWalker::StatFiles | DirectoryWalker::Directories);
+    walker.walk([&listing](const DirectoryWalker::Entry& entry) {
+        if (entry.directory) {
+            const QByteArray path = QFile::encodeName(entry.path);
+            listing.directories.append({path.mid(path.lastIndexOf('/') + 1), entry.mtimeNs});
+        } else {
+            listing.bytes += entry.size;
+            ++listing.files;
+        }
+        return true;
+    });
+    return listing;
+}
+
+qint64 DirectorySizeScanner::modificationTime(const QString& directory) {
+    // Must agree with the mtimes DirectoryWalker reports for subdirectories
+#ifdef Q_OS_LINUX
+    struct stat st;
+    if (::stat(QFile::encodeName(directory).constData(), &st) != 0) {
+        return -1;
+    }
+    return qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    const QFileInfo info(directory);
+    return info.exists() ? info.lastModified().toMSecsSinceEpoch() * 1000000 : -1;
+#endif
+}
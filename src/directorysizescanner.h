@@ -0,0 +1,70 @@
+#ifndef DIRECTORYSIZESCANNER_H
+#define DIRECTORYSIZESCANNER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include "directorysizetree.h"
+
+// Computes recursive directory sizes in the background, on demand. Every
+// requested directory is split into one listing task per subdirectory; the
+// tasks run on a private pool, newest first, so the directory a user just
+// expanded is counted before older requests. Results accumulate in a
+// DirectorySizeTree and stay cached for later requests; revalidate() costs
+// one stat and relists only directories whose mtime moved.
+//
+// Sizes are apparent file sizes. Hardlinks are counted once per directory,
+// not once per tree.
+class DirectorySizeScanner : public QObject {
+    Q_OBJECT
+
+public:
+    explicit DirectorySizeScanner(QObject *parent = nullptr);
+    ~DirectorySizeScanner();
+
+    void setThreadCount(int count);
+    int threadCount() const;
+
+    // Starts counting directory unless it is known or already under way
+    void request(const QString& directory);
+    void revalidate(const QString& directory);
+    // False until the first count of directory has finished; a directory
+    // being recounted reports its previous totals
+    bool totals(const QString& directory, DirectorySizeTree::Totals& totals) const;
+    DirectorySizeTree::State state(const QString& directory) const;
+    bool isIdle() const;
+    void clear();
+
+signals:
+    // Directories whose totals became known or changed, batched to at most
+    // one emission per PublishInterval; emitted from worker threads
+    void sizesChanged(const QStringList& directories);
+
+private:
+    struct Task {
+        QString path;
+        bool validate = false;
+    };
+
+    void enqueue(const Task& task);
+    void workerLoop();
+    static DirectorySizeTree::Listing list(const QString& directory);
+    static qint64 modificationTime(const QString& directory);
+
+    mutable QMutex mutex;
+    DirectorySizeTree tree;
+    QVector<Task> tasks;
+    QStringList changed;
+    QElapsedTimer publishTimer;
+    QThreadPool pool;
+    int threads;
+    int running = 0;
+    bool stopping = false;
+
+    static constexpr int PublishInterval = 100;
+};
+
+#endif // DIRECTORYSIZESCANNER_H
@@ -0,0 +1,313 @@
+#include "directorysizetree.h"
+#include <QDir>
+#include <QFile>
+#include <algorithm>
+#include <cstring>
+
+DirectorySizeTree::DirectorySizeTree() {
+    clear();
+}
+
+QList<QByteArray> DirectorySizeTree::components(const QString& path) {
+    const QString clean = QDir::cleanPath(QDir(path).absolutePath());
+    QList<QByteArray> parts = QFile::encodeName(clean).split('/');
+    // "/" splits into two empty parts; the leading one is the filesystem root
+    while (parts.size() > 1 && parts.last().isEmpty()) {
+        parts.removeLast();
+    }
+    return parts;
+}
+
+QByteArray DirectorySizeTree::nameOf(const NodeData& node) const {
+    return names.mid(node.nameOffset, node.nameLength);
+}
+
+int DirectorySizeTree::compareName(const NodeData& node, const QByteArray& name) const {
+    const int length = qMin(int(node.nameLength), int(name.size()));
+    const int order = std::memcmp(names.constData() + node.nameOffset, name.constData(), size_t(length));
+    return order != 0 ? order : int(node.nameLength) - int(name.size());
+}
+
+DirectorySizeTree::Node DirectorySizeTree::child(Node parent, const QByteArray& name) const {
+    const NodeData& data = nodes[parent];
+    Node low = data.firstChild;
+    Node high = data.firstChild + data.childCount;
+    while (low < high) {
+        const Node middle = low + (high - low) / 2;
+        const int order = compareName(nodes[middle], name);
+        if (order == 0) {
+            return middle;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return NoNode;
+}
+
+DirectorySizeTree::Node DirectorySizeTree::find(const QString& path) const {
+    Node node = 0;
+    for (const QByteArray& name : components(path)) {
+        node = child(node, name);
+        if (node == NoNode) {
+            break;
+        }
+    }
+    return node;
+}
+
+DirectorySizeTree::Node DirectorySizeTree::insert(const QString& path) {
+    Node node = 0;
+    for (const QByteArray& name : components(path)) {
+        Node next = child(node, name);
+        if (next == NoNode) {
+            QVector<QByteArray> siblings;
+            const NodeData& data = nodes[node];
+            for (Node i = data.firstChild; i < data.firstChild + data.childCount; ++i) {
+                siblings.append(nameOf(nodes[i]));
+            }
+            siblings.insert(std::lower_bound(siblings.begin(), siblings.end(), name), name);
+            setChildren(node, siblings);
+            next = child(node, name);
+        }
+        node = next;
+    }
+    return node;
+}
+
+QString DirectorySizeTree::path(Node node) const {
+    QList<QByteArray> parts;
+    for (; node != 0 && node != NoNode; node = nodes[node].parent) {
+        parts.prepend(nameOf(nodes[node]));
+    }
+    QByteArray joined = parts.join('/');
+    if (!joined.contains('/')) {
+        joined += '/';
+    }
+    return QFile::decodeName(joined);
+}
+
+DirectorySizeTree::State DirectorySizeTree::state(Node node) const {
+    return node < nodes.size() ? nodes[node].state : State::Unknown;
+}
+
+DirectorySizeTree::Totals DirectorySizeTree::totals(Node node) const {
+    return node < nodes.size() ? nodes[node].total : Totals();
+}
+
+bool DirectorySizeTree::request(Node node) {
+    if (node == 0 || node >= nodes.size() || nodes[node].state != State::Unknown) {
+        return false;
+    }
+    nodes[node].state = State::Pending;
+    return true;
+}
+
+bool DirectorySizeTree::revalidate(Node node, qint64 mtimeNs) {
+    if (node == 0 || node >= nodes.size() || nodes[node].state != State::Complete
+        || nodes[node].mtimeNs == mtimeNs) {
+        return false;
+    }
+    nodes[node].state = State::Stale;
+    return true;
+}
+
+void DirectorySizeTree::setChildren(Node parent, const QVector<QByteArray>& childNames) {
+    const Node oldFirst = nodes[parent].firstChild;
+    const quint32 oldCount = nodes[parent].childCount;
+    const std::vector<NodeData> old(nodes.begin() + oldFirst, nodes.begin() + oldFirst + oldCount);
+
+    // Shrinking lists are rewritten in place, growing ones move to the end
+    Node first = oldFirst;
+    if (quint32(childNames.size()) > oldCount) {
+        first = Node(nodes.size());
+        nodes.resize(nodes.size() + size_t(childNames.size()));
+        garbage += oldCount;
+    } else {
+        garbage += oldCount - quint32(childNames.size());
+    }
+
+    quint32 o = 0;
+    for (int i = 0; i < childNames.size(); ++i) {
+        while (o < oldCount && compareName(old[o], childNames[i]) < 0) {
+            dropSubtree(old[o++]);
+        }
+        const Node id = first + Node(i);
+        NodeData& target = nodes[id];
+        if (o < oldCount && compareName(old[o], childNames[i]) == 0) {
+            target = old[o++];
+        } else {
+            target = NodeData();
+            target.nameOffset = quint32(names.size());
+            target.nameLength = quint16(childNames[i].size());
+            names += childNames[i];
+        }
+        target.parent = parent;
+        for (Node grandchild = target.firstChild; grandchild < target.firstChild + target.childCount; ++grandchild) {
+            nodes[grandchild].parent = id;
+        }
+    }
+    while (o < oldCount) {
+        dropSubtree(old[o++]);
+    }
+
+    nodes[parent].firstChild = first;
+    nodes[parent].childCount = quint32(childNames.size());
+}
+
+void DirectorySizeTree::dropSubtree(const NodeData& node) {
+    std::vector<std::pair<Node, quint32>> ranges{{node.firstChild, node.childCount}};
+    while (!ranges.empty()) {
+        const std::pair<Node, quint32> range = ranges.back();
+        ranges.pop_back();
+        garbage += range.second;
+        for (Node i = range.first; i < range.first + range.second; ++i) {
+            ranges.emplace_back(nodes[i].firstChild, nodes[i].childCount);
+        }
+    }
+}
+
+QStringList DirectorySizeTree::applyListing(const QString& directory, const Listing& listing,
+                                            QStringList& changed) {
+    const Node node = find(directory);
+    if (node == NoNode || node == 0
+        || (nodes[node].state != State::Pending && nodes[node].state != State::Stale)) {
+        return QStringList();
+    }
+
+    QVector<Listing::Subdirectory> subdirectories = listing.directories;
+    std::sort(subdirectories.begin(), subdirectories.end(),
+              [](const Listing::Subdirectory& a, const Listing::Subdirectory& b) { return a.name < b.name; });
+    QVector<QByteArray> childNames;
+    childNames.reserve(subdirectories.size());
+    for (const Listing::Subdirectory& subdirectory : subdirectories) {
+        childNames.append(subdirectory.name);
+    }
+    setChildren(node, childNames);
+
+    NodeData& data = nodes[node];
+    data.mtimeNs = listing.mtimeNs;
+    data.ownBytes = listing.bytes;
+    data.ownFiles = listing.files;
+    data.pending = 0;
+
+    QStringList toList;
+    for (int i = 0; i < subdirectories.size(); ++i) {
+        const Node id = data.firstChild + Node(i);
+        NodeData& childData = nodes[id];
+        switch (childData.state) {
+        case State::Complete:
+            // Unchanged subtrees keep their totals without being read again
+            if (childData.mtimeNs == subdirectories[i].mtimeNs) {
+                continue;
+            }
+            childData.state = State::Stale;
+            toList.append(path(id));
+            break;
+        case State::Unknown:
+            childData.state = State::Pending;
+            toList.append(path(id));
+            break;
+        case State::Pending:
+        case State::Stale:
+            // Already queued by an earlier request
+            break;
+        }
+        childData.awaited = true;
+        ++data.pending;
+    }
+
+    if (data.pending == 0) {
+        complete(node, changed);
+    }
+    if (garbage > 4096 && garbage > qint64(nodes.size() / 2)) {
+        compact();
+    }
+    return toList;
+}
+
+void DirectorySizeTree::complete(Node node, QStringList& changed) {
+    for (;;) {
+        NodeData& data = nodes[node];
+        Totals sum;
+        sum.bytes = data.ownBytes;
+        sum.files = data.ownFiles;
+        sum.directories = data.childCount;
+        for (Node i = data.firstChild; i < data.firstChild + data.childCount; ++i) {
+            sum.bytes += nodes[i].total.bytes;
+            sum.files += nodes[i].total.files;
+            sum.directories += nodes[i].total.directories;
+        }
+        const Totals old = data.total;
+        data.total = sum;
+        data.state = State::Complete;
+        changed.append(path(node));
+
+        if (data.awaited) {
+            data.awaited = false;
+            const Node parent = data.parent;
+            if (parent != 0 && --nodes[parent].pending == 0) {
+                node = parent;
+                continue;
+            }
+            return;
+        }
+
+        // Nobody waits for this node, so ancestors that already have totals
+        // take the difference; ones still counting will sum it themselves
+        for (Node ancestor = data.parent; ancestor != 0; ancestor = nodes[ancestor].parent) {
+            NodeData& above = nodes[ancestor];
+            if (above.state != State::Complete && above.state != State::Stale) {
+                break;
+            }
+            above.total.bytes += sum.bytes - old.bytes;
+            above.total.files += sum.files - old.files;
+            above.total.directories += sum.directories - old.directories;
+            changed.append(path(ancestor));
+        }
+        return;
+    }
+}
+
+void DirectorySizeTree::compact() {
+    // Breadth-first copy of everything reachable keeps child blocks contiguous
+    std::vector<NodeData> fresh;
+    std::vector<Node> origin;
+    QByteArray freshNames;
+    fresh.reserve(nodes.size() - size_t(garbage));
+    origin.reserve(nodes.size() - size_t(garbage));
+    fresh.push_back(nodes[0]);
+    origin.push_back(0);
+    for (size_t i = 0; i < fresh.size(); ++i) {
+        const NodeData& source = nodes[origin[i]];
+        fresh[i].firstChild = Node(fresh.size());
+        for (Node c = source.firstChild; c < source.firstChild + source.childCount; ++c) {
+            NodeData copy = nodes[c];
+            copy.parent = Node(i);
+            copy.nameOffset = quint32(freshNames.size());
+            freshNames.append(names.constData() + nodes[c].nameOffset, nodes[c].nameLength);
+            fresh.push_back(copy);
+            origin.push_back(c);
+        }
+    }
+    nodes.swap(fresh);
+    names = freshNames;
+    garbage = 0;
+}
+
+void DirectorySizeTree::clear() {
+    nodes.assign(1, NodeData());
+    nodes[0].state = State::Complete;
+    names.clear();
+    garbage = 0;
+}
+
+int DirectorySizeTree::nodeCount() const {
+    return int(nodes.size() - size_t(garbage));
+}
+
+qint64 DirectorySizeTree::memoryUsage() const {
+    return qint64(nodes.capacity() * sizeof(NodeData)) + names.capacity();
+}
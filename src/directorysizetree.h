@@ -0,0 +1,107 @@
+#ifndef DIRECTORYSIZETREE_H
+#define DIRECTORYSIZETREE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <vector>
+
+// Recursive sizes of directories, kept as a trie of path components so a
+// volume with millions of directories costs one small node and one name per
+// directory; files are only ever summed into their parent. The children of
+// a node sit in one contiguous block sorted by name, found by binary search.
+//
+// Totals are aggregated bottom-up: a listed directory waits for its
+// unfinished subdirectories and completes once the last of them does. A
+// directory whose mtime moved is relisted while its old totals stay
+// visible; subdirectories with an unchanged mtime keep their totals, and the
+// difference is carried up to the ancestors when it completes. Not thread
+// safe, DirectorySizeScanner guards it.
+class DirectorySizeTree {
+public:
+    using Node = quint32;
+    static constexpr Node NoNode = 0xffffffffu;
+
+    enum class State : quint8 {
+        Unknown,    // never listed
+        Pending,    // being counted, no totals yet
+        Stale,      // being recounted, totals are the previous ones
+        Complete
+    };
+
+    struct Totals {
+        qint64 bytes = 0;
+        qint64 files = 0;
+        qint64 directories = 0;
+    };
+
+    // A directory's own contents, as read by one listing
+    struct Listing {
+        struct Subdirectory {
+            QByteArray name;
+            qint64 mtimeNs = 0;
+        };
+
+        qint64 mtimeNs = 0;
+        qint64 bytes = 0;
+        qint64 files = 0;
+        QVector<Subdirectory> directories;
+    };
+
+    DirectorySizeTree();
+
+    Node find(const QString& path) const;
+    // Adds the missing components of path as Unknown nodes
+    Node insert(const QString& path);
+    QString path(Node node) const;
+    State state(Node node) const;
+    // Meaningful for Stale and Complete nodes
+    Totals totals(Node node) const;
+
+    // True if node has to be listed: Unknown nodes become Pending
+    bool request(Node node);
+    // True if node has to be listed again: Complete nodes whose mtime is
+    // no longer mtimeNs become Stale
+    bool revalidate(Node node, qint64 mtimeNs);
+    // Stores the listing of a Pending or Stale directory and returns the
+    // subdirectories that must be listed before it can complete. Every
+    // directory whose totals became known or moved is appended to changed.
+    QStringList applyListing(const QString& path, const Listing& listing, QStringList& changed);
+
+    void clear();
+    int nodeCount() const;
+    qint64 memoryUsage() const;
+
+private:
+    struct NodeData {
+        Node parent = NoNode;
+        Node firstChild = 0;
+        quint32 childCount = 0;
+        quint32 nameOffset = 0;
+        quint32 pending = 0;        // awaited children not complete yet
+        quint16 nameLength = 0;
+        State state = State::Unknown;
+        bool awaited = false;       // counted in the parent's pending
+        qint64 mtimeNs = 0;
+        qint64 ownBytes = 0;
+        qint64 ownFiles = 0;
+        Totals total;
+    };
+
+    static QList<QByteArray> components(const QString& path);
+    QByteArray nameOf(const NodeData& node) const;
+    int compareName(const NodeData& node, const QByteArray& name) const;
+    Node child(Node parent, const QByteArray& name) const;
+    void setChildren(Node parent, const QVector<QByteArray>& names);
+    void dropSubtree(const NodeData& node);
+    void complete(Node node, QStringList& changed);
+    void compact();
+
+    std::vector<NodeData> nodes;
+    QByteArray names;
+    // Nodes no longer reachable from the root, reclaimed by compact()
+    qint64 garbage = 0;
+};
+
+#endif // DIRECTORYSIZETREE_H
@@ -0,0 +1,364 @@
+#include "directorywalker.h"
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef Q_OS_LINUX
+
+// Layout of the records returned by getdents64(2)
+struct LinuxDirent64 {
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+constexpr int DirentBufferSize = 32 * 1024;
+
+struct DirectoryState {
+    int fd = -1;            // -1 while closed to stay within MaxOpenDirectories
+    quint64 device = 0;
+    quint64 inode = 0;
+    qint64 offset = 0;      // getdents position to resume from once reopened
+    QByteArray path;
+    QByteArray buffer;
+    int position = 0;
+    int length = 0;
+};
+
+QByteArray joinPath(const QByteArray& directory, const char *name) {
+    QByteArray path = directory;
+    if (!path.endsWith('/')) {
+        path += '/';
+    }
+    return path + name;
+}
+
+bool isDotEntry(const char *name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+qint64 modificationTime(const struct stat& st) {
+    return qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+#endif
+
+} // namespace
+
+DirectoryWalker::DirectoryWalker(const QString& rootPath, Flags walkFlags)
+    : DirectoryWalker(QStringList{rootPath}, walkFlags)
+{
+}
+
+DirectoryWalker::DirectoryWalker(const QStringList& rootPaths, Flags walkFlags)
+    : flags(walkFlags)
+{
+    for (const QString& rootPath : rootPaths) {
+        roots.append(QDir::cleanPath(QDir(rootPath).absolutePath()));
+    }
+}
+
+bool DirectoryWalker::walk(const Callback& callback) {
+    stopped = false;
+    bool complete = true;
+    for (const QString& root : std::as_const(roots)) {
+#ifdef Q_OS_LINUX
+        const bool walked = walkPosix(root, callback);
+#else
+        const bool walked = walkPortable(root, callback);
+#endif
+        if (!walked) {
+            complete = false;
+            if (stopped) {
+                break;
+            }
+        }
+    }
+    return complete;
+}
+
+quint64 DirectoryWalker::filesVisited() const {
+    return fileCount;
+}
+
+quint64 DirectoryWalker::directoriesVisited() const {
+    return directoryCount;
+}
+
+quint64 DirectoryWalker::duplicateLinksSkipped() const {
+    return skippedLinks;
+}
+
+quint64 DirectoryWalker::errors() const {
+    return errorCount;
+}
+
+bool DirectoryWalker::walkPosix(const QString& root, const Callback& callback) {
+#ifdef Q_OS_LINUX
+    std::vector<DirectoryState> stack;
+    int openCount = 0;
+
+    auto enter = [this, &stack, &openCount](int fd, const QByteArray& path) {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ++errorCount;
+            ::close(fd);
+            return;
+        }
+        // A directory seen twice is a bind mount or a loop
+        const QPair<quint64, quint64> key(quint64(st.st_dev), quint64(st.st_ino));
+        if (seenDirectories.contains(key)) {
+            ++skippedLinks;
+            ::close(fd);
+            return;
+        }
+        seenDirectories.insert(key);
+        ++directoryCount;
+
+        DirectoryState state;
+        state.fd = fd;
+        state.device = quint64(st.st_dev);
+        state.inode = quint64(st.st_ino);
+        state.path = path;
+        state.buffer.resize(DirentBufferSize);
+        stack.push_back(std::move(state));
+        ++openCount;
+    };
+
+    // Closes the outermost open ancestor of the current directory, which is
+    // reopened by path once the walk comes back to it
+    auto release = [&stack, &openCount]() {
+        for (size_t i = 0; i + 1 < stack.size(); ++i) {
+            DirectoryState& state = stack[i];
+            if (state.fd >= 0) {
+                state.offset = qint64(::lseek(state.fd, 0, SEEK_CUR));
+                ::close(state.fd);
+                state.fd = -1;
+                --openCount;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto reopen = [&release, &openCount](DirectoryState& state) {
+        if (openCount >= MaxOpenDirectories) {
+            release();
+        }
+        const int fd = ::open(state.path.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        // The path must still lead to the directory that was left
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || quint64(st.st_dev) != state.device || quint64(st.st_ino) != state.inode
+            || ::lseek(fd, state.offset, SEEK_SET) < 0) {
+            ::close(fd);
+            return false;
+        }
+        state.fd = fd;
+        ++openCount;
+        return true;
+    };
+
+    auto closeAll = [&stack, &openCount]() {
+        for (const DirectoryState& state : stack) {
+            if (state.fd >= 0) {
+                ::close(state.fd);
+            }
+        }
+        stack.clear();
+        openCount = 0;
+    };
+
+    const QByteArray rootPath = QFile::encodeName(root);
+    const int rootFd = ::open(rootPath.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        ++errorCount;
+        return false;
+    }
+    enter(rootFd, rootPath);
+
+    while (!stack.empty()) {
+        DirectoryState& dir = stack.back();
+        if (dir.fd < 0 && !reopen(dir)) {
+            // The rest of this directory is lost, which errors() reports
+            ++errorCount;
+            stack.pop_back();
+            continue;
+        }
+        if (dir.position >= dir.length) {
+            const long bytes = ::syscall(SYS_getdents64, dir.fd, dir.buffer.data(), dir.buffer.size());
+            if (bytes <= 0) {
+                if (bytes < 0) {
+                    ++errorCount;
+                }
+                ::close(dir.fd);
+                --openCount;
+                stack.pop_back();
+                continue;
+            }
+            dir.length = int(bytes);
+            dir.position = 0;
+        }
+
+        const auto *record = reinterpret_cast<const LinuxDirent64 *>(dir.buffer.constData() + dir.position);
+        dir.position += record->d_reclen;
+        const char *name = record->d_name;
+        if (isDotEntry(name)) {
+            continue;
+        }
+
+        // d_type lets us skip the stat for everything but regular files on
+        // most filesystems; fall back to fstatat where it is not filled in
+        unsigned char type = record->d_type;
+        struct stat st;
+        bool haveStat = false;
+        if (type == DT_UNKNOWN) {
+            if (::fstatat(dir.fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                ++errorCount;
+                continue;
+            }
+            haveStat = true;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : (S_ISREG(st.st_mode) ? DT_REG : DT_LNK);
+        }
+
+        if (type == DT_DIR) {
+            if (flags & Directories) {
+                Entry entry;
+                entry.path = QFile::decodeName(joinPath(dir.path, name));
+                entry.directory = true;
+                if (flags & StatFiles) {
+                    if (!haveStat && ::fstatat(dir.fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                        ++errorCount;
+                        continue;
+                    }
+                    entry.mtimeNs = modificationTime(st);
+                    entry.device = quint64(st.st_dev);
+                    entry.inode = quint64(st.st_ino);
+                }
+                if (!callback(entry)) {
+                    closeAll();
+                    stopped = true;
+                    return false;
+                }
+            }
+            if (!(flags & Recursive)) {
+                continue;
+            }
+            if (openCount >= MaxOpenDirectories) {
+                release();
+            }
+            int fd = ::openat(dir.fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd < 0 && (errno == EMFILE || errno == ENFILE) && release()) {
+                fd = ::openat(dir.fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            }
+            if (fd < 0) {
+                ++errorCount;
+                continue;
+            }
+            // enter() may reallocate the stack, dir must not be used after it
+            enter(fd, joinPath(dir.path, name));
+            continue;
+        }
+        if (type != DT_REG) {
+            continue;
+        }
+
+        Entry entry;
+        if (flags & StatFiles) {
+            if (!haveStat && ::fstatat(dir.fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                ++errorCount;
+                continue;
+            }
+            if (!S_ISREG(st.st_mode)) {
+                continue;
+            }
+            // Only multiply-linked inodes need remembering, which keeps the
+            // set small on ordinary trees
+            if (st.st_nlink > 1) {
+                const QPair<quint64, quint64> key(quint64(st.st_dev), quint64(st.st_ino));
+                if (seenLinkedFiles.contains(key)) {
+                    ++skippedLinks;
+                    continue;
+                }
+                seenLinkedFiles.insert(key);
+            }
+            entry.size = qint64(st.st_size);
+            entry.mtimeNs = modificationTime(st);
+            entry.device = quint64(st.st_dev);
+            entry.inode = quint64(st.st_ino);
+        } else {
+            entry.device = dir.device;
+            entry.inode = record->d_ino;
+        }
+        entry.path = QFile::decodeName(joinPath(dir.path, name));
+
+        ++fileCount;
+        if (!callback(entry)) {
+            closeAll();
+            stopped = true;
+            return false;
+        }
+    }
+    return true;
+#else
+    return walkPortable(root, callback);
+#endif
+}
+
+bool DirectoryWalker::walkPortable(const QString& root, const Callback& callback) {
+    if (!QFileInfo(root).isDir()) {
+        ++errorCount;
+        return false;
+    }
+
+    QDir::Filters filters = QDir::Files | QDir::Hidden | QDir::NoSymLinks;
+    if (flags & Directories) {
+        filters |= QDir::Dirs | QDir::NoDotAndDotDot;
+    }
+    QDirIterator it(root, filters,
+                    (flags & Recursive) ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+
+        Entry entry;
+        entry.path = info.absoluteFilePath();
+        entry.directory = info.isDir();
+        if (flags & StatFiles) {
+            entry.size = entry.directory ? -1 : info.size();
+            entry.mtimeNs = info.lastModified().toMSecsSinceEpoch() * 1000000;
+        }
+
+        if (entry.directory) {
+            if (!callback(entry)) {
+                stopped = true;
+                return false;
+            }
+            continue;
+        }
+        ++fileCount;
+        if (!callback(entry)) {
+            stopped = true;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef DIRECTORYWALKER_H
+#define DIRECTORYWALKER_H
+
+#include <QByteArray>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+// Depth-first directory walk that hands every regular file to a callback as
+// soon as it is read from the kernel. On Linux it reads raw getdents64
+// records relative to open directory descriptors, so memory grows with tree
+// depth rather than with the number of files. At most MaxOpenDirectories
+// descriptors are open at a time; deeper walks close the outermost ancestors
+// and reopen them by path on the way back. Files reachable through more
+// than one hardlink or bind mount are reported once, keyed by (dev, inode);
+// a walker given several roots keeps one such set across all of them.
+class DirectoryWalker {
+public:
+    struct Entry {
+        QString path;
+        qint64 size = -1;
+        qint64 mtimeNs = 0;
+        quint64 device = 0;
+        quint64 inode = 0;
+        bool directory = false;
+    };
+
+    enum Flag {
+        Recursive = 0x1,
+        StatFiles = 0x2,    // fill size/mtime/device/inode, needed for hardlink de-duplication
+        Directories = 0x4   // also report subdirectories, before descending into them
+    };
+    Q_DECLARE_FLAGS(Flags, Flag)
+
+    // Return false from the callback to stop the walk
+    using Callback = std::function<bool(const Entry& entry)>;
+
+    explicit DirectoryWalker(const QString& root, Flags flags = Flags(Recursive) | StatFiles);
+    explicit DirectoryWalker(const QStringList& roots, Flags flags = Flags(Recursive) | StatFiles);
+
+    // False when the callback stopped the walk or a root could not be read;
+    // the remaining roots are still walked in the latter case
+    bool walk(const Callback& callback);
+
+    quint64 filesVisited() const;
+    quint64 directoriesVisited() const;
+    quint64 duplicateLinksSkipped() const;
+    quint64 errors() const;
+
+    static constexpr int MaxOpenDirectories = 64;
+
+private:
+    bool walkPosix(const QString& root, const Callback& callback);
+    bool walkPortable(const QString& root, const Callback& callback);
+
+    QStringList roots;
+    Flags flags;
+    bool stopped = false;
+    QSet<QPair<quint64, quint64>> seenDirectories;
+    QSet<QPair<quint64, quint64>> seenLinkedFiles;
+    quint64 fileCount = 0;
+    quint64 directoryCount = 0;
+    quint64 skippedLinks = 0;
+    quint64 errorCount = 0;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(DirectoryWalker::Flags)
+
+#endif // DIRECTORYWALKER_H
@@ -0,0 +1,174 @@
+#include "duplicateindex.h"
+#include <algorithm>
+
+DuplicateIndex::DuplicateIndex(qint64 partialCoverage)
+    : coverage(partialCoverage)
+{
+}
+
+void DuplicateIndex::insert(const QString& path, const Entry& entry) {
+    remove(path);
+    entries.insert(path, entry);
+    bySize[entry.size].insert(path);
+}
+
+bool DuplicateIndex::remove(const QString& path) {
+    const auto it = entries.constFind(path);
+    if (it == entries.constEnd()) {
+        return false;
+    }
+    auto bucket = bySize.find(it->size);
+    bucket->remove(path);
+    if (bucket->isEmpty()) {
+        bySize.erase(bucket);
+    }
+    entries.erase(it);
+    return true;
+}
+
+void DuplicateIndex::clear() {
+    entries.clear();
+    bySize.clear();
+}
+
+bool DuplicateIndex::contains(const QString& path) const {
+    return entries.contains(path);
+}
+
+DuplicateIndex::Entry DuplicateIndex::entry(const QString& path) const {
+    return entries.value(path);
+}
+
+int DuplicateIndex::size() const {
+    return entries.size();
+}
+
+QStringList DuplicateIndex::pathsUnder(const QString& directory) const {
+    const QString prefix = directory + '/';
+    QStringList paths;
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        if (it.key().startsWith(prefix)) {
+            paths.append(it.key());
+        }
+    }
+    return paths;
+}
+
+void DuplicateIndex::setPartialHash(const QString& path, const QByteArray& hash) {
+    const auto it = entries.find(path);
+    if (it != entries.end()) {
+        it->partialHash = hash;
+    }
+}
+
+void DuplicateIndex::setFullHash(const QString& path, const QByteArray& hash) {
+    const auto it = entries.find(path);
+    if (it != entries.end()) {
+        it->fullHash = hash;
+    }
+}
+
+QStringList DuplicateIndex::missingPartialHashes(qint64 size) const {
+    QStringList missing;
+    const QSet<QString> bucket = bySize.value(size);
+    if (size == 0 || bucket.size() < 2) {
+        return missing;
+    }
+    for (const QString& path : bucket) {
+        if (entries.value(path).partialHash.isEmpty()) {
+            missing.append(path);
+        }
+    }
+    return missing;
+}
+
+QStringList DuplicateIndex::missingFullHashes(qint64 size) const {
+    QStringList missing;
+    const QSet<QString> bucket = bySize.value(size);
+    if (size <= coverage || bucket.size() < 2) {
+        return missing;
+    }
+
+    QHash<QByteArray, QStringList> partialMatches;
+    for (const QString& path : bucket) {
+        const Entry& entry = entries.find(path).value();
+        if (!entry.partialHash.isEmpty()) {
+            partialMatches[entry.partialHash].append(path);
+        }
+    }
+    for (const QStringList& matches : std::as_const(partialMatches)) {
+        if (matches.size() < 2) {
+            continue;
+        }
+        for (const QString& path : matches) {
+            if (entries.value(path).fullHash.isEmpty()) {
+                missing.append(path);
+            }
+        }
+    }
+    return missing;
+}
+
+QList<qint64> DuplicateIndex::collidingSizes() const {
+    QList<qint64> sizes;
+    for (auto it = bySize.cbegin(); it != bySize.cend(); ++it) {
+        if (it->size() > 1) {
+            sizes.append(it.key());
+        }
+    }
+    return sizes;
+}
+
+QByteArray DuplicateIndex::groupKey(const Entry& entry) const {
+    if (entry.size == 0) {
+        // Empty files are trivially identical
+        return QByteArrayLiteral("empty");
+    }
+    return entry.size <= coverage ? entry.partialHash : entry.fullHash;
+}
+
+QStringList DuplicateIndex::groupOf(const QString& path) const {
+    QStringList group;
+    const auto it = entries.constFind(path);
+    if (it == entries.constEnd()) {
+        return group;
+    }
+    const QByteArray key = groupKey(*it);
+    if (key.isEmpty()) {
+        return group;
+    }
+
+    for (const QString& peer : bySize.value(it->size)) {
+        if (groupKey(entries.find(peer).value()) == key) {
+            group.append(peer);
+        }
+    }
+    if (group.size() < 2) {
+        return QStringList();
+    }
+    std::sort(group.begin(), group.end());
+    return group;
+}
+
+QList<QStringList> DuplicateIndex::groups() const {
+    QList<QStringList> groups;
+    for (auto bucket = bySize.cbegin(); bucket != bySize.cend(); ++bucket) {
+        if (bucket->size() < 2) {
+            continue;
+        }
+        QHash<QByteArray, QStringList> byKey;
+        for (const QString& path : *bucket) {
+            const QByteArray key = groupKey(entries.find(path).value());
+            if (!key.isEmpty()) {
+                byKey[key].append(path);
+            }
+        }
+        for (QStringList& group : byKey) {
+            if (group.size() > 1) {
+                std::sort(group.begin(), group.end());
+                groups.append(group);
+            }
+        }
+    }
+    return groups;
+}
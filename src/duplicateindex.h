@@ -0,0 +1,58 @@
+#ifndef DUPLICATEINDEX_H
+#define DUPLICATEINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include "hashcache.h"
+
+// Resident duplicate index for watch mode. Every file of the tree is kept
+// with its stamp and whatever digests were needed to tell it apart from the
+// files of the same size, so a single changed file is regrouped by looking
+// at its size bucket only. Files no larger than the partial hash coverage
+// are identified by their partial hash, larger ones by their full hash.
+class DuplicateIndex {
+public:
+    struct Entry {
+        qint64 size = 0;
+        HashCache::FileStamp stamp;
+        QByteArray partialHash;
+        QByteArray fullHash;
+    };
+
+    explicit DuplicateIndex(qint64 partialCoverage);
+
+    void insert(const QString& path, const Entry& entry);
+    bool remove(const QString& path);
+    void clear();
+    bool contains(const QString& path) const;
+    Entry entry(const QString& path) const;
+    int size() const;
+    QStringList pathsUnder(const QString& directory) const;
+
+    void setPartialHash(const QString& path, const QByteArray& hash);
+    void setFullHash(const QString& path, const QByteArray& hash);
+
+    // Digests still needed before the files of one size can be grouped:
+    // partial hashes once a size has two files, full hashes for large files
+    // whose partial hash collides with another one
+    QStringList missingPartialHashes(qint64 size) const;
+    QStringList missingFullHashes(qint64 size) const;
+    QList<qint64> collidingSizes() const;
+
+    // Sorted members of the group containing path, empty when it has no duplicate
+    QStringList groupOf(const QString& path) const;
+    QList<QStringList> groups() const;
+
+private:
+    QByteArray groupKey(const Entry& entry) const;
+
+    qint64 coverage;
+    QHash<QString, Entry> entries;
+    QHash<qint64, QSet<QString>> bySize;
+};
+
+#endif // DUPLICATEINDEX_H
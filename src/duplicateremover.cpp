@@ -0,0 +1,505 @@
+#include "duplicateremover.h"
+#include "contentcomparator.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef Q_OS_LINUX
+
+class DirectoryHandles {
+public:
+    explicit DirectoryHandles(const QStringList& directories) {
+        fds.reserve(directories.size());
+        for (const QString& directory : directories) {
+            fds.append(::open(QFile::encodeName(directory).constData(),
+                              O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+        }
+    }
+
+    ~DirectoryHandles() {
+        for (int fd : std::as_const(fds)) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+
+    int fd(int directory) const { return fds[directory]; }
+
+private:
+    QVector<int> fds;
+};
+
+bool sameStamp(const struct stat& st, const HashCache::FileStamp& stamp) {
+    return quint64(st.st_dev) == stamp.device
+        && quint64(st.st_ino) == stamp.inode
+        && qint64(st.st_size) == stamp.size
+        && qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec == stamp.mtimeNs;
+}
+
+#endif
+
+bool sameFile(const HashCache::FileStamp& a, const HashCache::FileStamp& b) {
+    return a.device == b.device && a.inode == b.inode;
+}
+
+// Directory entries that name path's inode, 0 where unknown
+quint64 linkCount(const QString& path) {
+#ifdef Q_OS_LINUX
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) == 0) {
+        return quint64(st.st_nlink);
+    }
+#else
+    Q_UNUSED(path);
+#endif
+    return 0;
+}
+
+} // namespace
+
+DuplicateRemover::DuplicateRemover(Mode mode, const Checkpoint& checkpoint)
+    : mode(mode)
+    , checkpoint(checkpoint)
+    , threads(QThread::idealThreadCount())
+{
+}
+
+void DuplicateRemover::setHashCache(HashCache *hashCache, int hashAlgorithm) {
+    cache = hashCache;
+    algorithm = hashAlgorithm;
+}
+
+void DuplicateRemover::setThreadCount(int count) {
+    threads = qMax(1, count);
+}
+
+int DuplicateRemover::threadCount() const {
+    return threads;
+}
+
+QString DuplicateRemover::modeName(Mode mode) {
+    switch (mode) {
+    case Mode::Delete: return "delete";
+    case Mode::Hardlink: return "hard link";
+    case Mode::Reflink: return "reflink";
+    }
+    return QString();
+}
+
+int DuplicateRemover::run(const QList<Group>& groups, const Progress& progress) {
+    errorList.clear();
+    errorCount = 0;
+    processed = 0;
+    reclaimedBytes = 0;
+    cancelled = false;
+    prepare(groups);
+
+    // Stage 1: make sure every duplicate still matches what is kept
+    if (!runParallel(originals.size(), 1, [this](int group) { verifyGroup(group); }, progress)) {
+        // Interrupted comparisons look like mismatches, they are not
+        errorList.clear();
+        errorCount = 0;
+        addError("Cancelled");
+        cancelled = true;
+        return 0;
+    }
+
+    // Stage 2: act on verified files, batched by directory
+    QVector<int> order;
+    order.reserve(targets.size());
+    for (int i = 0; i < targets.size(); ++i) {
+        if (targets[i].verified) {
+            order.append(i);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return targets[a].directory < targets[b].directory;
+    });
+
+    const QString token = QString::number(QRandomGenerator::global()->generate64(), 16);
+    std::atomic<int> done{0};
+    std::atomic<qint64> reclaimed{0};
+#ifdef Q_OS_LINUX
+    const DirectoryHandles handles(directories);
+#endif
+    const bool finished = runParallel(order.size(), RemovalBatch, [&](int i) {
+        const Target& target = targets[order[i]];
+        const QString temporaryName = QString(".dedup-%1-%2").arg(token).arg(order[i]);
+        qint64 freed = 0;
+#ifdef Q_OS_LINUX
+        const int dirfd = handles.fd(target.directory);
+#else
+        const int dirfd = -1;
+#endif
+        if (apply(target, dirfd, temporaryName, freed)) {
+            done.fetch_add(1, std::memory_order_relaxed);
+            reclaimed.fetch_add(freed, std::memory_order_relaxed);
+        }
+    }, progress);
+
+    processed = done.load();
+    reclaimedBytes = reclaimed.load();
+    cancelled = !finished;
+    if (cancelled) {
+        addError("Cancelled");
+    }
+    return processed;
+}
+
+void DuplicateRemover::prepare(const QList<Group>& groups) {
+    originals.clear();
+    groupTargets.clear();
+    targets.clear();
+    directories.clear();
+
+    QHash<QString, int> directoryIds;
+    for (const Group& group : groups) {
+        Original original;
+        if (!group.original.isEmpty()) {
+            original.path = QFileInfo(group.original).absoluteFilePath();
+            original.stamp = HashCache::stampFor(original.path);
+        }
+
+        QVector<int> members;
+        for (const QString& duplicate : group.duplicates) {
+            const QFileInfo info(duplicate);
+            Target target;
+            target.group = originals.size();
+            target.path = info.absoluteFilePath();
+            if (target.path == original.path) {
+                continue;
+            }
+
+            const QString directory = info.absolutePath();
+            auto id = directoryIds.constFind(directory);
+            if (id == directoryIds.cend()) {
+                id = directoryIds.insert(directory, directories.size());
+                directories.append(directory);
+            }
+            target.directory = *id;
+            target.name = QFile::encodeName(info.fileName());
+            members.append(targets.size());
+            targets.append(target);
+        }
+        originals.append(original);
+        groupTargets.append(members);
+    }
+}
+
+void DuplicateRemover::verifyGroup(int group) {
+    const Original& original = originals[group];
+    const QVector<int>& members = groupTargets[group];
+
+    // Every copy would be gone, so such groups are refused outright
+    if (original.path.isEmpty()) {
+        for (int index : members) {
+            addError(QString("No original is kept for %1, kept it").arg(targets[index].path));
+        }
+        return;
+    }
+    if (!original.stamp.isValid()) {
+        for (int index : members) {
+            addError(QString("Kept %1, its original %2 is missing").arg(targets[index].path, original.path));
+        }
+        return;
+    }
+
+    QByteArray originalHash;
+    bool originalLooked = false;
+    QVector<int> pending;
+    for (int index : members) {
+        Target& target = targets[index];
+        target.stamp = HashCache::stampFor(target.path);
+        if (!target.stamp.isValid()) {
+            addError(QString("File not found: %1").arg(target.path));
+            continue;
+        }
+        if (target.stamp.size != original.stamp.size) {
+            addError(QString("Changed since the scan, kept: %1").arg(target.path));
+            continue;
+        }
+        if (sameFile(target.stamp, original.stamp)) {
+            // Only a separate hard link may go. The original reached through
+            // a symlinked directory or a bind mount is the only copy.
+            if (QFileInfo(target.path).canonicalFilePath() != QFileInfo(original.path).canonicalFilePath()
+                && linkCount(target.path) > 1) {
+                target.verified = true;
+            } else {
+                addError(QString("Same file as the original %1, kept: %2").arg(original.path, target.path));
+            }
+            continue;
+        }
+        if (cache) {
+            QMutexLocker locker(&mutex);
+            if (!originalLooked) {
+                originalHash = cache->fullHash(original.stamp, algorithm);
+                originalLooked = true;
+            }
+            const QByteArray hash = originalHash.isEmpty() ? QByteArray() : cache->fullHash(target.stamp, algorithm);
+            if (!hash.isEmpty() && hash == originalHash) {
+                target.verified = true;
+                continue;
+            }
+        }
+        pending.append(index);
+    }
+    if (pending.isEmpty()) {
+        return;
+    }
+
+    QStringList files{original.path};
+    for (int index : std::as_const(pending)) {
+        files.append(targets[index].path);
+    }
+    ContentComparator comparator(checkpoint);
+    QSet<QString> identical;
+    for (const QStringList& part : comparator.partition(files)) {
+        if (part.contains(original.path)) {
+            identical = QSet<QString>(part.cbegin(), part.cend());
+            break;
+        }
+    }
+    const QStringList unreadable = comparator.unreadableFiles();
+    for (int index : std::as_const(pending)) {
+        Target& target = targets[index];
+        if (identical.contains(target.path)) {
+            target.verified = true;
+        } else if (unreadable.contains(original.path)) {
+            addError(QString("Cannot read the original %1, kept: %2").arg(original.path, target.path));
+        } else if (unreadable.contains(target.path)) {
+            addError(QString("Cannot read, kept: %1").arg(target.path));
+        } else {
+            addError(QString("Changed since the scan, kept: %1").arg(target.path));
+        }
+    }
+}
+
+bool DuplicateRemover::apply(const Target& target, int dirfd, const QString& temporaryName,
+                             qint64& reclaimed) {
+    const Original& original = originals[target.group];
+#ifdef Q_OS_LINUX
+    if (dirfd < 0) {
+        addError(QString("Cannot open the directory of %1").arg(target.path));
+        return false;
+    }
+    const char *name = target.name.constData();
+    const QByteArray temporary = QFile::encodeName(temporaryName);
+
+    bool ok = false;
+    int error = 0;
+    struct stat st;
+    if (::fstatat(dirfd, name, &st, 0) != 0 || !sameStamp(st, target.stamp)) {
+        addError(QString("Changed since it was verified, kept: %1").arg(target.path));
+        return false;
+    }
+    if (sameFile(target.stamp, original.stamp)) {
+        if (mode != Mode::Delete) {
+            return true;
+        }
+        if (st.st_nlink < 2) {
+            addError(QString("Same file as the original %1, kept: %2").arg(original.path, target.path));
+            return false;
+        }
+    }
+    // A symlink to the content frees only itself
+    struct stat entry;
+    const bool isLink = ::fstatat(dirfd, name, &entry, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(entry.st_mode);
+    const qint64 freed = !isLink && st.st_nlink == 1 ? qint64(st.st_size) : 0;
+
+    // The duplicate is only gone for good if what is kept still holds the
+    // verified content, so the original is checked again as well
+    const QByteArray originalPath = QFile::encodeName(original.path);
+    struct stat kept;
+    if (::stat(originalPath.constData(), &kept) != 0 || !sameStamp(kept, original.stamp)) {
+        addError(QString("The original %1 changed since it was verified, kept: %2").arg(original.path, target.path));
+        return false;
+    }
+
+    switch (mode) {
+    case Mode::Delete:
+        ok = ::unlinkat(dirfd, name, 0) == 0;
+        error = errno;
+        break;
+    case Mode::Hardlink:
+        ok = ::linkat(AT_FDCWD, originalPath.constData(), dirfd, temporary.constData(), 0) == 0;
+        error = errno;
+        // The path may have been replaced since the check, the link may not
+        if (ok && (::fstatat(dirfd, temporary.constData(), &kept, AT_SYMLINK_NOFOLLOW) != 0
+                   || !sameStamp(kept, original.stamp))) {
+            ::unlinkat(dirfd, temporary.constData(), 0);
+            addError(QString("The original %1 changed since it was verified, kept: %2").arg(original.path, target.path));
+            return false;
+        }
+        break;
+    case Mode::Reflink: {
+        const int source = ::open(originalPath.constData(), O_RDONLY | O_CLOEXEC);
+        if (source >= 0 && (::fstat(source, &kept) != 0 || !sameStamp(kept, original.stamp))) {
+            ::close(source);
+            addError(QString("The original %1 changed since it was verified, kept: %2").arg(original.path, target.path));
+            return false;
+        }
+        const int clone = source < 0 ? -1
+            : ::openat(dirfd, temporary.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                       st.st_mode & 07777);
+        ok = clone >= 0 && ::ioctl(clone, FICLONE, source) == 0;
+        error = errno;
+        if (ok) {
+            // The clone takes over the duplicate's permissions and times
+            const struct timespec times[2] = {st.st_atim, st.st_mtim};
+            ::fchmod(clone, st.st_mode & 07777);
+            ::futimens(clone, times);
+        }
+        if (clone >= 0) {
+            ::close(clone);
+            if (!ok) {
+                ::unlinkat(dirfd, temporary.constData(), 0);
+            }
+        }
+        if (source >= 0) {
+            ::close(source);
+        }
+        break;
+    }
+    }
+
+    // Links and clones replace the duplicate in a single rename
+    if (ok && mode != Mode::Delete) {
+        ok = ::renameat(dirfd, temporary.constData(), dirfd, name) == 0;
+        error = errno;
+        if (!ok) {
+            ::unlinkat(dirfd, temporary.constData(), 0);
+        }
+    }
+
+    if (!ok) {
+        addError(QString("Failed to %1 %2: %3").arg(modeName(mode), target.path, qt_error_string(error)));
+        return false;
+    }
+    reclaimed = freed;
+    return true;
+#else
+    Q_UNUSED(dirfd);
+    Q_UNUSED(temporaryName);
+    if (mode != Mode::Delete) {
+        addError(QString("Cannot %1 %2 on this platform").arg(modeName(mode), target.path));
+        return false;
+    }
+    if (HashCache::stampFor(target.path).mtimeNs != target.stamp.mtimeNs) {
+        addError(QString("Changed since it was verified, kept: %1").arg(target.path));
+        return false;
+    }
+    const HashCache::FileStamp kept = HashCache::stampFor(original.path);
+    if (!sameFile(kept, original.stamp) || kept.size != original.stamp.size
+        || kept.mtimeNs != original.stamp.mtimeNs) {
+        addError(QString("The original %1 changed since it was verified, kept: %2").arg(original.path, target.path));
+        return false;
+    }
+    const bool isLink = QFileInfo(target.path).isSymLink();
+    if (!QFile::remove(target.path)) {
+        addError(QString("Failed to remove: %1").arg(target.path));
+        return false;
+    }
+    reclaimed = isLink ? 0 : target.stamp.size;
+    return true;
+#endif
+}
+
+bool DuplicateRemover::runParallel(int count, int batchSize, const std::function<void(int)>& work,
+                                   const Progress& progress) {
+    if (count == 0) {
+        if (progress) {
+            progress(0, 0);
+        }
+        return true;
+    }
+
+    std::atomic<int> nextBatch{0};
+    std::atomic<int> finished{0};
+    std::atomic<bool> stopped{false};
+    const int batches = (count + batchSize - 1) / batchSize;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMin(threads, batches));
+    for (int worker = 0; worker < pool.maxThreadCount(); ++worker) {
+        pool.start([&]() {
+            for (;;) {
+                const int batch = nextBatch.fetch_add(1);
+                if (batch >= batches || stopped.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                if (checkpoint && !checkpoint()) {
+                    stopped = true;
+                    return;
+                }
+                const int end = qMin(count, (batch + 1) * batchSize);
+                for (int i = batch * batchSize; i < end; ++i) {
+                    work(i);
+                }
+                finished.fetch_add(end - batch * batchSize, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    // Progress goes out from this thread only, like HashEngine::finish()
+    int reported = -1;
+    while (!pool.waitForDone(50)) {
+        const int current = finished.load(std::memory_order_relaxed);
+        if (progress && current != reported) {
+            reported = current;
+            progress(current, count);
+        }
+    }
+    if (progress) {
+        progress(finished.load(), count);
+    }
+    return !stopped.load();
+}
+
+void DuplicateRemover::addError(const QString& error) {
+    QMutexLocker locker(&mutex);
+    if (++errorCount <= MaxReportedErrors) {
+        errorList << error;
+    }
+}
+
+int DuplicateRemover::duplicateCount() const {
+    return targets.size();
+}
+
+int DuplicateRemover::processedCount() const {
+    return processed;
+}
+
+qint64 DuplicateRemover::bytesReclaimed() const {
+    return reclaimedBytes;
+}
+
+QStringList DuplicateRemover::errors() const {
+    QStringList result = errorList;
+    if (errorCount > MaxReportedErrors) {
+        result << QString("... and %1 more").arg(errorCount - MaxReportedErrors);
+    }
+    return result;
+}
+
+bool DuplicateRemover::wasCancelled() const {
+    return cancelled;
+}
@@ -0,0 +1,101 @@
+#ifndef DUPLICATEREMOVER_H
+#define DUPLICATEREMOVER_H
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+#include "hashcache.h"
+
+// Reclaims the space held by confirmed duplicates, either by deleting them
+// or by replacing each with a hard link or a copy-on-write clone (FICLONE)
+// of the file that is kept. A pre-flight stage first re-verifies every
+// duplicate against that original: digests from the hash cache answer for
+// files whose stamp is unchanged, the rest are compared byte for byte.
+// Verified files are then processed in per-directory batches on a worker
+// pool with unlinkat/linkat/renameat relative to one descriptor per
+// directory. Each one and its original are re-stamped right before it is
+// touched, and a pair where either has changed is kept.
+class DuplicateRemover {
+public:
+    using Checkpoint = std::function<bool()>;
+    using Progress = std::function<void(int done, int total)>;
+
+    enum class Mode {
+        Delete,     // unlink the duplicates
+        Hardlink,   // replace duplicates with hard links to the original
+        Reflink     // replace duplicates with copy-on-write clones (btrfs, XFS)
+    };
+
+    // The original is kept and every duplicate must still match it. Groups
+    // without an original are refused.
+    struct Group {
+        QString original;
+        QStringList duplicates;
+    };
+
+    explicit DuplicateRemover(Mode mode, const Checkpoint& checkpoint = Checkpoint());
+
+    // Digests recorded by the scan let unchanged files skip the comparison
+    void setHashCache(HashCache *cache, int algorithm);
+    void setThreadCount(int count);
+    int threadCount() const;
+
+    // Progress is reported for the verification stage and then for the
+    // removal stage, from the calling thread. Returns the files processed.
+    int run(const QList<Group>& groups, const Progress& progress = Progress());
+
+    int duplicateCount() const;
+    int processedCount() const;
+    qint64 bytesReclaimed() const;
+    QStringList errors() const;
+    bool wasCancelled() const;
+
+    static QString modeName(Mode mode);
+
+    static constexpr int RemovalBatch = 256;
+    static constexpr int MaxReportedErrors = 100;
+
+private:
+    struct Target {
+        int group = -1;
+        int directory = -1;
+        QString path;
+        QByteArray name;
+        HashCache::FileStamp stamp;
+        bool verified = false;
+    };
+
+    struct Original {
+        QString path;
+        HashCache::FileStamp stamp;
+    };
+
+    void prepare(const QList<Group>& groups);
+    void verifyGroup(int group);
+    bool apply(const Target& target, int dirfd, const QString& temporaryName, qint64& reclaimed);
+    bool runParallel(int count, int batchSize, const std::function<void(int)>& work,
+                     const Progress& progress);
+    void addError(const QString& error);
+
+    Mode mode;
+    Checkpoint checkpoint;
+    HashCache *cache = nullptr;
+    int algorithm = 0;
+    int threads;
+
+    QVector<Original> originals;
+    QVector<QVector<int>> groupTargets;
+    QVector<Target> targets;
+    QStringList directories;
+
+    QMutex mutex;
+    QStringList errorList;
+    int errorCount = 0;
+    int processed = 0;
+    qint64 reclaimedBytes = 0;
+    bool cancelled = false;
+};
+
+#endif // DUPLICATEREMOVER_H
@@ -0,0 +1,349 @@
+#include "duplicateresultmodel.h"
+#include <QSet>
+
+// Top-level rows carry internal id 0, file rows carry their group index + 1
+
+DuplicateResultModel::DuplicateResultModel(QObject *parent)
+    : QAbstractItemModel(parent)
+{
+    groupStarts.append(0);
+}
+
+void DuplicateResultModel::clear() {
+    beginResetModel();
+    directories.clear();
+    directoryIds.clear();
+    fileDirectories.clear();
+    nameOffsets.clear();
+    names.clear();
+    unusedNameBytes = 0;
+    groupStarts = QVector<int>{0};
+    checked.clear();
+    fetchedGroups = 0;
+    source = GroupSource();
+    sourceCount = 0;
+    sourceNext = 0;
+    endResetModel();
+}
+
+void DuplicateResultModel::appendGroups(const QList<QStringList>& groups) {
+    const bool showingAll = fetchedGroups == groupCount();
+    storeGroups(groups);
+
+    // A view scrolled to the end would not ask again, so reveal the next
+    // batch right away; otherwise wait for fetchMore()
+    if (showingAll && canFetchMore(QModelIndex())) {
+        fetchMore(QModelIndex());
+    }
+}
+
+void DuplicateResultModel::setGroupSource(int count, const GroupSource& groupSource) {
+    const bool showingAll = fetchedGroups == groupCount();
+    source = groupSource;
+    sourceCount = count;
+    sourceNext = 0;
+    if (showingAll && canFetchMore(QModelIndex())) {
+        fetchMore(QModelIndex());
+    }
+}
+
+void DuplicateResultModel::storeGroups(const QList<QStringList>& groups) {
+    for (const QStringList& group : groups) {
+        for (const QString& path : group) {
+            const int slash = path.lastIndexOf('/');
+            const QString directory = path.left(qMax(slash, 0));
+            auto it = directoryIds.constFind(directory);
+            if (it == directoryIds.constEnd()) {
+                it = directoryIds.insert(directory, quint32(directories.size()));
+                directories.append(directory);
+            }
+            fileDirectories.append(it.value());
+            nameOffsets.append(names.size());
+            names.append(path.mid(slash + 1).toUtf8());
+            names.append('\0');
+        }
+        groupStarts.append(fileDirectories.size());
+    }
+    checked.resize(fileDirectories.size());
+}
+
+void DuplicateResultModel::replaceGroups(const QStringList& paths, const QList<QStringList>& groups) {
+    const QSet<QString> stale(paths.cbegin(), paths.cend());
+    QVector<int> staleGroups;
+    for (int group = 0; group < groupCount(); ++group) {
+        for (int file = groupStarts[group]; file < groupStarts[group + 1]; ++file) {
+            if (stale.contains(pathAt(file))) {
+                staleGroups.append(group);
+                break;
+            }
+        }
+    }
+
+    // Remove contiguous runs from the back so earlier group numbers stay valid
+    for (int i = staleGroups.size() - 1; i >= 0;) {
+        int first = i;
+        while (first > 0 && staleGroups[first - 1] == staleGroups[first] - 1) {
+            --first;
+        }
+        removeGroupRange(staleGroups[first], staleGroups[i]);
+        i = first - 1;
+    }
+    if (unusedNameBytes > names.size() / 2) {
+        compactNames();
+    }
+
+    appendGroups(groups);
+}
+
+int DuplicateResultModel::groupCount() const {
+    return groupStarts.size() - 1;
+}
+
+int DuplicateResultModel::fileCount() const {
+    return fileDirectories.size();
+}
+
+QString DuplicateResultModel::filePath(const QModelIndex& index) const {
+    const int file = fileIndex(index);
+    return file < 0 ? QString() : pathAt(file);
+}
+
+QStringList DuplicateResultModel::checkedPaths() const {
+    QStringList paths;
+    for (int file = 0; file < checked.size(); ++file) {
+        if (checked.testBit(file)) {
+            paths.append(pathAt(file));
+        }
+    }
+    return paths;
+}
+
+QList<DuplicateRemover::Group> DuplicateResultModel::checkedGroups() const {
+    QList<DuplicateRemover::Group> groups;
+    for (int group = 0; group + 1 < groupStarts.size(); ++group) {
+        DuplicateRemover::Group selection;
+        for (int file = groupStarts[group]; file < groupStarts[group + 1]; ++file) {
+            if (checked.testBit(file)) {
+                selection.duplicates.append(pathAt(file));
+            } else if (selection.original.isEmpty()) {
+                selection.original = pathAt(file);
+            }
+        }
+        // A fully checked group still keeps its first file
+        if (selection.original.isEmpty() && !selection.duplicates.isEmpty()) {
+            selection.original = selection.duplicates.takeFirst();
+        }
+        if (!selection.duplicates.isEmpty()) {
+            groups.append(selection);
+        }
+    }
+    return groups;
+}
+
+QModelIndex DuplicateResultModel::index(int row, int column, const QModelIndex& parent) const {
+    if (column != 0 || row < 0) {
+        return QModelIndex();
+    }
+    if (!parent.isValid()) {
+        return row < fetchedGroups ? createIndex(row, column, quintptr(0)) : QModelIndex();
+    }
+    if (parent.internalId() != 0) {
+        return QModelIndex();
+    }
+    const int group = parent.row();
+    if (row >= groupStarts[group + 1] - groupStarts[group]) {
+        return QModelIndex();
+    }
+    return createIndex(row, column, quintptr(group + 1));
+}
+
+QModelIndex DuplicateResultModel::parent(const QModelIndex& child) const {
+    if (!child.isValid() || child.internalId() == 0) {
+        return QModelIndex();
+    }
+    return createIndex(int(child.internalId() - 1), 0, quintptr(0));
+}
+
+int DuplicateResultModel::rowCount(const QModelIndex& parent) const {
+    if (!parent.isValid()) {
+        return fetchedGroups;
+    }
+    if (parent.internalId() != 0 || parent.column() != 0) {
+        return 0;
+    }
+    return groupStarts[parent.row() + 1] - groupStarts[parent.row()];
+}
+
+int DuplicateResultModel::columnCount(const QModelIndex&) const {
+    return 1;
+}
+
+bool DuplicateResultModel::hasChildren(const QModelIndex& parent) const {
+    if (!parent.isValid()) {
+        return fetchedGroups > 0;
+    }
+    return parent.internalId() == 0;
+}
+
+QVariant DuplicateResultModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid()) {
+        return QVariant();
+    }
+
+    if (index.internalId() == 0) {
+        const int group = index.row();
+        if (role == Qt::DisplayRole) {
+            return tr("Group %1 (%2 files)").arg(group + 1)
+                .arg(groupStarts[group + 1] - groupStarts[group]);
+        }
+        if (role == Qt::CheckStateRole) {
+            return groupCheckState(group);
+        }
+        return QVariant();
+    }
+
+    const int file = fileIndex(index);
+    if (role == Qt::DisplayRole || role == Qt::ToolTipRole) {
+        return pathAt(file);
+    }
+    if (role == Qt::CheckStateRole) {
+        return checked.testBit(file) ? Qt::Checked : Qt::Unchecked;
+    }
+    return QVariant();
+}
+
+bool DuplicateResultModel::setData(const QModelIndex& index, const QVariant& value, int role) {
+    if (!index.isValid() || role != Qt::CheckStateRole) {
+        return false;
+    }
+    const bool state = value.toInt() == Qt::Checked;
+
+    if (index.internalId() == 0) {
+        // Checking a group checks all of its files
+        const int group = index.row();
+        checked.fill(state, groupStarts[group], groupStarts[group + 1]);
+        const int last = groupStarts[group + 1] - groupStarts[group] - 1;
+        emit dataChanged(this->index(0, 0, index), this->index(last, 0, index), {Qt::CheckStateRole});
+        emit dataChanged(index, index, {Qt::CheckStateRole});
+        return true;
+    }
+
+    checked.setBit(fileIndex(index), state);
+    emit dataChanged(index, index, {Qt::CheckStateRole});
+    const QModelIndex groupIndex = parent(index);
+    emit dataChanged(groupIndex, groupIndex, {Qt::CheckStateRole});
+    return true;
+}
+
+Qt::ItemFlags DuplicateResultModel::flags(const QModelIndex& index) const {
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsUserCheckable;
+}
+
+QVariant DuplicateResultModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (section == 0 && orientation == Qt::Horizontal && role == Qt::DisplayRole) {
+        return tr("Duplicate files");
+    }
+    return QVariant();
+}
+
+bool DuplicateResultModel::canFetchMore(const QModelIndex& parent) const {
+    return !parent.isValid() && (fetchedGroups < groupCount() || sourceNext < sourceCount);
+}
+
+void DuplicateResultModel::fetchMore(const QModelIndex& parent) {
+    if (parent.isValid()) {
+        return;
+    }
+    if (fetchedGroups == groupCount() && sourceNext < sourceCount) {
+        const int count = qMin(FetchBatch, sourceCount - sourceNext);
+        storeGroups(source(sourceNext, count));
+        sourceNext += count;
+    }
+    const int count = qMin(FetchBatch, groupCount() - fetchedGroups);
+    if (count <= 0) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), fetchedGroups, fetchedGroups + count - 1);
+    fetchedGroups += count;
+    endInsertRows();
+}
+
+int DuplicateResultModel::fileIndex(const QModelIndex& index) const {
+    if (!index.isValid() || index.internalId() == 0) {
+        return -1;
+    }
+    return groupStarts[int(index.internalId() - 1)] + index.row();
+}
+
+void DuplicateResultModel::removeGroupRange(int first, int last) {
+    const int visibleLast = qMin(last, fetchedGroups - 1);
+    const bool visible = first <= visibleLast;
+    if (visible) {
+        beginRemoveRows(QModelIndex(), first, visibleLast);
+    }
+
+    const int fileBegin = groupStarts[first];
+    const int fileEnd = groupStarts[last + 1];
+    const int removedFiles = fileEnd - fileBegin;
+    for (int file = fileBegin; file < fileEnd; ++file) {
+        unusedNameBytes += qstrlen(names.constData() + nameOffsets[file]) + 1;
+    }
+    fileDirectories.remove(fileBegin, removedFiles);
+    nameOffsets.remove(fileBegin, removedFiles);
+    for (int file = fileEnd; file < checked.size(); ++file) {
+        checked.setBit(file - removedFiles, checked.testBit(file));
+    }
+    checked.resize(checked.size() - removedFiles);
+
+    const int removedGroups = last - first + 1;
+    groupStarts.remove(first + 1, removedGroups);
+    for (int group = first + 1; group < groupStarts.size(); ++group) {
+        groupStarts[group] -= removedFiles;
+    }
+
+    if (visible) {
+        fetchedGroups -= visibleLast - first + 1;
+        endRemoveRows();
+    }
+
+    // File rows encode their group number, which moved for every later group
+    const QModelIndexList persistent = persistentIndexList();
+    for (const QModelIndex& index : persistent) {
+        const int group = int(index.internalId()) - 1;
+        if (group > last) {
+            changePersistentIndex(index, createIndex(index.row(), index.column(),
+                                                     quintptr(group - removedGroups + 1)));
+        }
+    }
+}
+
+void DuplicateResultModel::compactNames() {
+    QByteArray compacted;
+    compacted.reserve(names.size() - unusedNameBytes);
+    for (qint64& offset : nameOffsets) {
+        const char *name = names.constData() + offset;
+        offset = compacted.size();
+        compacted.append(name, qstrlen(name) + 1);
+    }
+    names = compacted;
+    unusedNameBytes = 0;
+}
+
+QString DuplicateResultModel::pathAt(int file) const {
+    return directories[int(fileDirectories[file])] + '/'
+        + QString::fromUtf8(names.constData() + nameOffsets[file]);
+}
+
+Qt::CheckState DuplicateResultModel::groupCheckState(int group) const {
+    int count = 0;
+    for (int file = groupStarts[group]; file < groupStarts[group + 1]; ++file) {
+        count += checked.testBit(file) ? 1 : 0;
+    }
+    if (count == 0) {
+        return Qt::Unchecked;
+    }
+    return count == groupStarts[group + 1] - groupStarts[group] ? Qt::Checked : Qt::PartiallyChecked;
+}
@@ -0,0 +1,89 @@
+#ifndef DUPLICATERESULTMODEL_H
+#define DUPLICATERESULTMODEL_H
+
+#include <QAbstractItemModel>
+#include <QBitArray>
+#include <QByteArray>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+#include "duplicateremover.h"
+
+// Duplicate groups as a two-level tree: one top-level row per group and
+// one child row per file. Paths are stored as an interned directory id plus
+// a name in a shared UTF-8 arena and check states live in a bitset, so no
+// per-item objects exist. Groups become visible in FetchBatch sized steps
+// through canFetchMore()/fetchMore(), and appendGroups() may be called
+// while a scan is still producing results. replaceGroups() swaps out
+// the groups touched by a watch-mode update in place, keeping the check
+// states and row positions of every other group. setGroupSource() defers
+// even building the groups: they are pulled from the source one FetchBatch
+// at a time as the view scrolls to them.
+class DuplicateResultModel : public QAbstractItemModel {
+    Q_OBJECT
+
+public:
+    // Returns the count groups from first
+    using GroupSource = std::function<QList<QStringList>(int first, int count)>;
+
+    explicit DuplicateResultModel(QObject *parent = nullptr);
+
+    // Also drops the group source
+    void clear();
+    void appendGroups(const QList<QStringList>& groups);
+    // Shows count more groups after the current ones, fetched from source
+    // only when they come into view
+    void setGroupSource(int count, const GroupSource& source);
+    // Drops every group containing one of paths, then appends groups
+    void replaceGroups(const QStringList& paths, const QList<QStringList>& groups);
+
+    int groupCount() const;
+    int fileCount() const;
+    QString filePath(const QModelIndex& index) const;
+    QStringList checkedPaths() const;
+    // Checked files per group, with the first unchecked file as the
+    // original; where every file is checked the first one is kept
+    QList<DuplicateRemover::Group> checkedGroups() const;
+
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& child) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
+    static constexpr int FetchBatch = 500;
+
+private:
+    void storeGroups(const QList<QStringList>& groups);
+    int fileIndex(const QModelIndex& index) const;
+    QString pathAt(int file) const;
+    Qt::CheckState groupCheckState(int group) const;
+    void removeGroupRange(int first, int last);
+    void compactNames();
+
+    // Interned path storage
+    QStringList directories;
+    QHash<QString, quint32> directoryIds;
+    QVector<quint32> fileDirectories;
+    QVector<qint64> nameOffsets;
+    QByteArray names;
+    qint64 unusedNameBytes = 0;    // names of removed files, reclaimed by compactNames()
+
+    QVector<int> groupStarts;   // groupStarts[g]..groupStarts[g + 1] are the files of group g
+    QBitArray checked;
+    int fetchedGroups = 0;
+
+    GroupSource source;
+    int sourceCount = 0;
+    int sourceNext = 0;
+};
+
+#endif // DUPLICATERESULTMODEL_H
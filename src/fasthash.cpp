@@ -0,0 +1,308 @@
+#include "fasthash.h"
+#include <QtEndian>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define FASTHASH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr uint64_t Prime32 = 0x9E3779B1ULL;
+constexpr uint64_t Prime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+
+// Byte offsets into the secret
+constexpr int ScrambleOffset = 128;
+constexpr int TailOffset = 192;
+constexpr int FinalOffset = 256;
+constexpr int SecretLength = 384;
+
+struct Secret {
+    uint8_t bytes[SecretLength];
+};
+
+constexpr Secret makeSecret() {
+    Secret secret{};
+    uint64_t state = 0x52796F46696C654DULL;
+    for (int word = 0; word < SecretLength / 8; ++word) {
+        state += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        for (int byte = 0; byte < 8; ++byte) {
+            secret.bytes[word * 8 + byte] = uint8_t(z >> (8 * byte));
+        }
+    }
+    return secret;
+}
+
+alignas(32) constexpr Secret kSecret = makeSecret();
+
+inline uint64_t read64(const uint8_t *p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+inline uint64_t mulFold64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return uint64_t(product) ^ uint64_t(product >> 64);
+#else
+    const uint64_t aLo = a & 0xFFFFFFFF, aHi = a >> 32;
+    const uint64_t bLo = b & 0xFFFFFFFF, bHi = b >> 32;
+    const uint64_t loLo = aLo * bLo;
+    const uint64_t hiLo = aHi * bLo;
+    const uint64_t loHi = aLo * bHi;
+    const uint64_t hiHi = aHi * bHi;
+    const uint64_t cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+    const uint64_t upper = (hiLo >> 32) + (cross >> 32) + hiHi;
+    const uint64_t lower = (cross << 32) | (loLo & 0xFFFFFFFF);
+    return lower ^ upper;
+#endif
+}
+
+inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+void accumulateScalar(uint64_t *acc, const uint8_t *input, int stripes, const uint8_t *secret) {
+    for (int s = 0; s < stripes; ++s) {
+        const uint8_t *in = input + s * FastHash::StripeLength;
+        const uint8_t *key = secret + s * 8;
+        for (int i = 0; i < 8; ++i) {
+            const uint64_t data = read64(in + 8 * i);
+            const uint64_t dataKey = data ^ read64(key + 8 * i);
+            acc[i ^ 1] += data;
+            acc[i] += (dataKey & 0xFFFFFFFF) * (dataKey >> 32);
+        }
+    }
+}
+
+void scrambleScalar(uint64_t *acc, const uint8_t *secret) {
+    for (int i = 0; i < 8; ++i) {
+        uint64_t value = acc[i];
+        value ^= value >> 47;
+        value ^= read64(secret + 8 * i);
+        acc[i] = value * Prime32;
+    }
+}
+
+#ifdef FASTHASH_X86
+
+void accumulateSse2(uint64_t *acc, const uint8_t *input, int stripes, const uint8_t *secret) {
+    __m128i *xacc = reinterpret_cast<__m128i *>(acc);
+    for (int s = 0; s < stripes; ++s) {
+        const uint8_t *in = input + s * FastHash::StripeLength;
+        const uint8_t *key = secret + s * 8;
+        for (int i = 0; i < 4; ++i) {
+            const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 16 * i));
+            const __m128i keys = _mm_loadu_si128(reinterpret_cast<const __m128i *>(key + 16 * i));
+            const __m128i dataKey = _mm_xor_si128(data, keys);
+            const __m128i dataKeyHi = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+            const __m128i product = _mm_mul_epu32(dataKey, dataKeyHi);
+            const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            xacc[i] = _mm_add_epi64(xacc[i], _mm_add_epi64(product, swapped));
+        }
+    }
+}
+
+void scrambleSse2(uint64_t *acc, const uint8_t *secret) {
+    __m128i *xacc = reinterpret_cast<__m128i *>(acc);
+    const __m128i prime = _mm_set1_epi32(int(Prime32));
+    for (int i = 0; i < 4; ++i) {
+        __m128i value = xacc[i];
+        value = _mm_xor_si128(value, _mm_srli_epi64(value, 47));
+        value = _mm_xor_si128(value,
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(secret + 16 * i)));
+        const __m128i productLo = _mm_mul_epu32(value, prime);
+        const __m128i productHi = _mm_mul_epu32(_mm_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        xacc[i] = _mm_add_epi64(productLo, _mm_slli_epi64(productHi, 32));
+    }
+}
+
+__attribute__((target("avx2")))
+void accumulateAvx2(uint64_t *acc, const uint8_t *input, int stripes, const uint8_t *secret) {
+    __m256i *xacc = reinterpret_cast<__m256i *>(acc);
+    for (int s = 0; s < stripes; ++s) {
+        const uint8_t *in = input + s * FastHash::StripeLength;
+        const uint8_t *key = secret + s * 8;
+        for (int i = 0; i < 2; ++i) {
+            const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + 32 * i));
+            const __m256i keys = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(key + 32 * i));
+            const __m256i dataKey = _mm256_xor_si256(data, keys);
+            const __m256i dataKeyHi = _mm256_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+            const __m256i product = _mm256_mul_epu32(dataKey, dataKeyHi);
+            const __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            xacc[i] = _mm256_add_epi64(xacc[i], _mm256_add_epi64(product, swapped));
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+void scrambleAvx2(uint64_t *acc, const uint8_t *secret) {
+    __m256i *xacc = reinterpret_cast<__m256i *>(acc);
+    const __m256i prime = _mm256_set1_epi32(int(Prime32));
+    for (int i = 0; i < 2; ++i) {
+        __m256i value = xacc[i];
+        value = _mm256_xor_si256(value, _mm256_srli_epi64(value, 47));
+        value = _mm256_xor_si256(value,
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(secret + 32 * i)));
+        const __m256i productLo = _mm256_mul_epu32(value, prime);
+        const __m256i productHi = _mm256_mul_epu32(_mm256_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        xacc[i] = _mm256_add_epi64(productLo, _mm256_slli_epi64(productHi, 32));
+    }
+}
+
+#endif // FASTHASH_X86
+
+} // namespace
+
+FastHash::FastHash(Kernel kernel) {
+    if (!isSupported(kernel)) {
+        kernel = Scalar;
+    }
+
+    switch (kernel) {
+#ifdef FASTHASH_X86
+    case Avx2:
+        accumulate = accumulateAvx2;
+        scramble = scrambleAvx2;
+        break;
+    case Sse2:
+        accumulate = accumulateSse2;
+        scramble = scrambleSse2;
+        break;
+#endif
+    default:
+        accumulate = accumulateScalar;
+        scramble = scrambleScalar;
+        break;
+    }
+
+    reset();
+}
+
+void FastHash::reset() {
+    acc[0] = Prime32;
+    acc[1] = Prime64_1;
+    acc[2] = Prime64_2;
+    acc[3] = 0x165667B19E3779F9ULL;
+    acc[4] = 0x85EBCA77C2B2AE63ULL;
+    acc[5] = 0x27D4EB2F165667C5ULL;
+    acc[6] = 0xC2B2AE3D27D4EB4FULL ^ Prime32;
+    acc[7] = 0x9E3779B185EBCA87ULL ^ Prime32;
+    bufferedLength = 0;
+    totalLength = 0;
+}
+
+void FastHash::addData(const char *data, qsizetype length) {
+    if (length <= 0) {
+        return;
+    }
+
+    const uint8_t *input = reinterpret_cast<const uint8_t *>(data);
+    totalLength += uint64_t(length);
+
+    if (bufferedLength > 0) {
+        const int take = int(qMin<qsizetype>(length, BlockLength - bufferedLength));
+        std::memcpy(buffer + bufferedLength, input, take);
+        bufferedLength += take;
+        input += take;
+        length -= take;
+        if (bufferedLength < BlockLength) {
+            return;
+        }
+        processBlock(buffer);
+        bufferedLength = 0;
+    }
+
+    while (length >= BlockLength) {
+        processBlock(input);
+        input += BlockLength;
+        length -= BlockLength;
+    }
+
+    if (length > 0) {
+        std::memcpy(buffer, input, size_t(length));
+        bufferedLength = int(length);
+    }
+}
+
+void FastHash::addData(const QByteArray& data) {
+    addData(data.constData(), data.size());
+}
+
+QByteArray FastHash::result() const {
+    alignas(32) uint64_t state[8];
+    std::memcpy(state, acc, sizeof(state));
+
+    // Whole stripes of the tail use the regular keys, the last partial
+    // stripe is zero padded and uses its own key
+    const int stripes = bufferedLength / StripeLength;
+    accumulate(state, buffer, stripes, kSecret.bytes);
+    const int remaining = bufferedLength % StripeLength;
+    if (remaining > 0) {
+        alignas(32) uint8_t last[StripeLength] = {};
+        std::memcpy(last, buffer + stripes * StripeLength, size_t(remaining));
+        accumulate(state, last, 1, kSecret.bytes + TailOffset);
+    }
+
+    const uint8_t *finalKey = kSecret.bytes + FinalOffset;
+    uint64_t low = totalLength * Prime64_1;
+    uint64_t high = ~totalLength * Prime64_2;
+    for (int i = 0; i < 4; ++i) {
+        low += mulFold64(state[2 * i] ^ read64(finalKey + 16 * i),
+                         state[2 * i + 1] ^ read64(finalKey + 16 * i + 8));
+        high += mulFold64(state[2 * i] ^ read64(finalKey + 64 + 16 * i),
+                          state[2 * i + 1] ^ read64(finalKey + 64 + 16 * i + 8));
+    }
+
+    QByteArray digest(DigestLength, Qt::Uninitialized);
+    qToLittleEndian(avalanche(low), digest.data());
+    qToLittleEndian(avalanche(high), digest.data() + 8);
+    return digest;
+}
+
+FastHash::Kernel FastHash::bestKernel() {
+    static const Kernel best = isSupported(Avx2) ? Avx2 : (isSupported(Sse2) ? Sse2 : Scalar);
+    return best;
+}
+
+bool FastHash::isSupported(Kernel kernel) {
+    switch (kernel) {
+    case Scalar:
+        return true;
+#ifdef FASTHASH_X86
+    case Sse2:
+        return true;
+    case Avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+QString FastHash::kernelName(Kernel kernel) {
+    switch (kernel) {
+    case Scalar:
+        return QStringLiteral("scalar");
+    case Sse2:
+        return QStringLiteral("sse2");
+    case Avx2:
+        return QStringLiteral("avx2");
+    }
+    return QString();
+}
+
+void FastHash::processBlock(const uint8_t *block) {
+    accumulate(acc, block, StripesPerBlock, kSecret.bytes);
+    scramble(acc, kSecret.bytes + ScrambleOffset);
+}
@@ -0,0 +1,51 @@
+#ifndef FASTHASH_H
+#define FASTHASH_H
+
+#include <QByteArray>
+#include <QString>
+#include <cstdint>
+
+// 128-bit non-cryptographic streaming hash for duplicate detection. The
+// inner loop follows the multiply/accumulate layout popularised by XXH3 so it
+// maps onto SSE2/AVX2 lanes; every kernel produces bit-identical digests.
+class FastHash {
+public:
+    enum Kernel {
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    explicit FastHash(Kernel kernel = bestKernel());
+
+    void reset();
+    void addData(const char *data, qsizetype length);
+    void addData(const QByteArray& data);
+    QByteArray result() const;
+
+    static Kernel bestKernel();
+    static bool isSupported(Kernel kernel);
+    static QString kernelName(Kernel kernel);
+
+    static constexpr int DigestLength = 16;
+    static constexpr int StripeLength = 64;
+    static constexpr int StripesPerBlock = 8;
+    static constexpr int BlockLength = StripeLength * StripesPerBlock;
+
+private:
+    using AccumulateFunction = void (*)(uint64_t *acc, const uint8_t *input,
+                                        int stripes, const uint8_t *secret);
+    using ScrambleFunction = void (*)(uint64_t *acc, const uint8_t *secret);
+
+    void processBlock(const uint8_t *block);
+
+    AccumulateFunction accumulate;
+    ScrambleFunction scramble;
+
+    alignas(32) uint64_t acc[8];
+    alignas(32) uint8_t buffer[BlockLength];
+    int bufferedLength = 0;
+    uint64_t totalLength = 0;
+};
+
+#endif // FASTHASH_H
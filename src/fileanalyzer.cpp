@@ -0,0 +1,483 @@
+#include "fileanalyzer.h"
+#include "directorywalker.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define FILEANALYZER_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+namespace {
+
+struct Magic {
+    int offset;
+    const char *bytes;
+    int length;
+    const char *mimeType;
+};
+
+// Checked in order, so longer signatures go before their prefixes
+const Magic MagicTable[] = {
+    {0, "\x89PNG\r\n\x1a\n", 8, "image/png"},
+    {0, "\xff\xd8\xff", 3, "image/jpeg"},
+    {0, "GIF87a", 6, "image/gif"},
+    {0, "GIF89a", 6, "image/gif"},
+    {0, "BM", 2, "image/bmp"},
+    {0, "II*\0", 4, "image/tiff"},
+    {0, "MM\0*", 4, "image/tiff"},
+    {0, "%PDF-", 5, "application/pdf"},
+    {0, "%!PS", 4, "application/postscript"},
+    {0, "PK\x03\x04", 4, "application/zip"},
+    {0, "PK\x05\x06", 4, "application/zip"},
+    {0, "\x1f\x8b", 2, "application/gzip"},
+    {0, "BZh", 3, "application/x-bzip2"},
+    {0, "\xfd" "7zXZ\0", 6, "application/x-xz"},
+    {0, "\x28\xb5\x2f\xfd", 4, "application/zstd"},
+    {0, "7z\xbc\xaf\x27\x1c", 6, "application/x-7z-compressed"},
+    {0, "Rar!\x1a\x07", 6, "application/vnd.rar"},
+    {257, "ustar", 5, "application/x-tar"},
+    {0, "\x7f" "ELF", 4, "application/x-executable"},
+    {0, "MZ", 2, "application/vnd.microsoft.portable-executable"},
+    {0, "\xca\xfe\xba\xbe", 4, "application/java-vm"},
+    {0, "SQLite format 3\0", 16, "application/vnd.sqlite3"},
+    {0, "ID3", 3, "audio/mpeg"},
+    {0, "OggS", 4, "audio/ogg"},
+    {0, "fLaC", 4, "audio/flac"},
+    {4, "ftyp", 4, "video/mp4"},
+    {0, "\x1a\x45\xdf\xa3", 4, "video/webm"},
+    {0, "wOFF", 4, "font/woff"},
+    {0, "wOF2", 4, "font/woff2"},
+    {0, "\0asm", 4, "application/wasm"},
+    {0, "<?xml", 5, "application/xml"},
+    {0, "#!", 2, "text/x-shellscript"},
+};
+
+bool startsWithAt(const char *data, qsizetype length, int offset, const char *bytes, int count) {
+    return length >= offset + count && std::memcmp(data + offset, bytes, size_t(count)) == 0;
+}
+
+bool startsWithTextAt(const char *data, qsizetype length, qsizetype offset, const char *text) {
+    const qsizetype count = qsizetype(std::strlen(text));
+    if (length < offset + count) {
+        return false;
+    }
+    for (qsizetype i = 0; i < count; ++i) {
+        char c = data[offset + i];
+        if (c >= 'A' && c <= 'Z') {
+            c = char(c - 'A' + 'a');
+        }
+        if (c != text[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Four interleaved tables keep consecutive equal bytes from serialising on
+// one counter; a 32-bit bin cannot overflow within one ChunkSize read
+void histogram(const uchar *data, qsizetype length, quint32 (*tables)[256]) {
+    qsizetype i = 0;
+    for (; i + 4 <= length; i += 4) {
+        quint32 word;
+        std::memcpy(&word, data + i, sizeof(word));
+        ++tables[0][word & 0xff];
+        ++tables[1][(word >> 8) & 0xff];
+        ++tables[2][(word >> 16) & 0xff];
+        ++tables[3][word >> 24];
+    }
+    for (; i < length; ++i) {
+        ++tables[0][data[i]];
+    }
+}
+
+qint64 countRepeatsScalar(const uchar *data, qsizetype length) {
+    qint64 count = 0;
+    for (qsizetype i = 1; i < length; ++i) {
+        count += data[i] == data[i - 1];
+    }
+    return count;
+}
+
+#ifdef FILEANALYZER_X86
+
+qint64 countRepeatsSse2(const uchar *data, qsizetype length) {
+    qint64 count = 0;
+    qsizetype i = 1;
+    for (; i + 16 <= length; i += 16) {
+        const __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i previous = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i - 1));
+        count += __builtin_popcount(unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(current, previous))));
+    }
+    for (; i < length; ++i) {
+        count += data[i] == data[i - 1];
+    }
+    return count;
+}
+
+__attribute__((target("avx2")))
+qint64 countRepeatsAvx2(const uchar *data, qsizetype length) {
+    qint64 count = 0;
+    qsizetype i = 1;
+    for (; i + 32 <= length; i += 32) {
+        const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i previous = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i - 1));
+        count += __builtin_popcount(unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(current, previous))));
+    }
+    for (; i < length; ++i) {
+        count += data[i] == data[i - 1];
+    }
+    return count;
+}
+
+#endif // FILEANALYZER_X86
+
+QString parentPath(const QString& path) {
+    const int slash = path.lastIndexOf('/');
+    return slash > 0 ? path.left(slash) : (slash == 0 ? QStringLiteral("/") : QString());
+}
+
+} // namespace
+
+FileAnalyzer::FileAnalyzer(const Checkpoint& checkpoint, FastHash::Kernel kernel)
+    : checkpoint(checkpoint)
+    , kernel(FastHash::isSupported(kernel) ? kernel : FastHash::Scalar)
+    , threads(QThread::idealThreadCount())
+{
+}
+
+void FileAnalyzer::setThreadCount(int count) {
+    threads = qMax(1, count);
+}
+
+int FileAnalyzer::threadCount() const {
+    return threads;
+}
+
+void FileAnalyzer::setRecursive(bool enabled) {
+    recursive = enabled;
+}
+
+void FileAnalyzer::setMaxBytesPerFile(qint64 bytes) {
+    maxBytes = qMax<qint64>(0, bytes);
+}
+
+QString FileAnalyzer::sniffMimeType(const char *data, qsizetype length) {
+    if (startsWithAt(data, length, 0, "RIFF", 4) && length >= 12) {
+        if (startsWithAt(data, length, 8, "WAVE", 4)) {
+            return QStringLiteral("audio/wav");
+        }
+        if (startsWithAt(data, length, 8, "WEBP", 4)) {
+            return QStringLiteral("image/webp");
+        }
+        if (startsWithAt(data, length, 8, "AVI ", 4)) {
+            return QStringLiteral("video/x-msvideo");
+        }
+        return QStringLiteral("application/x-riff");
+    }
+    for (const Magic& magic : MagicTable) {
+        if (startsWithAt(data, length, magic.offset, magic.bytes, magic.length)) {
+            return QString::fromLatin1(magic.mimeType);
+        }
+    }
+
+    qsizetype start = startsWithAt(data, length, 0, "\xef\xbb\xbf", 3) ? 3 : 0;
+    while (start < length && (data[start] == ' ' || data[start] == '\t'
+                              || data[start] == '\r' || data[start] == '\n')) {
+        ++start;
+    }
+    if (startsWithTextAt(data, length, start, "<!doctype html") || startsWithTextAt(data, length, start, "<html")) {
+        return QStringLiteral("text/html");
+    }
+    if (start < length && (data[start] == '{' || data[start] == '[')) {
+        return QStringLiteral("application/json");
+    }
+    return QString();
+}
+
+qint64 FileAnalyzer::countRepeats(FastHash::Kernel kernel, const uchar *data, qsizetype length, int previous) {
+    if (length <= 0) {
+        return 0;
+    }
+    qint64 count = (previous >= 0 && data[0] == previous) ? 1 : 0;
+    switch (kernel) {
+#ifdef FILEANALYZER_X86
+    case FastHash::Avx2:
+        return count + countRepeatsAvx2(data, length);
+    case FastHash::Sse2:
+        return count + countRepeatsSse2(data, length);
+#endif
+    default:
+        return count + countRepeatsScalar(data, length);
+    }
+}
+
+FileAnalyzer::FileStats FileAnalyzer::analyzeFile(const QString& filePath) const {
+    FileStats stats;
+    stats.path = filePath;
+    stats.size = QFileInfo(filePath).size();
+    analyzeInto(stats);
+    return stats;
+}
+
+void FileAnalyzer::analyzeInto(FileStats& stats) const {
+    QFile file(stats.path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        return;
+    }
+#ifdef Q_OS_LINUX
+    ::posix_fadvise(file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    thread_local std::vector<uchar> buffer;
+    buffer.resize(size_t(ChunkSize));
+    quint32 tables[4][256];
+    quint64 counts[256] = {};
+    qint64 total = 0;
+    qint64 repeats = 0;
+    int previous = -1;
+    const qint64 limit = maxBytes > 0 ? maxBytes : std::numeric_limits<qint64>::max();
+
+    qint64 length = 0;
+    while (total < limit
+           && (length = file.read(reinterpret_cast<char *>(buffer.data()), qMin(ChunkSize, limit - total))) > 0) {
+        if (total == 0) {
+            stats.mimeType = sniffMimeType(reinterpret_cast<const char *>(buffer.data()), length);
+        }
+        std::memset(tables, 0, sizeof(tables));
+        histogram(buffer.data(), length, tables);
+        for (int b = 0; b < 256; ++b) {
+            counts[b] += quint64(tables[0][b]) + tables[1][b] + tables[2][b] + tables[3][b];
+        }
+        repeats += countRepeats(kernel, buffer.data(), length, previous);
+        previous = buffer[size_t(length - 1)];
+        total += length;
+
+        if (checkpoint && !checkpoint()) {
+            return;
+        }
+    }
+    if (length < 0) {
+        // A read error leaves partial stats, which are not reported
+        return;
+    }
+    // Only the head was read when the limit stopped the loop
+    const bool atEnd = length == 0 || file.atEnd();
+    stats.readable = true;
+    if (total == 0) {
+        stats.text = true;
+        stats.entropy = 0.0;
+        stats.compressibility = 0.0;
+        if (stats.mimeType.isEmpty()) {
+            stats.mimeType = QStringLiteral("application/x-empty");
+        }
+        return;
+    }
+
+    double entropy = 0.0;
+    for (quint64 count : counts) {
+        if (count != 0) {
+            const double p = double(count) / double(total);
+            entropy -= p * std::log2(p);
+        }
+    }
+    stats.entropy = entropy;
+
+    // Order-0 bound, lowered by the share of bytes that repeat their
+    // predecessor, which LZ/RLE style compressors remove almost for free
+    const double repeatShare = double(repeats) / double(total);
+    stats.compressibility = qBound(0.0, (entropy / 8.0) * (1.0 - repeatShare), 1.0);
+
+    // Text: no NUL bytes and almost no control characters besides whitespace
+    qint64 control = 0;
+    for (int b = 0; b < 32; ++b) {
+        if (b != '\t' && b != '\n' && b != '\r' && b != '\f' && b != '\v' && b != 0x1b) {
+            control += qint64(counts[b]);
+        }
+    }
+    control += qint64(counts[0x7f]);
+    stats.text = counts[0] == 0 && control * 100 <= total;
+    if (stats.text) {
+        // An unterminated last line counts once the end was actually read
+        stats.lines = qint64(counts[uchar('\n')]) + (atEnd && previous != '\n' ? 1 : 0);
+        // Extrapolate when only the head of a large file was read
+        if (total < stats.size) {
+            stats.lines = qint64(double(stats.lines) * double(stats.size) / double(total));
+        }
+    }
+    if (stats.mimeType.isEmpty()) {
+        stats.mimeType = stats.text ? QStringLiteral("text/plain") : QStringLiteral("application/octet-stream");
+    }
+}
+
+FileAnalyzer::Report FileAnalyzer::analyze(const QString& directory, const Progress& progress) {
+    Report report;
+
+    // Each batch owns its results, so workers never share a container
+    struct Batch {
+        QVector<FileStats> files;
+    };
+    std::vector<std::unique_ptr<Batch>> batches;
+    std::atomic<int> analysed{0};
+    std::atomic<qint64> bytesRead{0};
+    std::atomic<bool> stopped{false};
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    auto dispatch = [&](std::unique_ptr<Batch> batch) {
+        Batch *work = batch.get();
+        batches.push_back(std::move(batch));
+        pool.start([this, work, &analysed, &bytesRead, &stopped]() {
+            for (FileStats& stats : work->files) {
+                if (stopped.load(std::memory_order_relaxed)) {
+                    return;
+                }
+                analyzeInto(stats);
+                if (stats.readable) {
+                    bytesRead.fetch_add(maxBytes > 0 ? qMin(stats.size, maxBytes) : stats.size,
+                                        std::memory_order_relaxed);
+                }
+                analysed.fetch_add(1, std::memory_order_relaxed);
+                if (checkpoint && !checkpoint()) {
+                    stopped = true;
+                }
+            }
+        });
+    };
+
+    DirectoryWalker::Flags walkFlags = DirectoryWalker::StatFiles;
+    if (recursive) {
+        walkFlags |= DirectoryWalker::Recursive;
+    }
+    DirectoryWalker walker(directory, walkFlags);
+    auto pending = std::make_unique<Batch>();
+    int scanned = 0;
+    walker.walk([&](const DirectoryWalker::Entry& entry) {
+        if (stopped.load(std::memory_order_relaxed) || (checkpoint && !checkpoint())) {
+            stopped = true;
+            return false;
+        }
+        FileStats stats;
+        stats.path = entry.path;
+        stats.size = entry.size;
+        pending->files.append(stats);
+        if (pending->files.size() >= AnalysisBatch) {
+            dispatch(std::move(pending));
+            pending = std::make_unique<Batch>();
+        }
+        if (++scanned % 1000 == 0 && progress) {
+            progress(analysed.load(std::memory_order_relaxed), 0);
+        }
+        return true;
+    });
+    if (!pending->files.isEmpty()) {
+        dispatch(std::move(pending));
+    }
+
+    // Progress goes out from this thread only, like HashEngine::finish()
+    int reported = -1;
+    while (!pool.waitForDone(50)) {
+        const int current = analysed.load(std::memory_order_relaxed);
+        if (progress && current != reported) {
+            reported = current;
+            progress(current, scanned);
+        }
+    }
+    if (progress) {
+        progress(analysed.load(), scanned);
+    }
+    if (stopped.load()) {
+        return report;
+    }
+
+    report.files.reserve(scanned);
+    for (const std::unique_ptr<Batch>& batch : batches) {
+        report.files.append(batch->files);
+    }
+    report.bytesRead = bytesRead.load();
+
+    // Roll sizes up to every ancestor below the scanned root
+    const QString root = QDir::cleanPath(directory);
+    QHash<QString, int> directoryIndex;
+    auto directoryFor = [&](const QString& path) -> int {
+        auto it = directoryIndex.constFind(path);
+        if (it != directoryIndex.cend()) {
+            return *it;
+        }
+        DirectoryStats stats;
+        stats.path = path;
+        report.directories.append(stats);
+        return *directoryIndex.insert(path, report.directories.size() - 1);
+    };
+
+    for (const FileStats& stats : std::as_const(report.files)) {
+        report.totalBytes += stats.size;
+        report.bytesByType[stats.mimeType.isEmpty() ? QStringLiteral("unknown") : stats.mimeType] += stats.size;
+        if (stats.text) {
+            ++report.textFiles;
+            report.textLines += stats.lines;
+        }
+
+        QString path = parentPath(stats.path);
+        report.directories[directoryFor(path)].ownSize += stats.size;
+        while (!path.isEmpty()) {
+            DirectoryStats& aggregate = report.directories[directoryFor(path)];
+            aggregate.totalSize += stats.size;
+            ++aggregate.files;
+            if (path == root || path.size() <= root.size()) {
+                break;
+            }
+            path = parentPath(path);
+        }
+    }
+
+    std::sort(report.directories.begin(), report.directories.end(),
+              [](const DirectoryStats& a, const DirectoryStats& b) {
+                  return a.totalSize > b.totalSize;
+              });
+    return report;
+}
+
+QString FileAnalyzer::summary(const Report& report, int topDirectories) {
+    QString text = QString("Analyzed %1 files, %2 bytes (%3 bytes read)\n"
+                           "%4 text files with %5 lines\n")
+        .arg(report.files.size())
+        .arg(report.totalBytes)
+        .arg(report.bytesRead)
+        .arg(report.textFiles)
+        .arg(report.textLines);
+
+    text += "Largest directories:\n";
+    for (int i = 0; i < qMin(topDirectories, int(report.directories.size())); ++i) {
+        const DirectoryStats& directory = report.directories[i];
+        text += QString("  %1: %2 bytes in %3 files\n")
+            .arg(directory.path)
+            .arg(directory.totalSize)
+            .arg(directory.files);
+    }
+
+    QVector<QPair<qint64, QString>> types;
+    for (auto it = report.bytesByType.cbegin(); it != report.bytesByType.cend(); ++it) {
+        types.append({it.value(), it.key()});
+    }
+    std::sort(types.begin(), types.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    text += "By type:";
+    for (int i = 0; i < qMin(topDirectories, int(types.size())); ++i) {
+        text += QString("\n  %1: %2 bytes").arg(types[i].second).arg(types[i].first);
+    }
+    return text;
+}
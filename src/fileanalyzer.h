@@ -1,10 +1,80 @@
 #ifndef FILEANALYZER_H
 #define FILEANALYZER_H
 
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include "fasthash.h"
+
+// Content statistics for every file of a tree. The tree is walked once while
+// files are analysed in batches on a worker pool; each file is read in one
+// streaming pass that sniffs its type from the leading magic bytes and
+// feeds a byte histogram plus a SIMD count of bytes repeating their
+// predecessor. Entropy, compressibility, the text/binary verdict and line
+// counts all come out of those counters, and sizes are rolled up per
+// directory so the largest subtrees can be listed.
 class FileAnalyzer {
 public:
-    FileAnalyzer();
-    // Add other member functions and variables as needed
+    using Checkpoint = std::function<bool()>;
+    using Progress = std::function<void(int done, int total)>;
+
+    struct FileStats {
+        QString path;
+        qint64 size = 0;
+        QString mimeType;
+        double entropy = 0.0;           // bits per byte, 0..8
+        double compressibility = 1.0;   // estimated compressed/original size, 0..1
+        qint64 lines = 0;
+        bool text = false;
+        bool readable = false;
+    };
+
+    struct DirectoryStats {
+        QString path;
+        qint64 totalSize = 0;           // including subdirectories
+        qint64 ownSize = 0;
+        int files = 0;                  // including subdirectories
+    };
+
+    struct Report {
+        QVector<FileStats> files;
+        QVector<DirectoryStats> directories;    // largest first
+        QHash<QString, qint64> bytesByType;
+        qint64 totalBytes = 0;
+        qint64 bytesRead = 0;
+        qint64 textLines = 0;
+        int textFiles = 0;
+    };
+
+    explicit FileAnalyzer(const Checkpoint& checkpoint = Checkpoint(),
+                          FastHash::Kernel kernel = FastHash::bestKernel());
+
+    void setThreadCount(int count);
+    int threadCount() const;
+    void setRecursive(bool enabled);
+    // Files larger than this are analysed from their first maxBytes only; 0 reads everything
+    void setMaxBytesPerFile(qint64 maxBytes);
+
+    Report analyze(const QString& directory, const Progress& progress = Progress());
+    FileStats analyzeFile(const QString& filePath) const;
+
+    static QString sniffMimeType(const char *data, qsizetype length);
+    // Number of positions i > 0 with data[i] == data[i - 1]; previous is the byte before data
+    static qint64 countRepeats(FastHash::Kernel kernel, const uchar *data, qsizetype length, int previous);
+    static QString summary(const Report& report, int topDirectories = 10);
+
+    static constexpr qint64 ChunkSize = 256 * 1024;
+    static constexpr int AnalysisBatch = 64;
+
+private:
+    void analyzeInto(FileStats& stats) const;
+
+    Checkpoint checkpoint;
+    FastHash::Kernel kernel;
+    int threads;
+    bool recursive = true;
+    qint64 maxBytes = 0;
 };
 
 #endif // FILEANALYZER_H
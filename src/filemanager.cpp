@@ -1,143 +1,1615 @@
 #include "filemanager.h"
+#include "hashengine.h"
+#include "fasthash.h"
+#include "directorywalker.h"
+#include "scanjob.h"
+#include "contentcomparator.h"
+#include "renameplanner.h"
+#include "contentchunker.h"
+#include "similarityindex.h"
+#include "duplicateindex.h"
+#include "digestindex.h"
+#include "scansnapshot.h"
+#include "treewatcher.h"
 #include <QCryptographicHash>
 #include <QFile>
 #include <QDir>
 #include <QDateTime>
+#include <QFileInfo>
 #include <QRegularExpression>
+#include <QThread>
+#include <QThreadPool>
+#include <QSysInfo>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <vector>
 
-FileManager::FileManager(QObject *parent) : QObject(parent) {
+namespace {
+
+// Feeds either digest from the same read loop; only the selected one is built
+class Digest {
+public:
+    explicit Digest(FileManager::HashAlgorithm algorithm) {
+        if (algorithm == FileManager::HashAlgorithm::Sha256) {
+            sha256.emplace(QCryptographicHash::Sha256);
+        } else {
+            fast.emplace();
+        }
+    }
+
+    void addData(const char *data, qsizetype length) {
+        if (sha256) {
+            sha256->addData(QByteArrayView(data, length));
+        } else {
+            fast->addData(data, length);
+        }
+    }
+
+    QByteArray result() const {
+        return sha256 ? sha256->result() : fast->result();
+    }
+
+private:
+    std::optional<QCryptographicHash> sha256;
+    std::optional<FastHash> fast;
+};
+
+} // namespace
+
+FileManager::FileManager(QObject *parent)
+    : QObject(parent)
+    , hashEngine(new HashEngine(this))
+{
+    connect(hashEngine, &HashEngine::progressUpdated, this, &FileManager::progressUpdated);
 }
 
-bool FileManager::batchRename(const QStringList& files, const QString& pattern) {
+bool FileManager::batchRename(const QStringList& files, const QString& pattern, const QString& match) {
     if (files.isEmpty() || pattern.isEmpty()) {
         emit operationCompleted(false, "No files selected or empty pattern");
         return false;
     }
+    const RenamePattern compiled(pattern, match);
+    if (!compiled.isValid()) {
+        emit operationCompleted(false, "Invalid pattern: " + compiled.errorString());
+        return false;
+    }
+
+    const int total = files.size();
+    RenamePlanner planner(compiled, [this]() { return checkpoint(); });
+    planner.setThreadCount(hashThreadCount());
+    planner.plan(files);
 
-    int total = files.size();
+    // Files the planner had to leave out are reported one error each
+    const int skipped = planner.errors().size();
     int success = 0;
-    QStringList errors;
+    if (!checkpoint()) {
+        emit operationCompleted(false, QString("Renamed 0 of %1 files\nErrors:\nCancelled").arg(total));
+        return false;
+    }
+    const qint64 renameStart = stats->now();
+    if (planner.execute([this](int done, int steps) { emit progressUpdated(done, steps); })) {
+        success = total - skipped;
+    }
+    stats->record(ScanStats::Rename, renameStart, stats->now() - renameStart);
 
-    for (int i = 0; i < files.size(); ++i) {
-        QString filePath = files[i];
-        QFileInfo fileInfo(filePath);
-        
-        if (!fileInfo.exists()) {
-            errors << QString("File not found: %1").arg(filePath);
-            continue;
+    QString message = QString("Renamed %1 of %2 files").arg(success).arg(total);
+    const QStringList errors = planner.errors();
+    if (!errors.isEmpty()) {
+        message += "\nErrors:\n" + errors.join("\n");
+    }
+
+    emit operationCompleted(success == total, message);
+    return success == total;
+}
+
+QStringList FileManager::findDuplicatesByContent(const QString& directory) {
+    QStringList duplicates;
+    const QList<QStringList> groups = findDuplicateGroups(directory);
+    for (const QStringList& group : groups) {
+        duplicates.append(group);
+    }
+    return duplicates;
+}
+
+QList<QStringList> FileManager::findDuplicateGroups(const QString& directory) {
+    return findDuplicateGroups(QStringList{directory});
+}
+
+QList<QStringList> FileManager::findDuplicateGroups(const QStringList& directories) {
+    const QStringList roots = scanRoots(directories);
+    if (indexLimit > 0) {
+        return findDuplicateGroupsBounded(roots);
+    }
+
+    QList<QStringList> groups;
+    cache.resetCounters();
+    const int algorithmId = int(algorithm);
+
+    // Stage 1 runs while the tree is walked: the first file of each size is
+    // parked, and once a second file of that size shows up both are handed
+    // to the partial hash workers without waiting for the walk to finish
+    QVector<ScanCandidate> candidates;
+    QVector<int> jobCandidates;
+    QMap<qint64, QVector<int>> sizeBuckets;
+    QHash<qint64, ScanCandidate> firstOfSize;
+    QStringList emptyFiles;
+    int scanned = 0;
+    qint64 totalBytes = 0;
+
+    auto schedule = [&](const ScanCandidate& candidate) {
+        const int index = candidates.size();
+        candidates.append(candidate);
+        sizeBuckets[candidate.size].append(index);
+
+        candidates[index].hash = cache.partialHash(candidate.stamp, algorithmId);
+        if (candidates[index].hash.isEmpty()) {
+            hashEngine->submit(candidate.path, candidate.size);
+            jobCandidates.append(index);
         }
+    };
 
-        QString newName = pattern;
-        
-        newName.replace("%n", QString::number(i + 1).rightJustified(3, '0'));
-        newName.replace("%d", QDateTime::currentDateTime().toString("yyyyMMdd"));
-        newName.replace("%o", fileInfo.baseName());
-        newName.replace("%e", fileInfo.suffix());
+    hashEngine->begin([this](const QString& filePath, qint64 size) {
+        return calculatePartialHash(filePath, size);
+    });
 
-        QString newPath = fileInfo.absolutePath() + QDir::separator() + newName;
-        if (!fileInfo.suffix().isEmpty()) {
-            newPath += "." + fileInfo.suffix();
+    DirectoryWalker::Flags walkFlags = DirectoryWalker::StatFiles;
+    if (recursive) {
+        walkFlags |= DirectoryWalker::Recursive;
+    }
+    const qint64 walkStart = stats->now();
+    auto visit = [&](const DirectoryWalker::Entry& entry) {
+        if (!checkpoint()) {
+            return false;
+        }
+        stats->add(ScanStats::FilesListed);
+        if (++scanned % 1000 == 0) {
+            emit progressUpdated(scanned, 0);
+        }
+        totalBytes += entry.size;
+        if (entry.size == 0) {
+            emptyFiles.append(entry.path);
+            return true;
         }
 
-        if (QFile::exists(newPath) && newPath != filePath) {
-            errors << QString("Target file already exists: %1").arg(newPath);
-            continue;
+        ScanCandidate candidate;
+        candidate.path = entry.path;
+        candidate.size = entry.size;
+        candidate.stamp = stampFor(entry);
+
+        auto first = firstOfSize.find(entry.size);
+        if (first == firstOfSize.end()) {
+            firstOfSize.insert(entry.size, candidate);
+            return true;
+        }
+        if (!first->path.isEmpty()) {
+            schedule(*first);
+            first->path.clear();
         }
+        schedule(candidate);
+        return true;
+    };
+    // One walker, so a tree reachable from two roots is listed once
+    DirectoryWalker walker(roots, walkFlags);
+    walker.walk(visit);
+    stats->record(ScanStats::Walk, walkStart, stats->now() - walkStart);
 
-        if (QFile::rename(filePath, newPath)) {
-            success++;
-        } else {
-            errors << QString("Failed to rename: %1").arg(filePath);
+    // Stage 2: collect the first/last block hashes of every size collision
+    const QVector<QByteArray> partialHashes = hashEngine->finish();
+    qint64 bytesRead = 0;
+    for (int i = 0; i < partialHashes.size(); ++i) {
+        ScanCandidate& candidate = candidates[jobCandidates[i]];
+        candidate.hash = partialHashes[i];
+        if (!candidate.hash.isEmpty()) {
+            bytesRead += qMin(candidate.size, 2 * PartialHashBlock);
+            cache.insertPartialHash(candidate.stamp, algorithmId, candidate.hash);
         }
+    }
 
-        emit progressUpdated(i + 1, total);
+    if (job && job->isCancelled()) {
+        cache.save();
+        emit operationCompleted(false, "Scan cancelled");
+        return QList<QStringList>();
     }
 
-    QString message = QString("Renamed %1 of %2 files").arg(success).arg(total);
-    if (!errors.isEmpty()) {
-        message += "\nErrors:\n" + errors.join("\n");
+    int uniqueSize = 0;
+    for (const ScanCandidate& first : std::as_const(firstOfSize)) {
+        if (!first.path.isEmpty()) {
+            ++uniqueSize;
+        }
+    }
+    if (emptyFiles.size() > 1) {
+        // Empty files are trivially identical, nothing to read
+        groups.append(emptyFiles);
+    } else {
+        uniqueSize += emptyFiles.size();
     }
 
-    emit operationCompleted(success == total, message);
-    return success == total;
+    QVector<ScanCandidate> fullCandidates;
+    QVector<int> fullGroupEnds;
+    int partialUnique = 0;
+    for (auto it = sizeBuckets.cbegin(); it != sizeBuckets.cend(); ++it) {
+        const qint64 size = it.key();
+        QMap<QByteArray, QVector<int>> partialMap;
+        for (int index : it.value()) {
+            if (!candidates[index].hash.isEmpty()) {
+                partialMap[candidates[index].hash].append(index);
+            }
+        }
+
+        for (const QVector<int>& indices : std::as_const(partialMap)) {
+            if (indices.size() < 2) {
+                ++partialUnique;
+                continue;
+            }
+            if (size <= 2 * PartialHashBlock) {
+                // The partial hash already covered the whole file
+                QStringList group;
+                for (int index : indices) {
+                    group.append(candidates[index].path);
+                }
+                groups.append(group);
+            } else {
+                for (int index : indices) {
+                    fullCandidates.append(candidates[index]);
+                }
+                fullGroupEnds.append(fullCandidates.size());
+            }
+        }
+    }
+
+    // Groups are published in batches as they are confirmed so views can
+    // fill in while the expensive last stage is still running
+    int reportedGroups = 0;
+    auto reportGroups = [&]() {
+        if (groups.size() > reportedGroups && !(job && job->isCancelled())) {
+            ScanStats::Scope publishing(stats, ScanStats::Publish);
+            stats->add(ScanStats::GroupsFound, groups.size() - reportedGroups);
+            emit duplicateGroupsFound(groups.mid(reportedGroups));
+            reportedGroups = groups.size();
+        }
+    };
+    reportGroups();
+
+    // Stage 3: confirm whatever survived the cheaper stages, either by
+    // full hash or by comparing the candidates byte for byte
+    QStringList unreadable;
+    if (confirmation == ConfirmationMode::ConfirmByContent) {
+        ContentComparator comparator([this]() { return checkpoint(); });
+        int groupStart = 0;
+        for (int g = 0; g < fullGroupEnds.size(); ++g) {
+            QStringList candidatePaths;
+            for (int i = groupStart; i < fullGroupEnds[g]; ++i) {
+                candidatePaths.append(fullCandidates[i].path);
+            }
+            groupStart = fullGroupEnds[g];
+
+            {
+                ScanStats::Scope comparing(stats, ScanStats::Compare);
+                groups.append(comparator.partition(candidatePaths));
+            }
+            emit progressUpdated(groupStart, fullCandidates.size());
+            if (groups.size() - reportedGroups >= GroupReportBatch) {
+                reportGroups();
+            }
+        }
+        bytesRead += comparator.bytesRead();
+        unreadable = comparator.unreadableFiles();
+    } else {
+        hashCandidates(fullCandidates, bytesRead);
+
+        int groupStart = 0;
+        for (int groupEnd : std::as_const(fullGroupEnds)) {
+            QMap<QByteArray, QStringList> hashMap;
+            for (int i = groupStart; i < groupEnd; ++i) {
+                if (!fullCandidates[i].hash.isEmpty()) {
+                    hashMap[fullCandidates[i].hash].append(fullCandidates[i].path);
+                }
+            }
+            groupStart = groupEnd;
+
+            for (const QStringList& fileList : std::as_const(hashMap)) {
+                if (fileList.size() > 1) {
+                    groups.append(fileList);
+                }
+            }
+        }
+    }
+
+    reportGroups();
+
+    recordCacheCounters();
+    cache.save();
+    if (job && job->isCancelled()) {
+        emit operationCompleted(false, "Scan cancelled");
+        return QList<QStringList>();
+    }
+
+    QString message = QString("Found %1 sets of duplicate files\n"
+                              "Scanned %2 files: %3 skipped by size, %4 ruled out by partial hash, "
+                              "%5 fully compared\n"
+                              "Read %6 of %7 bytes\n"
+                              "Hash cache: %8 hits, %9 misses")
+                          .arg(groups.size())
+                          .arg(scanned)
+                          .arg(uniqueSize)
+                          .arg(partialUnique)
+                          .arg(fullCandidates.size())
+                          .arg(bytesRead)
+                          .arg(totalBytes)
+                          .arg(cache.hits())
+                          .arg(cache.misses());
+    message += unreadableNote(unreadable);
+
+    if (!snapshotFile.isEmpty()) {
+        // Only grouped files are kept; those settled before the full hash
+        // stage, or byte for byte, have no digest to record
+        QSet<QString> grouped;
+        for (const QStringList& group : std::as_const(groups)) {
+            grouped.unite(QSet<QString>(group.cbegin(), group.cend()));
+        }
+        QVector<ScanCandidate> snapshotFiles;
+        for (const ScanCandidate& candidate : std::as_const(fullCandidates)) {
+            if (grouped.remove(candidate.path)) {
+                snapshotFiles.append(candidate);
+            }
+        }
+        for (const ScanCandidate& candidate : std::as_const(candidates)) {
+            if (grouped.remove(candidate.path)) {
+                snapshotFiles.append(candidate);
+                snapshotFiles.last().hash.clear();
+            }
+        }
+        QString error;
+        if (!writeSnapshot(snapshotFile, snapshotFiles, groups, error)) {
+            message += "\nCannot save snapshot: " + error;
+        }
+    }
+
+    emit operationCompleted(true, message);
+    return groups;
 }
 
-QStringList FileManager::findDuplicatesByContent(const QString& directory) {
-    QStringList duplicates;
-    QDir dir(directory);
-    QStringList files = dir.entryList(QDir::Files);
-    
-    QMap<QByteArray, QStringList> hashMap;
-    int total = files.size();
-    
+// The same stages as findDuplicateGroups(), but every stage streams its
+// survivors through a DigestIndex, so memory stays near indexLimit plus the
+// groups found however many files the tree holds. The hash cache is only
+// read, since its pending digests would grow with the tree. The walk can
+// no longer overlap with partial hashing: a size only becomes a collision
+// once all files are listed.
+QList<QStringList> FileManager::findDuplicateGroupsBounded(const QStringList& roots) {
+    cache.resetCounters();
+    const bool cacheWasReadOnly = cache.isReadOnly();
+    cache.setReadOnly(true);
+    const int algorithmId = int(algorithm);
+    // Two indexes are alive at a time, one being drained into the next
+    const qint64 stageLimit = indexLimit / 2;
+    int scanned = 0;
+    qint64 totalBytes = 0;
+    qint64 bytesRead = 0;
+    qint64 sizeCandidates = 0;
+    qint64 partialCandidates = 0;
+    qint64 fullCandidates = 0;
+    int spilledRuns = 0;
+    QString error;
+
+    QList<QStringList> groups;
+    QList<QStringList> batch;
+    auto publish = [&]() {
+        if (!batch.isEmpty() && !(job && job->isCancelled())) {
+            ScanStats::Scope publishing(stats, ScanStats::Publish);
+            stats->add(ScanStats::GroupsFound, batch.size());
+            emit duplicateGroupsFound(batch);
+        }
+        groups.append(batch);
+        batch.clear();
+    };
+    auto addGroup = [&](const QStringList& group) {
+        batch.append(group);
+        if (batch.size() >= GroupReportBatch) {
+            publish();
+        }
+    };
+    auto pathsOf = [](const QVector<DigestIndex::Item>& items) {
+        QStringList paths;
+        paths.reserve(items.size());
+        for (const DigestIndex::Item& item : items) {
+            paths.append(item.path);
+        }
+        return paths;
+    };
+    auto finishIndex = [&](const DigestIndex& index) {
+        spilledRuns += index.runCount();
+        if (error.isEmpty()) {
+            error = index.errorString();
+        }
+    };
+
+    // Stage 1: every file goes into the size index
+    DigestIndex bySize(stageLimit);
+    DirectoryWalker::Flags walkFlags = DirectoryWalker::StatFiles;
+    if (recursive) {
+        walkFlags |= DirectoryWalker::Recursive;
+    }
+    const qint64 walkStart = stats->now();
+    bool ok = true;
+    auto visit = [&](const DirectoryWalker::Entry& entry) {
+        if (!checkpoint()) {
+            return false;
+        }
+        stats->add(ScanStats::FilesListed);
+        if (++scanned % 1000 == 0) {
+            emit progressUpdated(scanned, 0);
+        }
+        totalBytes += entry.size;
+        ok = bySize.insert(entry.size, QByteArray(), entry.path, stampFor(entry));
+        return ok;
+    };
+    DirectoryWalker walker(roots, walkFlags);
+    walker.walk(visit);
+    stats->record(ScanStats::Walk, walkStart, stats->now() - walkStart);
+    ok = ok && checkpoint();
+
+    // Stage 2: partial hashes of each size collision, in batches across sizes
+    DigestIndex byPartial(stageLimit);
+    QVector<DigestIndex::Item> queued;
+    auto hashPartials = [&]() {
+        QVector<QByteArray> hashes(queued.size());
+        QStringList files;
+        QVector<qint64> sizes;
+        QVector<int> slots;
+        for (int i = 0; i < queued.size(); ++i) {
+            hashes[i] = cache.partialHash(queued[i].stamp, algorithmId);
+            if (hashes[i].isEmpty()) {
+                files.append(queued[i].path);
+                sizes.append(queued[i].stamp.size);
+                slots.append(i);
+            }
+        }
+        const QVector<QByteArray> computed = hashEngine->hashFiles(files, sizes,
+            [this](const QString& filePath, qint64 size) {
+                return calculatePartialHash(filePath, size);
+            });
+        for (int i = 0; i < computed.size(); ++i) {
+            const DigestIndex::Item& item = queued[slots[i]];
+            hashes[slots[i]] = computed[i];
+            if (!computed[i].isEmpty()) {
+                bytesRead += qMin(item.stamp.size, 2 * PartialHashBlock);
+            }
+        }
+        for (int i = 0; i < queued.size(); ++i) {
+            if (!hashes[i].isEmpty()
+                && !byPartial.insert(queued[i].stamp.size, hashes[i], queued[i].path, queued[i].stamp)) {
+                return false;
+            }
+        }
+        queued.clear();
+        emit progressUpdated(int(sizeCandidates), 0);
+        return checkpoint();
+    };
+    ok = ok && bySize.forEachGroup([&](qint64 size, const QByteArray&, const QVector<DigestIndex::Item>& items) {
+        sizeCandidates += items.size();
+        if (size == 0) {
+            // Empty files are trivially identical, nothing to read
+            addGroup(pathsOf(items));
+            return true;
+        }
+        queued += items;
+        return queued.size() < IndexHashBatch || hashPartials();
+    }) && hashPartials();
+    finishIndex(bySize);
+
+    // Stage 3: confirm partial matches by full hash or byte for byte
+    DigestIndex byFull(stageLimit);
+    auto hashFull = [&]() {
+        QVector<QByteArray> hashes(queued.size());
+        QStringList files;
+        QVector<HashCache::FileStamp> stamps;
+        QVector<int> slots;
+        for (int i = 0; i < queued.size(); ++i) {
+            hashes[i] = cache.fullHash(queued[i].stamp, algorithmId);
+            if (hashes[i].isEmpty()) {
+                files.append(queued[i].path);
+                stamps.append(queued[i].stamp);
+                slots.append(i);
+            }
+        }
+        const QVector<QByteArray> computed = hashFilesBatched(files, stamps);
+        for (int i = 0; i < computed.size(); ++i) {
+            const DigestIndex::Item& item = queued[slots[i]];
+            hashes[slots[i]] = computed[i];
+            if (!computed[i].isEmpty()) {
+                bytesRead += item.stamp.size;
+            }
+        }
+        for (int i = 0; i < queued.size(); ++i) {
+            if (!hashes[i].isEmpty()
+                && !byFull.insert(queued[i].stamp.size, hashes[i], queued[i].path, queued[i].stamp)) {
+                return false;
+            }
+        }
+        queued.clear();
+        return checkpoint();
+    };
+    ContentComparator comparator([this]() { return checkpoint(); });
+    ok = ok && byPartial.forEachGroup([&](qint64 size, const QByteArray&, const QVector<DigestIndex::Item>& items) {
+        partialCandidates += items.size();
+        if (size <= 2 * PartialHashBlock) {
+            // The partial hash already covered the whole file
+            addGroup(pathsOf(items));
+            return true;
+        }
+        fullCandidates += items.size();
+        if (confirmation == ConfirmationMode::ConfirmByContent) {
+            QList<QStringList> confirmed;
+            {
+                ScanStats::Scope comparing(stats, ScanStats::Compare);
+                confirmed = comparator.partition(pathsOf(items));
+            }
+            for (const QStringList& group : std::as_const(confirmed)) {
+                addGroup(group);
+            }
+            return checkpoint();
+        }
+        queued += items;
+        return queued.size() < IndexHashBatch || hashFull();
+    }) && hashFull();
+    finishIndex(byPartial);
+    bytesRead += comparator.bytesRead();
+    const QStringList unreadable = comparator.unreadableFiles();
+
+    ok = ok && byFull.forEachGroup([&](qint64, const QByteArray&, const QVector<DigestIndex::Item>& items) {
+        addGroup(pathsOf(items));
+        return checkpoint();
+    });
+    finishIndex(byFull);
+    publish();
+
+    recordCacheCounters();
+    cache.setReadOnly(cacheWasReadOnly);
+    cache.save();
+    if (job && job->isCancelled()) {
+        emit operationCompleted(false, "Scan cancelled");
+        return QList<QStringList>();
+    }
+    if (!ok) {
+        emit operationCompleted(false, "Duplicate index failed: " + error);
+        return QList<QStringList>();
+    }
+
+    emit operationCompleted(true,
+        QString("Found %1 sets of duplicate files\n"
+                "Scanned %2 files: %3 skipped by size, %4 ruled out by partial hash, "
+                "%5 fully compared\n"
+                "Read %6 of %7 bytes\n"
+                "Hash cache: %8 hits, %9 misses\n"
+                "Index spilled %10 runs to disk")
+            .arg(groups.size())
+            .arg(scanned)
+            .arg(scanned - sizeCandidates)
+            .arg(sizeCandidates - partialCandidates)
+            .arg(fullCandidates)
+            .arg(bytesRead)
+            .arg(totalBytes)
+            .arg(cache.hits())
+            .arg(cache.misses())
+            .arg(spilledRuns)
+            + unreadableNote(unreadable));
+    return groups;
+}
+
+bool FileManager::exportSnapshot(const QStringList& directories, const QString& snapshotPath) {
+    cache.resetCounters();
+
+    // Unlike a duplicate scan every file is hashed, a file unique here may
+    // well have a copy on another host
+    QVector<ScanCandidate> files;
+    int scanned = 0;
+    qint64 totalBytes = 0;
+    DirectoryWalker::Flags walkFlags = DirectoryWalker::StatFiles;
+    if (recursive) {
+        walkFlags |= DirectoryWalker::Recursive;
+    }
+    const qint64 walkStart = stats->now();
+    auto visit = [&](const DirectoryWalker::Entry& entry) {
+        if (!checkpoint()) {
+            return false;
+        }
+        stats->add(ScanStats::FilesListed);
+        if (++scanned % 1000 == 0) {
+            emit progressUpdated(scanned, 0);
+        }
+        if (entry.size > 0) {
+            ScanCandidate candidate;
+            candidate.path = entry.path;
+            candidate.size = entry.size;
+            candidate.stamp = stampFor(entry);
+            files.append(candidate);
+            totalBytes += entry.size;
+        }
+        return true;
+    };
+    DirectoryWalker walker(scanRoots(directories), walkFlags);
+    walker.walk(visit);
+    stats->record(ScanStats::Walk, walkStart, stats->now() - walkStart);
+
+    qint64 bytesRead = 0;
+    hashCandidates(files, bytesRead);
+    recordCacheCounters();
+    cache.save();
+    if (job && job->isCancelled()) {
+        emit operationCompleted(false, "Export cancelled");
+        return false;
+    }
+
+    QHash<QPair<qint64, QByteArray>, QStringList> byDigest;
+    for (const ScanCandidate& file : std::as_const(files)) {
+        if (!file.hash.isEmpty()) {
+            byDigest[qMakePair(file.size, file.hash)].append(file.path);
+        }
+    }
+    QList<QStringList> groups;
+    for (const QStringList& paths : std::as_const(byDigest)) {
+        if (paths.size() > 1) {
+            groups.append(paths);
+        }
+    }
+    for (int i = 0; i < groups.size(); i += GroupReportBatch) {
+        emit duplicateGroupsFound(groups.mid(i, GroupReportBatch));
+    }
+    stats->add(ScanStats::GroupsFound, groups.size());
+
+    QString error;
+    if (!writeSnapshot(snapshotPath, files, groups, error)) {
+        emit operationCompleted(false, "Cannot save snapshot: " + error);
+        return false;
+    }
+    emit operationCompleted(true,
+        QString("Saved %1 files in %2 sets of duplicates to %3\n"
+                "Read %4 of %5 bytes\n"
+                "Hash cache: %6 hits, %7 misses")
+            .arg(files.size())
+            .arg(groups.size())
+            .arg(snapshotPath)
+            .arg(bytesRead)
+            .arg(totalBytes)
+            .arg(cache.hits())
+            .arg(cache.misses()));
+    return true;
+}
+
+bool FileManager::mergeSnapshots(const QStringList& snapshotPaths, const QString& outputPath) {
+    std::vector<std::unique_ptr<ScanSnapshot>> snapshots;
+    for (const QString& path : snapshotPaths) {
+        auto snapshot = std::make_unique<ScanSnapshot>();
+        if (!snapshot->load(path)) {
+            emit operationCompleted(false, "Cannot load " + path + ": " + snapshot->errorString());
+            return false;
+        }
+        if (!snapshots.empty() && (snapshot->algorithm() != snapshots.front()->algorithm()
+                                   || snapshot->digestLength() != snapshots.front()->digestLength())) {
+            emit operationCompleted(false, path + " was hashed with a different algorithm");
+            return false;
+        }
+        snapshots.push_back(std::move(snapshot));
+    }
+    if (snapshots.empty()) {
+        emit operationCompleted(false, "No snapshots to merge");
+        return false;
+    }
+    // A host scanned more than once contributes its newest snapshot only;
+    // files an older scan still lists may have been deleted since
+    std::stable_sort(snapshots.begin(), snapshots.end(), [](const auto& a, const auto& b) {
+        return a->created() > b->created();
+    });
+    QHash<QString, const ScanSnapshot *> newest;
+    for (const auto& snapshot : snapshots) {
+        for (const QString& hostName : snapshot->hosts()) {
+            if (!newest.contains(hostName)) {
+                newest.insert(hostName, snapshot.get());
+            }
+        }
+    }
+
+    ScanSnapshot::Writer writer(snapshots.front()->algorithm(), snapshots.front()->digestLength());
+    QHash<QPair<qint64, QByteArray>, QVector<qint64>> byDigest;
+    QList<QVector<qint64>> undigested;
+    QStringList paths;
+    QStringList pathHosts;
+    QSet<QString> hosts;
+    for (const auto& snapshot : snapshots) {
+        QVector<qint64> mapped(int(snapshot->fileCount()), -1);
+        for (qint64 file = 0; file < snapshot->fileCount(); ++file) {
+            const QString hostName = snapshot->hostName(snapshot->host(file));
+            if (newest.value(hostName) != snapshot.get()) {
+                continue;
+            }
+            const int host = writer.addHost(hostName);
+            const QString path = snapshot->path(file);
+            hosts.insert(hostName);
+            const QByteArray digest = snapshot->digest(file);
+            mapped[int(file)] = writer.addFile(path, snapshot->size(file), snapshot->mtimeNs(file), digest, host);
+            paths.append(path);
+            pathHosts.append(hostName);
+            if (!digest.isEmpty()) {
+                byDigest[qMakePair(snapshot->size(file), digest)].append(mapped[int(file)]);
+            }
+        }
+        // Groups settled without a digest can only be carried over as they were
+        for (qint64 group = 0; group < snapshot->groupCount(); ++group) {
+            QVector<qint64> members;
+            bool digested = true;
+            for (qint64 file : snapshot->groupFiles(group)) {
+                digested = digested && !snapshot->digest(file).isEmpty();
+                if (mapped[int(file)] >= 0) {
+                    members.append(mapped[int(file)]);
+                }
+            }
+            if (!digested && members.size() > 1) {
+                undigested.append(members);
+            }
+        }
+    }
+
+    QList<QVector<qint64>> merged = undigested;
+    for (const QVector<qint64>& files : std::as_const(byDigest)) {
+        if (files.size() > 1) {
+            merged.append(files);
+        }
+    }
+    QList<QStringList> groups;
+    for (const QVector<qint64>& files : std::as_const(merged)) {
+        writer.addGroup(files);
+        QStringList group;
+        for (qint64 file : files) {
+            group.append(hosts.size() > 1 ? pathHosts[int(file)] + ':' + paths[int(file)] : paths[int(file)]);
+        }
+        groups.append(group);
+    }
+    for (int i = 0; i < groups.size(); i += GroupReportBatch) {
+        emit duplicateGroupsFound(groups.mid(i, GroupReportBatch));
+    }
+
+    if (!writer.save(outputPath)) {
+        emit operationCompleted(false, "Cannot save snapshot: " + writer.errorString());
+        return false;
+    }
+    emit operationCompleted(true,
+        QString("Merged %1 snapshots of %2 hosts: %3 files in %4 sets of duplicates")
+            .arg(snapshots.size())
+            .arg(hosts.size())
+            .arg(writer.fileCount())
+            .arg(groups.size()));
+    return true;
+}
+
+bool FileManager::writeSnapshot(const QString& path, const QVector<ScanCandidate>& files,
+                                const QList<QStringList>& groups, QString& error) {
+    ScanSnapshot::Writer writer(int(algorithm), algorithm == HashAlgorithm::Sha256 ? 32 : 16);
+    const int host = writer.addHost(QSysInfo::machineHostName());
+    QHash<QString, qint64> indexes;
+    for (const ScanCandidate& file : files) {
+        indexes.insert(file.path, writer.addFile(file.path, file.size, file.stamp.mtimeNs, file.hash, host));
+    }
+    for (const QStringList& group : groups) {
+        QVector<qint64> members;
+        for (const QString& member : group) {
+            auto it = indexes.constFind(member);
+            // Empty files never become candidates
+            if (it == indexes.constEnd()) {
+                it = indexes.insert(member, writer.addFile(member, 0, 0, QByteArray(), host));
+            }
+            members.append(it.value());
+        }
+        writer.addGroup(members);
+    }
+    if (!writer.save(path)) {
+        error = writer.errorString();
+        return false;
+    }
+    return true;
+}
+
+QList<QStringList> FileManager::findSimilarGroups(const QString& directory) {
+    QList<QStringList> groups;
+    cache.resetCounters();
+    const int algorithmId = int(algorithm);
+
+    // Files of a single chunk can only match exactly, the regular scan covers them
+    QVector<ScanCandidate> candidates;
+    QStringList files;
+    QVector<qint64> sizes;
+    int scanned = 0;
+
+    DirectoryWalker::Flags walkFlags = DirectoryWalker::StatFiles;
+    if (recursive) {
+        walkFlags |= DirectoryWalker::Recursive;
+    }
+    DirectoryWalker walker(directory, walkFlags);
+    const qint64 walkStart = stats->now();
+    walker.walk([&](const DirectoryWalker::Entry& entry) {
+        if (!checkpoint()) {
+            return false;
+        }
+        stats->add(ScanStats::FilesListed);
+        if (++scanned % 1000 == 0) {
+            emit progressUpdated(scanned, 0);
+        }
+        if (entry.size < 2 * ContentChunker::MinChunk) {
+            return true;
+        }
+
+        ScanCandidate candidate;
+        candidate.path = entry.path;
+        candidate.size = entry.size;
+        candidate.stamp = stampFor(entry);
+        candidates.append(candidate);
+        files.append(entry.path);
+        sizes.append(entry.size);
+        return true;
+    });
+    stats->record(ScanStats::Walk, walkStart, stats->now() - walkStart);
+
+    // One read per file feeds the exact digest and the chunk signature
+    const QVector<QByteArray> results = hashEngine->hashFiles(files, sizes,
+        [this](const QString& filePath, qint64) {
+            return calculateSimilarityDigest(filePath);
+        });
+
+    constexpr int SignatureBytes = SimilarityIndex::SignatureLength * int(sizeof(quint64));
+    SimilarityIndex index(similarity);
+    QVector<int> indexed;
+    qint64 bytesRead = 0;
+    for (int i = 0; i < results.size(); ++i) {
+        if (results[i].size() <= SignatureBytes) {
+            continue;
+        }
+        ScanCandidate& candidate = candidates[i];
+        candidate.hash = results[i].left(results[i].size() - SignatureBytes);
+        cache.insertFullHash(candidate.stamp, algorithmId, candidate.hash);
+        bytesRead += candidate.size;
+
+        SimilarityIndex::Signature signature;
+        std::memcpy(signature.data(), results[i].constData() + candidate.hash.size(), SignatureBytes);
+        index.add(signature);
+        indexed.append(i);
+    }
+
+    recordCacheCounters();
+    cache.save();
+    if (job && job->isCancelled()) {
+        emit operationCompleted(false, "Scan cancelled");
+        return groups;
+    }
+
+    // Pairs are joined into clusters, so a chain of revisions forms one group
+    const QVector<SimilarityIndex::Match> matches = index.matches();
+    QVector<int> parent(indexed.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto root = [&parent](int node) {
+        while (parent[node] != node) {
+            parent[node] = parent[parent[node]];
+            node = parent[node];
+        }
+        return node;
+    };
+    int identical = 0;
+    for (const SimilarityIndex::Match& match : matches) {
+        parent[root(match.second)] = root(match.first);
+        if (candidates[indexed[match.first]].hash == candidates[indexed[match.second]].hash) {
+            ++identical;
+        }
+    }
+
+    QMap<int, QStringList> clusters;
+    for (int i = 0; i < indexed.size(); ++i) {
+        clusters[root(i)].append(candidates[indexed[i]].path);
+    }
+    for (const QStringList& cluster : std::as_const(clusters)) {
+        if (cluster.size() > 1) {
+            groups.append(cluster);
+            if (groups.size() % GroupReportBatch == 0) {
+                emit duplicateGroupsFound(groups.mid(groups.size() - GroupReportBatch));
+            }
+        }
+    }
+    if (groups.size() % GroupReportBatch != 0) {
+        emit duplicateGroupsFound(groups.mid(groups.size() - groups.size() % GroupReportBatch));
+    }
+
+    emit operationCompleted(true,
+        QString("Found %1 sets of similar files\n"
+                "Scanned %2 files, compared %3: %4 pairs at least %5% similar, %6 of them identical\n"
+                "Read %7 bytes")
+            .arg(groups.size())
+            .arg(scanned)
+            .arg(indexed.size())
+            .arg(matches.size())
+            .arg(qRound(similarity * 100))
+            .arg(identical)
+            .arg(bytesRead));
+    return groups;
+}
+
+QVector<QByteArray> FileManager::hashFilesBatched(const QStringList& files,
+                                                  const QVector<HashCache::FileStamp>& stamps) {
+    QVector<QByteArray> results(files.size());
+    if (files.isEmpty()) {
+        return results;
+    }
+    QByteArray *resultSlots = results.data();
+    // Digests are built on a file's first chunk and freed once it is done,
+    // so only the files in flight hold one
+    std::vector<std::unique_ptr<Digest>> digests(size_t(files.size()));
+
+    QMap<quint64, QVector<int>> deviceFiles;
     for (int i = 0; i < files.size(); ++i) {
-        QString filePath = dir.absoluteFilePath(files[i]);
-        QByteArray hash = calculateFileHash(filePath);
-        
-        if (!hash.isEmpty()) {
-            hashMap[hash].append(filePath);
+        deviceFiles[stamps[i].device].append(i);
+    }
+
+    // Each file's chunks arrive in order on one reader thread, so its
+    // digest and result slot need no locking
+    std::atomic<int> finished{0};
+    auto readDevice = [&](const QVector<int>& indices, StorageDevice::Budget budget,
+                          const BatchReader::Progress& progress) {
+        QStringList batchFiles;
+        for (int index : indices) {
+            batchFiles.append(files[index]);
+        }
+        BatchReader batch(reader, [this]() { return checkpoint(); });
+        batch.setThreadCount(budget.threads);
+        batch.setQueueDepth(budget.queueDepth);
+        batch.setChunkSize(ReadChunkSize);
+        batch.setStats(stats);
+        batch.read(batchFiles,
+            [this, &digests, &indices](int index, const char *data, qint64 length) {
+                ScanStats::Scope hashing(stats, ScanStats::Hash);
+                std::unique_ptr<Digest>& digest = digests[size_t(indices[index])];
+                if (!digest) {
+                    digest = std::make_unique<Digest>(algorithm);
+                }
+                digest->addData(data, length);
+            },
+            [this, &digests, &indices, &finished, resultSlots](int index, bool ok) {
+                const int slot = indices[index];
+                if (ok) {
+                    // An empty file never delivered a chunk
+                    const std::unique_ptr<Digest>& digest = digests[size_t(slot)];
+                    resultSlots[slot] = digest ? digest->result() : Digest(algorithm).result();
+                    stats->add(ScanStats::FilesHashed);
+                }
+                digests[size_t(slot)].reset();
+                finished.fetch_add(1, std::memory_order_relaxed);
+            },
+            progress);
+    };
+
+    // Devices are read side by side so a slow disk or share does not hold
+    // up the others; a rotational disk is read in inode order, which
+    // roughly follows the on-disk layout
+    QVector<StorageDevice::Budget> budgets;
+    for (auto it = deviceFiles.begin(); it != deviceFiles.end(); ++it) {
+        const StorageDevice::Kind kind = deviceKind(it.key(), files[it->first()]);
+        if (kind == StorageDevice::Kind::Rotational) {
+            std::sort(it->begin(), it->end(), [&stamps](int a, int b) {
+                return stamps[a].inode < stamps[b].inode;
+            });
+        }
+        budgets.append(StorageDevice::budget(kind, hashThreadCount()));
+    }
+
+    if (deviceFiles.size() == 1) {
+        readDevice(deviceFiles.first(), budgets.first(), [this](int done, int total) {
+            emit progressUpdated(done, total);
+        });
+        return results;
+    }
+
+    QThreadPool devicePool;
+    devicePool.setMaxThreadCount(qMax(1, int(deviceFiles.size())));
+    int device = 0;
+    for (const QVector<int>& indices : std::as_const(deviceFiles)) {
+        const StorageDevice::Budget budget = budgets[device++];
+        devicePool.start([&readDevice, &indices, budget]() {
+            readDevice(indices, budget, BatchReader::Progress());
+        });
+    }
+    while (!devicePool.waitForDone(BatchReader::ProgressInterval)) {
+        emit progressUpdated(finished.load(std::memory_order_relaxed), files.size());
+    }
+    emit progressUpdated(finished.load(std::memory_order_relaxed), files.size());
+    return results;
+}
+
+StorageDevice::Kind FileManager::deviceKind(quint64 device, const QString& path) {
+    auto it = deviceKinds.find(device);
+    if (it == deviceKinds.end()) {
+        it = deviceKinds.insert(device, StorageDevice::detect(path));
+    }
+    return it.value();
+}
+
+void FileManager::hashCandidates(QVector<ScanCandidate>& candidates, qint64& bytesRead) {
+    const int algorithmId = int(algorithm);
+    QStringList uncachedFiles;
+    QVector<HashCache::FileStamp> uncachedStamps;
+    QVector<int> uncachedSlots;
+
+    for (int i = 0; i < candidates.size(); ++i) {
+        candidates[i].hash = cache.fullHash(candidates[i].stamp, algorithmId);
+        if (candidates[i].hash.isEmpty()) {
+            uncachedFiles.append(candidates[i].path);
+            uncachedStamps.append(candidates[i].stamp);
+            uncachedSlots.append(i);
         }
-        
-        emit progressUpdated(i + 1, total);
     }
-    
-    for (const QStringList& fileList : hashMap) {
-        if (fileList.size() > 1) {
-            duplicates.append(fileList);
+
+    const QVector<QByteArray> computed = hashFilesBatched(uncachedFiles, uncachedStamps);
+
+    for (int i = 0; i < computed.size(); ++i) {
+        ScanCandidate& candidate = candidates[uncachedSlots[i]];
+        candidate.hash = computed[i];
+        if (!candidate.hash.isEmpty()) {
+            bytesRead += candidate.size;
+            cache.insertFullHash(candidate.stamp, algorithmId, candidate.hash);
         }
     }
-    
-    emit operationCompleted(true, 
-        QString("Found %1 sets of duplicate files").arg(duplicates.size() / 2));
-    return duplicates;
+}
+
+bool FileManager::buildIndex(DuplicateIndex& index, const QString& directory) {
+    DirectoryWalker::Flags walkFlags = DirectoryWalker::StatFiles;
+    if (recursive) {
+        walkFlags |= DirectoryWalker::Recursive;
+    }
+    DirectoryWalker walker(directory, walkFlags);
+    const qint64 walkStart = stats->now();
+    const bool walked = walker.walk([&](const DirectoryWalker::Entry& entry) {
+        if (!checkpoint()) {
+            return false;
+        }
+        stats->add(ScanStats::FilesListed);
+        if (index.size() % 1000 == 999) {
+            emit progressUpdated(index.size() + 1, 0);
+        }
+        DuplicateIndex::Entry indexed;
+        indexed.size = entry.size;
+        indexed.stamp = stampFor(entry);
+        index.insert(entry.path, indexed);
+        return true;
+    });
+    stats->record(ScanStats::Walk, walkStart, stats->now() - walkStart);
+    if (!walked) {
+        return false;
+    }
+
+    resolveIndexHashes(index, index.collidingSizes());
+    return checkpoint();
+}
+
+void FileManager::resolveIndexHashes(DuplicateIndex& index, const QList<qint64>& sizes) {
+    const int algorithmId = int(algorithm);
+
+    // Partial hashes first; full hashes only where those still collide
+    for (const bool full : {false, true}) {
+        QStringList files;
+        QVector<qint64> fileSizes;
+        QVector<HashCache::FileStamp> stamps;
+        for (qint64 size : sizes) {
+            const QStringList missing = full ? index.missingFullHashes(size)
+                                             : index.missingPartialHashes(size);
+            for (const QString& path : missing) {
+                const HashCache::FileStamp stamp = index.entry(path).stamp;
+                const QByteArray cached = full ? cache.fullHash(stamp, algorithmId)
+                                               : cache.partialHash(stamp, algorithmId);
+                if (cached.isEmpty()) {
+                    files.append(path);
+                    fileSizes.append(size);
+                    stamps.append(stamp);
+                } else if (full) {
+                    index.setFullHash(path, cached);
+                } else {
+                    index.setPartialHash(path, cached);
+                }
+            }
+        }
+
+        QVector<QByteArray> hashes;
+        if (full) {
+            hashes = hashFilesBatched(files, stamps);
+        } else {
+            hashes = hashEngine->hashFiles(files, fileSizes, [this](const QString& filePath, qint64 size) {
+                return calculatePartialHash(filePath, size);
+            });
+        }
+        for (int i = 0; i < hashes.size(); ++i) {
+            if (hashes[i].isEmpty()) {
+                continue;
+            }
+            if (full) {
+                index.setFullHash(files[i], hashes[i]);
+                cache.insertFullHash(stamps[i], algorithmId, hashes[i]);
+            } else {
+                index.setPartialHash(files[i], hashes[i]);
+                cache.insertPartialHash(stamps[i], algorithmId, hashes[i]);
+            }
+        }
+    }
+}
+
+HashCache::FileStamp FileManager::stampFor(const DirectoryWalker::Entry& entry) {
+    HashCache::FileStamp stamp;
+    // Without an inode (non-POSIX walk) there is no stable cache key
+    if (entry.inode != 0) {
+        stamp.device = entry.device;
+        stamp.inode = entry.inode;
+        stamp.size = entry.size;
+        stamp.mtimeNs = entry.mtimeNs;
+    }
+    return stamp;
+}
+
+QString FileManager::unreadableNote(const QStringList& files) {
+    if (files.isEmpty()) {
+        return QString();
+    }
+    QString note = QString("\nCould not read %1 files, left out: %2").arg(files.size()).arg(files.mid(0, 5).join(", "));
+    if (files.size() > 5) {
+        note += ", ...";
+    }
+    return note;
+}
+
+QStringList FileManager::scanRoots(const QStringList& directories) {
+    // Compared by canonical path, so a root reached through a symlink is
+    // still seen inside the other; sorted, a root comes before everything
+    // inside it. The roots keep the spelling they were given.
+    QMap<QString, QString> roots;
+    for (const QString& directory : directories) {
+        const QFileInfo info(directory);
+        const QString absolute = QDir::cleanPath(info.absoluteFilePath());
+        const QString canonical = info.canonicalFilePath();
+        const QString key = canonical.isEmpty() ? absolute : canonical;
+        if (!roots.contains(key)) {
+            roots.insert(key, absolute);
+        }
+    }
+    QStringList outer;
+    QStringList outerKeys;
+    for (auto it = roots.cbegin(); it != roots.cend(); ++it) {
+        const QString& key = it.key();
+        const bool nested = std::any_of(outerKeys.cbegin(), outerKeys.cend(), [&key](const QString& parent) {
+            return key.startsWith(parent.endsWith('/') ? parent : parent + '/');
+        });
+        if (!nested) {
+            outerKeys.append(key);
+            outer.append(it.value());
+        }
+    }
+    return outer;
 }
 
 QStringList FileManager::findDuplicatesByMetadata(const QString& directory) {
     QStringList duplicates;
-    QDir dir(directory);
-    QStringList files = dir.entryList(QDir::Files);
-    
+    const QList<QStringList> groups = findMetadataGroups(directory);
+    for (const QStringList& group : groups) {
+        duplicates.append(group);
+    }
     return duplicates;
 }
 
-bool FileManager::removeDuplicates(const QStringList& files) {
-    if (files.isEmpty()) {
+QList<QStringList> FileManager::findMetadataGroups(const QString& directory) {
+    QList<QStringList> groups;
+    MetadataIndex index;
+
+    DirectoryWalker::Flags walkFlags = DirectoryWalker::StatFiles;
+    if (recursive) {
+        walkFlags |= DirectoryWalker::Recursive;
+    }
+    DirectoryWalker walker(directory, walkFlags);
+    const qint64 walkStart = stats->now();
+    walker.walk([&](const DirectoryWalker::Entry& entry) {
+        if (!checkpoint()) {
+            return false;
+        }
+        stats->add(ScanStats::FilesListed);
+        index.append(entry.path, entry.size, entry.mtimeNs);
+        if (index.size() % 1000 == 0) {
+            emit progressUpdated(index.size(), 0);
+        }
+        return true;
+    });
+    stats->record(ScanStats::Walk, walkStart, stats->now() - walkStart);
+
+    if (job && job->isCancelled()) {
+        emit operationCompleted(false, "Scan cancelled");
+        return groups;
+    }
+
+    const QList<QVector<int>> rows = index.findGroups(matchKeys);
+    for (const QVector<int>& groupRows : rows) {
+        QStringList group;
+        for (int row : groupRows) {
+            group.append(index.path(row));
+        }
+        groups.append(group);
+    }
+    for (int i = 0; i < groups.size(); i += GroupReportBatch) {
+        emit duplicateGroupsFound(groups.mid(i, GroupReportBatch));
+    }
+
+    emit operationCompleted(true,
+        QString("Found %1 sets of files with matching metadata\n"
+                "Indexed %2 files in %3 bytes")
+            .arg(groups.size())
+            .arg(index.size())
+            .arg(index.memoryUsage()));
+    return groups;
+}
+
+void FileManager::setHashThreadCount(int count) {
+    hashEngine->setMaxThreadCount(count);
+}
+
+int FileManager::hashThreadCount() const {
+    return hashEngine->maxThreadCount();
+}
+
+void FileManager::setReadBackend(BatchReader::Backend backend) {
+    reader = backend;
+}
+
+BatchReader::Backend FileManager::readBackend() const {
+    return reader;
+}
+
+void FileManager::setHashAlgorithm(HashAlgorithm hashAlgorithm) {
+    algorithm = hashAlgorithm;
+}
+
+FileManager::HashAlgorithm FileManager::hashAlgorithm() const {
+    return algorithm;
+}
+
+void FileManager::setConfirmationMode(ConfirmationMode mode) {
+    confirmation = mode;
+}
+
+FileManager::ConfirmationMode FileManager::confirmationMode() const {
+    return confirmation;
+}
+
+void FileManager::setMetadataKeys(MetadataIndex::Keys keys) {
+    matchKeys = keys;
+}
+
+MetadataIndex::Keys FileManager::metadataKeys() const {
+    return matchKeys;
+}
+
+void FileManager::setSimilarityThreshold(double threshold) {
+    similarity = qBound(0.0, threshold, 1.0);
+}
+
+double FileManager::similarityThreshold() const {
+    return similarity;
+}
+
+void FileManager::setRemovalMode(DuplicateRemover::Mode mode) {
+    removal = mode;
+}
+
+DuplicateRemover::Mode FileManager::removalMode() const {
+    return removal;
+}
+
+void FileManager::setRecursiveScan(bool enabled) {
+    recursive = enabled;
+}
+
+bool FileManager::recursiveScan() const {
+    return recursive;
+}
+
+void FileManager::setIndexMemoryLimit(qint64 bytes) {
+    indexLimit = qMax<qint64>(0, bytes);
+}
+
+qint64 FileManager::indexMemoryLimit() const {
+    return indexLimit;
+}
+
+void FileManager::setSnapshotPath(const QString& path) {
+    snapshotFile = path;
+}
+
+QString FileManager::snapshotPath() const {
+    return snapshotFile;
+}
+
+HashCache& FileManager::hashCache() {
+    return cache;
+}
+
+ScanStats& FileManager::scanStats() {
+    return *stats;
+}
+
+bool FileManager::removeDuplicates(const QList<DuplicateRemover::Group>& groups) {
+    DuplicateRemover remover(removal, [this]() { return checkpoint(); });
+    remover.setThreadCount(hashThreadCount());
+    remover.setHashCache(&cache, int(algorithm));
+    const qint64 removeStart = stats->now();
+    remover.run(groups, [this](int done, int total) { emit progressUpdated(done, total); });
+    stats->record(ScanStats::Remove, removeStart, stats->now() - removeStart);
+
+    const int total = remover.duplicateCount();
+    const int processed = remover.processedCount();
+    if (total == 0) {
         emit operationCompleted(false, "No files selected");
         return false;
     }
-    
-    int total = files.size();
-    int removed = 0;
-    QStringList errors;
-    
-    for (int i = 0; i < files.size(); ++i) {
-        QFile file(files[i]);
-        if (file.remove()) {
-            removed++;
-        } else {
-            errors << QString("Failed to remove: %1").arg(files[i]);
-        }
-        
-        emit progressUpdated(i + 1, total);
+
+    QString message;
+    switch (removal) {
+    case DuplicateRemover::Mode::Delete:
+        message = QString("Removed %1 of %2 duplicate files");
+        break;
+    case DuplicateRemover::Mode::Hardlink:
+        message = QString("Replaced %1 of %2 duplicate files with hard links");
+        break;
+    case DuplicateRemover::Mode::Reflink:
+        message = QString("Replaced %1 of %2 duplicate files with reflinks");
+        break;
     }
-    
-    QString message = QString("Removed %1 of %2 duplicate files").arg(removed).arg(total);
+    message = message.arg(processed).arg(total)
+        + QString("\nReclaimed %1 bytes").arg(remover.bytesReclaimed());
+    const QStringList errors = remover.errors();
     if (!errors.isEmpty()) {
         message += "\nErrors:\n" + errors.join("\n");
     }
-    
-    emit operationCompleted(removed == total, message);
-    return removed == total;
+
+    emit operationCompleted(processed == total, message);
+    return processed == total;
+}
+
+FileAnalyzer::Report FileManager::analyzeContent(const QString& directory) {
+    FileAnalyzer analyzer([this]() { return checkpoint(); });
+    analyzer.setThreadCount(hashThreadCount());
+    analyzer.setRecursive(recursive);
+    const FileAnalyzer::Report report = analyzer.analyze(directory,
+        [this](int done, int total) { emit progressUpdated(done, total); });
+
+    if (job && job->isCancelled()) {
+        emit operationCompleted(false, "Analysis cancelled");
+        return report;
+    }
+    emit operationCompleted(true, FileAnalyzer::summary(report));
+    return report;
+}
+
+bool FileManager::watchDuplicates(const QString& directory) {
+    const QString root = QDir::cleanPath(QFileInfo(directory).absoluteFilePath());
+    DuplicateIndex index(2 * PartialHashBlock);
+    TreeWatcher watcher;
+
+    // Subscribe before the first walk so nothing written during it is lost
+    if (!watcher.watch(root, recursive)) {
+        emit operationCompleted(false, "Cannot watch " + root);
+        return false;
+    }
+    if (!buildIndex(index, root)) {
+        emit operationCompleted(false, "Watch cancelled");
+        return false;
+    }
+
+    const QList<QStringList> initialGroups = index.groups();
+    for (int i = 0; i < initialGroups.size(); i += GroupReportBatch) {
+        emit duplicateGroupsFound(initialGroups.mid(i, GroupReportBatch));
+    }
+
+    TreeWatcher::Changes changes;
+    while (watcher.waitForChanges(changes, [this]() { return checkpoint(); })) {
+        if (changes.rootLost) {
+            // Nothing below the old path is watched any more
+            QStringList stale;
+            for (const QStringList& group : index.groups()) {
+                stale.append(group);
+            }
+            emit duplicateGroupsChanged(stale, QList<QStringList>());
+            recordCacheCounters();
+            cache.save();
+            emit operationCompleted(false, QString("%1 was removed or moved, stopped watching").arg(root));
+            return false;
+        }
+        if (changes.overflow) {
+            // Events were dropped, only a full rescan is trustworthy
+            QStringList stale;
+            for (const QStringList& group : index.groups()) {
+                stale.append(group);
+            }
+            index.clear();
+            if (!buildIndex(index, root)) {
+                break;
+            }
+            emit duplicateGroupsChanged(stale, index.groups());
+            continue;
+        }
+
+        // Old and new group mates of every touched file need regrouping
+        QSet<QString> affected;
+        QSet<qint64> touchedSizes;
+        auto forget = [&](const QString& path) {
+            if (!index.contains(path)) {
+                return;
+            }
+            const QStringList group = index.groupOf(path);
+            affected.unite(QSet<QString>(group.cbegin(), group.cend()));
+            affected.insert(path);
+            index.remove(path);
+        };
+
+        for (const QString& removedDirectory : std::as_const(changes.removedDirectories)) {
+            for (const QString& path : index.pathsUnder(removedDirectory)) {
+                forget(path);
+            }
+        }
+        for (const QString& path : std::as_const(changes.removed)) {
+            forget(path);
+        }
+        for (const QString& path : std::as_const(changes.changed)) {
+            forget(path);
+            // Like the walk, only regular files and never symlinks are indexed
+            const HashCache::FileStamp stamp = HashCache::stampFor(path, false);
+            if (!stamp.isValid()) {
+                continue;
+            }
+            DuplicateIndex::Entry entry;
+            entry.size = stamp.size;
+            entry.stamp = stamp;
+            index.insert(path, entry);
+            affected.insert(path);
+            touchedSizes.insert(stamp.size);
+        }
+        if (affected.isEmpty()) {
+            continue;
+        }
+
+        resolveIndexHashes(index, QList<qint64>(touchedSizes.cbegin(), touchedSizes.cend()));
+
+        QList<QStringList> groups;
+        QSet<QString> grouped;
+        for (const QString& path : std::as_const(affected)) {
+            if (grouped.contains(path)) {
+                continue;
+            }
+            const QStringList group = index.groupOf(path);
+            if (!group.isEmpty()) {
+                grouped.unite(QSet<QString>(group.cbegin(), group.cend()));
+                groups.append(group);
+            }
+        }
+        // Files that joined a group may still be listed in their previous one
+        affected.unite(grouped);
+        emit duplicateGroupsChanged(QStringList(affected.cbegin(), affected.cend()), groups);
+        cache.save();
+    }
+
+    recordCacheCounters();
+    cache.save();
+    emit operationCompleted(true, QString("Stopped watching %1").arg(root));
+    return true;
+}
+
+ScanJob *FileManager::findDuplicatesAsync(const QString& directory) {
+    return findDuplicatesAsync(QStringList{directory});
+}
+
+ScanJob *FileManager::findDuplicatesAsync(const QStringList& directories) {
+    return startJob([directories](FileManager& worker, ScanJob *) {
+        worker.findDuplicateGroups(directories);
+    });
+}
+
+ScanJob *FileManager::batchRenameAsync(const QStringList& files, const QString& pattern, const QString& match) {
+    return startJob([files, pattern, match](FileManager& worker, ScanJob *) {
+        worker.batchRename(files, pattern, match);
+    });
+}
+
+ScanJob *FileManager::removeDuplicatesAsync(const QList<DuplicateRemover::Group>& groups) {
+    return startJob([groups](FileManager& worker, ScanJob *) {
+        worker.removeDuplicates(groups);
+    });
+}
+
+ScanJob *FileManager::findSimilarAsync(const QString& directory) {
+    return startJob([directory](FileManager& worker, ScanJob *) {
+        worker.findSimilarGroups(directory);
+    });
+}
+
+ScanJob *FileManager::analyzeContentAsync(const QString& directory) {
+    return startJob([directory](FileManager& worker, ScanJob *) {
+        worker.analyzeContent(directory);
+    });
 }
 
-QString FileManager::generateNewName(const QString& pattern, const QFileInfo& file, int index) {
-    QString dir = file.absolutePath();
-    QString newName = pattern.arg(index);
-    return dir + QDir::separator() + newName + "." + file.suffix();
+ScanJob *FileManager::watchDuplicatesAsync(const QString& directory) {
+    return startJob([directory](FileManager& worker, ScanJob *) {
+        worker.watchDuplicates(directory);
+    });
+}
+
+bool FileManager::checkpoint() const {
+    return !job || job->checkpoint();
+}
+
+ScanJob *FileManager::startJob(const std::function<void(FileManager& worker, ScanJob *job)>& work) {
+    ScanJob *scanJob = new ScanJob(this);
+
+    // Settings are copied here, the worker manager is built on its own thread
+    const HashAlgorithm workerAlgorithm = algorithm;
+    const ConfirmationMode workerConfirmation = confirmation;
+    const MetadataIndex::Keys workerMetadataKeys = matchKeys;
+    const DuplicateRemover::Mode workerRemoval = removal;
+    const double workerSimilarity = similarity;
+    const int workerThreads = hashThreadCount();
+    const bool workerRecursive = recursive;
+    const qint64 workerIndexLimit = indexLimit;
+    const QString workerSnapshotFile = snapshotFile;
+    const BatchReader::Backend workerReader = reader;
+    const QString cachePath = cache.filePath();
+    const bool cacheEnabled = cache.isEnabled();
+    scanJob->stats().setTracing(stats->isTracing());
+
+    scanJob->thread = QThread::create([=]() {
+        FileManager worker;
+        worker.algorithm = workerAlgorithm;
+        worker.confirmation = workerConfirmation;
+        worker.matchKeys = workerMetadataKeys;
+        worker.removal = workerRemoval;
+        worker.similarity = workerSimilarity;
+        worker.recursive = workerRecursive;
+        worker.indexLimit = workerIndexLimit;
+        worker.snapshotFile = workerSnapshotFile;
+        worker.reader = workerReader;
+        worker.setHashThreadCount(workerThreads);
+        worker.cache.setFilePath(cachePath);
+        worker.cache.setEnabled(cacheEnabled);
+        worker.job = scanJob;
+        worker.stats = &scanJob->stats();
+
+        bool success = false;
+        QString message;
+        connect(&worker, &FileManager::progressUpdated,
+                scanJob, &ScanJob::reportProgress, Qt::DirectConnection);
+        connect(&worker, &FileManager::duplicateGroupsFound,
+                scanJob, &ScanJob::duplicatesFound, Qt::DirectConnection);
+        connect(&worker, &FileManager::duplicateGroupsChanged,
+                scanJob, &ScanJob::duplicatesChanged, Qt::DirectConnection);
+        connect(&worker, &FileManager::operationCompleted,
+                scanJob, [&success, &message](bool ok, const QString& text) {
+                    success = ok;
+                    message = text;
+                }, Qt::DirectConnection);
+
+        work(worker, scanJob);
+        scanJob->finish(success, message);
+    });
+    scanJob->thread->setParent(scanJob);
+
+    // Start from the event loop so callers can connect to the job first
+    QThread *thread = scanJob->thread;
+    QMetaObject::invokeMethod(thread, [thread]() { thread->start(); }, Qt::QueuedConnection);
+    return scanJob;
 }
 
 bool FileManager::compareFiles(const QString& file1, const QString& file2) {
-    return calculateFileHash(file1) == calculateFileHash(file2);
+    ContentComparator comparator([this]() { return checkpoint(); });
+    ScanStats::Scope comparing(stats, ScanStats::Compare);
+    return comparator.identical(file1, file2);
 }
 
 QByteArray FileManager::calculateFileHash(const QString& filePath) {
@@ -145,8 +1617,98 @@ QByteArray FileManager::calculateFileHash(const QString& filePath) {
     if (!file.open(QFile::ReadOnly)) {
         return QByteArray();
     }
-    
-    QCryptographicHash hash(QCryptographicHash::Sha256);
-    hash.addData(&file);
+
+    Digest hash(algorithm);
+    QByteArray buffer(ReadChunkSize, Qt::Uninitialized);
+    qint64 bytes;
+    while ((bytes = timedRead(file, buffer.data(), buffer.size())) > 0) {
+        ScanStats::Scope hashing(stats, ScanStats::Hash);
+        hash.addData(buffer.constData(), bytes);
+        if (!checkpoint()) {
+            return QByteArray();
+        }
+    }
+    if (bytes < 0) {
+        return QByteArray();
+    }
+    stats->add(ScanStats::FilesHashed);
     return hash.result();
 }
+
+QByteArray FileManager::calculateSimilarityDigest(const QString& filePath) {
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly)) {
+        return QByteArray();
+    }
+
+    Digest hash(algorithm);
+    ContentChunker chunker;
+    QByteArray buffer(ReadChunkSize, Qt::Uninitialized);
+    qint64 bytes;
+    while ((bytes = timedRead(file, buffer.data(), buffer.size())) > 0) {
+        ScanStats::Scope hashing(stats, ScanStats::Hash);
+        hash.addData(buffer.constData(), bytes);
+        chunker.addData(buffer.constData(), bytes);
+        if (!checkpoint()) {
+            return QByteArray();
+        }
+    }
+    if (bytes < 0) {
+        return QByteArray();
+    }
+    stats->add(ScanStats::FilesHashed);
+
+    const SimilarityIndex::Signature signature = chunker.signature();
+    return hash.result()
+        + QByteArray(reinterpret_cast<const char *>(signature.data()), int(sizeof(signature)));
+}
+
+QByteArray FileManager::calculatePartialHash(const QString& filePath, qint64 size) {
+    if (!checkpoint()) {
+        return QByteArray();
+    }
+
+    QFile file(filePath);
+    if (!file.open(QFile::ReadOnly)) {
+        return QByteArray();
+    }
+
+    Digest hash(algorithm);
+    if (size <= 2 * PartialHashBlock) {
+        QByteArray data(size, Qt::Uninitialized);
+        const qint64 bytes = timedRead(file, data.data(), size);
+        if (bytes < 0) {
+            return QByteArray();
+        }
+        hash.addData(data.constData(), bytes);
+    } else {
+        QByteArray head(PartialHashBlock, Qt::Uninitialized);
+        QByteArray tail(PartialHashBlock, Qt::Uninitialized);
+        const qint64 headBytes = timedRead(file, head.data(), PartialHashBlock);
+        if (headBytes < 0 || !file.seek(size - PartialHashBlock)) {
+            return QByteArray();
+        }
+        const qint64 tailBytes = timedRead(file, tail.data(), PartialHashBlock);
+        if (tailBytes < 0) {
+            return QByteArray();
+        }
+        hash.addData(head.constData(), headBytes);
+        hash.addData(tail.constData(), tailBytes);
+    }
+    stats->add(ScanStats::FilesHashed);
+    return hash.result();
+}
+
+qint64 FileManager::timedRead(QFile& file, char *data, qint64 maxSize) {
+    ScanStats::Scope reading(stats, ScanStats::Read);
+    const qint64 bytes = file.read(data, maxSize);
+    if (bytes > 0) {
+        stats->add(ScanStats::BytesRead, quint64(bytes));
+    }
+    return bytes;
+}
+
+void FileManager::recordCacheCounters() {
+    stats->add(ScanStats::CacheHits, cache.hits());
+    stats->add(ScanStats::CacheMisses, cache.misses());
+}
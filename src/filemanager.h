@@ -5,26 +5,179 @@
 #include <QStringList>
 #include <QFileInfo>
 #include <QObject>
+#include <QHash>
+#include "hashcache.h"
+#include "directorywalker.h"
+#include "metadataindex.h"
+#include "duplicateremover.h"
+#include "fileanalyzer.h"
+#include "scanstats.h"
+#include "batchreader.h"
+#include "storagedevice.h"
+#include <functional>
+
+class DuplicateIndex;
+class HashEngine;
+class ScanJob;
 
 class FileManager : public QObject {
     Q_OBJECT
 
 public:
+    enum class HashAlgorithm {
+        Fast128,   // SIMD accelerated 128-bit hash, enough to tell files apart within a scan
+        Sha256     // Cryptographic digest for paranoid scans
+    };
+
+    // How candidates that survive the size and partial hash stages are confirmed
+    enum class ConfirmationMode {
+        ConfirmByHash,      // full hash, can be answered from the hash cache
+        ConfirmByContent    // byte-exact comparison, no false positives
+    };
+
     explicit FileManager(QObject *parent = nullptr);
     
-    bool batchRename(const QStringList& files, const QString& pattern);
+    // pattern is a RenamePattern; match, if given, is the regular expression
+    // whose captures %1..%9 insert
+    bool batchRename(const QStringList& files, const QString& pattern, const QString& match = QString());
     QStringList findDuplicatesByContent(const QString& directory);
+    QList<QStringList> findDuplicateGroups(const QString& directory);
+    // One scan across several roots, e.g. a NAS mount, a local SSD and a
+    // USB disk; roots nested in another root are only walked once
+    QList<QStringList> findDuplicateGroups(const QStringList& directories);
+    // Near duplicates: files whose content-defined chunks overlap by at
+    // least similarityThreshold() (Jaccard), clustered transitively
+    QList<QStringList> findSimilarGroups(const QString& directory);
     QStringList findDuplicatesByMetadata(const QString& directory);
-    bool removeDuplicates(const QStringList& files);
+    QList<QStringList> findMetadataGroups(const QString& directory);
+    // Reclaims the duplicates of each group with the current removal mode
+    // after re-verifying them against the group's original
+    bool removeDuplicates(const QList<DuplicateRemover::Group>& groups);
+    FileAnalyzer::Report analyzeContent(const QString& directory);
+    // Digest of the whole file with the current algorithm, empty on read errors
+    QByteArray calculateFileHash(const QString& filePath);
+    // Keeps a duplicate index of the tree in memory and regroups the files
+    // inotify reports as created, modified or moved until the job is
+    // cancelled. Changed files are grouped by their whole content: files of
+    // up to 2 * PartialHashBlock bytes by the partial hash, which then covers
+    // the whole file, larger ones by full hash.
+    bool watchDuplicates(const QString& directory);
+    // Full digests of every file below directories, with their groups, as
+    // a ScanSnapshot; snapshots of several hosts can then be merged to find
+    // duplicates across them without reading a file again. Of several
+    // snapshots of one host only the newest is merged.
+    bool exportSnapshot(const QStringList& directories, const QString& snapshotPath);
+    bool mergeSnapshots(const QStringList& snapshotPaths, const QString& outputPath);
+
+    // Run on a worker thread with this manager's settings. The work starts
+    // once control returns to the event loop; the returned job is parented
+    // to this FileManager and may be deleted once it has finished.
+    ScanJob *findDuplicatesAsync(const QString& directory);
+    ScanJob *findDuplicatesAsync(const QStringList& directories);
+    ScanJob *findSimilarAsync(const QString& directory);
+    ScanJob *batchRenameAsync(const QStringList& files, const QString& pattern, const QString& match = QString());
+    ScanJob *removeDuplicatesAsync(const QList<DuplicateRemover::Group>& groups);
+    ScanJob *analyzeContentAsync(const QString& directory);
+    ScanJob *watchDuplicatesAsync(const QString& directory);
+
+    void setHashThreadCount(int count);
+    int hashThreadCount() const;
+    // How full hashes read their files; Auto prefers io_uring where the
+    // kernel allows it. Each device gets its own reader, sized by
+    // StorageDevice::budget() from the thread count above.
+    void setReadBackend(BatchReader::Backend backend);
+    BatchReader::Backend readBackend() const;
+    void setHashAlgorithm(HashAlgorithm algorithm);
+    HashAlgorithm hashAlgorithm() const;
+    void setConfirmationMode(ConfirmationMode mode);
+    ConfirmationMode confirmationMode() const;
+    void setMetadataKeys(MetadataIndex::Keys keys);
+    MetadataIndex::Keys metadataKeys() const;
+    void setSimilarityThreshold(double threshold);
+    double similarityThreshold() const;
+    void setRemovalMode(DuplicateRemover::Mode mode);
+    DuplicateRemover::Mode removalMode() const;
+    void setRecursiveScan(bool enabled);
+    bool recursiveScan() const;
+    // Caps the memory findDuplicateGroups() spends on its candidate indexes,
+    // spilling sorted runs to the temp directory beyond it. The groups found
+    // are the same either way, only the files that end up in none stay out
+    // of memory. Such scans use the hash cache but add nothing to it; 0, the
+    // default, keeps everything in memory.
+    void setIndexMemoryLimit(qint64 bytes);
+    qint64 indexMemoryLimit() const;
+    // findDuplicateGroups() also saves its groups here, with the digests it
+    // computed; empty, the default, saves nothing
+    void setSnapshotPath(const QString& path);
+    QString snapshotPath() const;
+    HashCache& hashCache();
+    // Counters of synchronous calls; async jobs record into ScanJob::stats()
+    ScanStats& scanStats();
 
 signals:
     void progressUpdated(int progress, int total);
     void operationCompleted(bool success, const QString& message);
+    void duplicateGroupsFound(const QList<QStringList>& groups);
+    // Watch mode: groups containing any of paths are stale and replaced by groups
+    void duplicateGroupsChanged(const QStringList& paths, const QList<QStringList>& groups);
 
 private:
-    QString generateNewName(const QString& pattern, const QFileInfo& file, int index);
+    struct ScanCandidate {
+        QString path;
+        qint64 size = 0;
+        HashCache::FileStamp stamp;
+        QByteArray hash;
+    };
+
+    HashEngine *hashEngine;
+    HashAlgorithm algorithm = HashAlgorithm::Fast128;
+    ConfirmationMode confirmation = ConfirmationMode::ConfirmByHash;
+    MetadataIndex::Keys matchKeys = MetadataIndex::Keys(MetadataIndex::Size) | MetadataIndex::Name;
+    DuplicateRemover::Mode removal = DuplicateRemover::Mode::Delete;
+    double similarity = 0.7;
+    HashCache cache;
+    bool recursive = true;
+    qint64 indexLimit = 0;
+    QString snapshotFile;
+    BatchReader::Backend reader = BatchReader::Backend::Auto;
+    QHash<quint64, StorageDevice::Kind> deviceKinds;
+    ScanJob *job = nullptr;
+    ScanStats ownStats;
+    ScanStats *stats = &ownStats;
+
+    bool checkpoint() const;
+    ScanJob *startJob(const std::function<void(FileManager& worker, ScanJob *job)>& work);
+
     bool compareFiles(const QString& file1, const QString& file2);
-    QByteArray calculateFileHash(const QString& filePath);
+    QByteArray calculatePartialHash(const QString& filePath, qint64 size);
+    qint64 timedRead(QFile& file, char *data, qint64 maxSize);
+    void recordCacheCounters();
+    // Exact digest followed by the MinHash signature of the file's chunks
+    QByteArray calculateSimilarityDigest(const QString& filePath);
+    // Full digests of files, empty where reading failed. Files are read
+    // per device, all devices at once, each within its own I/O budget.
+    QVector<QByteArray> hashFilesBatched(const QStringList& files, const QVector<HashCache::FileStamp>& stamps);
+    StorageDevice::Kind deviceKind(quint64 device, const QString& path);
+    void hashCandidates(QVector<ScanCandidate>& candidates, qint64& bytesRead);
+    QList<QStringList> findDuplicateGroupsBounded(const QStringList& roots);
+    // Absolute, de-duplicated roots without those inside another root,
+    // symlinks resolved for the comparison
+    static QStringList scanRoots(const QStringList& directories);
+    // Line for a completion message naming files a scan could not read
+    static QString unreadableNote(const QStringList& files);
+    // files carry full digests or none; groups are matched to them by path
+    bool writeSnapshot(const QString& path, const QVector<ScanCandidate>& files,
+                       const QList<QStringList>& groups, QString& error);
+    bool buildIndex(DuplicateIndex& index, const QString& directory);
+    void resolveIndexHashes(DuplicateIndex& index, const QList<qint64>& sizes);
+    static HashCache::FileStamp stampFor(const DirectoryWalker::Entry& entry);
+
+    // Bytes read from each end of a file by the partial hash stage
+    static constexpr qint64 PartialHashBlock = 4096;
+    static constexpr qint64 ReadChunkSize = 1024 * 1024;
+    static constexpr int GroupReportBatch = 256;
+    // Files hashed together by the memory-bounded scan
+    static constexpr int IndexHashBatch = 4096;
 };
 
 #endif // FILEMANAGER_H
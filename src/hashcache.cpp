@@ -0,0 +1,372 @@
+#include "hashcache.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+constexpr char Magic[4] = {'R', 'Y', 'H', 'C'};
+constexpr quint32 Version = 1;
+constexpr qint64 SecondsPerDay = 24 * 60 * 60;
+constexpr int LockTimeoutMs = 10000;
+
+quint32 currentTime() {
+    return quint32(QDateTime::currentSecsSinceEpoch());
+}
+
+} // namespace
+
+HashCache::HashCache(const QString& filePath) : path(filePath) {
+    static_assert(sizeof(Record) == 104, "cache records are stored verbatim");
+}
+
+HashCache::~HashCache() {
+    unmap();
+}
+
+QString HashCache::defaultPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/hashcache.bin";
+}
+
+HashCache::FileStamp HashCache::stampFor(const QString& filePath, bool followSymlinks) {
+    FileStamp stamp;
+#ifdef Q_OS_UNIX
+    struct stat st;
+    const QByteArray path = QFile::encodeName(filePath);
+    const int result = followSymlinks ? ::stat(path.constData(), &st) : ::lstat(path.constData(), &st);
+    if (result == 0 && S_ISREG(st.st_mode)) {
+        stamp.device = quint64(st.st_dev);
+        stamp.inode = quint64(st.st_ino);
+        stamp.size = qint64(st.st_size);
+#ifdef Q_OS_DARWIN
+        stamp.mtimeNs = qint64(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+        stamp.mtimeNs = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    }
+#else
+    Q_UNUSED(filePath);
+    Q_UNUSED(followSymlinks);
+#endif
+    return stamp;
+}
+
+QString HashCache::filePath() const {
+    return path;
+}
+
+void HashCache::setFilePath(const QString& filePath) {
+    if (filePath == path) {
+        return;
+    }
+    unmap();
+    path = filePath;
+    pending.clear();
+    touched.clear();
+    removed.clear();
+    dirty = false;
+    loaded = false;
+}
+
+bool HashCache::isEnabled() const {
+    return enabled;
+}
+
+void HashCache::setEnabled(bool enable) {
+    enabled = enable;
+}
+
+bool HashCache::isReadOnly() const {
+    return readOnly;
+}
+
+void HashCache::setReadOnly(bool enable) {
+    readOnly = enable;
+}
+
+QByteArray HashCache::partialHash(const FileStamp& stamp, int algorithm) {
+    if (!enabled || !stamp.isValid()) {
+        return QByteArray();
+    }
+    ensureLoaded();
+
+    const Key key(stamp.device, stamp.inode);
+    const Record *record = find(key);
+    if (record && matches(record, stamp, algorithm) && record->partialLength > 0) {
+        ++hitCount;
+        if (!readOnly) {
+            touched.insert(key);
+            if (record->lastSeen + SecondsPerDay < currentTime()) {
+                dirty = true;
+            }
+        }
+        return QByteArray(record->partial, record->partialLength);
+    }
+    ++missCount;
+    return QByteArray();
+}
+
+QByteArray HashCache::fullHash(const FileStamp& stamp, int algorithm) {
+    if (!enabled || !stamp.isValid()) {
+        return QByteArray();
+    }
+    ensureLoaded();
+
+    const Key key(stamp.device, stamp.inode);
+    const Record *record = find(key);
+    if (record && matches(record, stamp, algorithm) && record->fullLength > 0) {
+        ++hitCount;
+        if (!readOnly) {
+            touched.insert(key);
+            if (record->lastSeen + SecondsPerDay < currentTime()) {
+                dirty = true;
+            }
+        }
+        return QByteArray(record->full, record->fullLength);
+    }
+    ++missCount;
+    return QByteArray();
+}
+
+void HashCache::insertPartialHash(const FileStamp& stamp, int algorithm, const QByteArray& hash) {
+    if (!enabled || readOnly || !stamp.isValid() || hash.isEmpty() || hash.size() > MaxDigestLength) {
+        return;
+    }
+    ensureLoaded();
+
+    Record *record = recordFor(stamp, algorithm);
+    std::memcpy(record->partial, hash.constData(), size_t(hash.size()));
+    record->partialLength = quint8(hash.size());
+}
+
+void HashCache::insertFullHash(const FileStamp& stamp, int algorithm, const QByteArray& hash) {
+    if (!enabled || readOnly || !stamp.isValid() || hash.isEmpty() || hash.size() > MaxDigestLength) {
+        return;
+    }
+    ensureLoaded();
+
+    Record *record = recordFor(stamp, algorithm);
+    std::memcpy(record->full, hash.constData(), size_t(hash.size()));
+    record->fullLength = quint8(hash.size());
+}
+
+void HashCache::invalidate(const FileStamp& stamp) {
+    const Key key(stamp.device, stamp.inode);
+    pending.remove(key);
+    touched.remove(key);
+    removed.insert(key);
+    dirty = true;
+}
+
+void HashCache::clear() {
+    unmap();
+    QFile::remove(path);
+    pending.clear();
+    touched.clear();
+    removed.clear();
+    dirty = false;
+    loaded = false;
+}
+
+bool HashCache::save() {
+    return write(false);
+}
+
+bool HashCache::compact() {
+    return write(true);
+}
+
+void HashCache::setMaxAgeDays(int days) {
+    maxAgeDays = qMax(1, days);
+}
+
+int HashCache::size() const {
+    // Upper bound: keys re-hashed this session are counted in both places
+    return int(mappedCount) + pending.size();
+}
+
+quint64 HashCache::hits() const {
+    return hitCount;
+}
+
+quint64 HashCache::misses() const {
+    return missCount;
+}
+
+void HashCache::resetCounters() {
+    hitCount = 0;
+    missCount = 0;
+}
+
+void HashCache::ensureLoaded() {
+    if (loaded) {
+        return;
+    }
+    loaded = true;
+
+    file.setFileName(path);
+    if (!file.open(QFile::ReadOnly) || file.size() < qint64(sizeof(Header))) {
+        file.close();
+        return;
+    }
+
+    uchar *data = file.map(0, file.size());
+    if (!data) {
+        file.close();
+        return;
+    }
+
+    Header header;
+    std::memcpy(&header, data, sizeof(header));
+    const qint64 expected = qint64(sizeof(Header)) + qint64(header.count) * qint64(sizeof(Record));
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version
+        || header.recordSize != sizeof(Record) || expected > file.size()) {
+        // Unknown or truncated cache, it will be replaced on the next save
+        file.unmap(data);
+        file.close();
+        return;
+    }
+
+    mapped = reinterpret_cast<const Record *>(data + sizeof(Header));
+    mappedCount = header.count;
+}
+
+void HashCache::unmap() {
+    if (mapped) {
+        file.unmap(reinterpret_cast<uchar *>(const_cast<Record *>(mapped)) - sizeof(Header));
+        mapped = nullptr;
+        mappedCount = 0;
+    }
+    file.close();
+}
+
+const HashCache::Record *HashCache::find(const Key& key) const {
+    auto it = pending.constFind(key);
+    if (it != pending.constEnd()) {
+        return &it.value();
+    }
+    if (!mapped || removed.contains(key)) {
+        return nullptr;
+    }
+
+    const Record *end = mapped + mappedCount;
+    const Record *record = std::lower_bound(mapped, end, key,
+        [](const Record& r, const Key& k) {
+            return r.device < k.first || (r.device == k.first && r.inode < k.second);
+        });
+    if (record != end && record->device == key.first && record->inode == key.second) {
+        return record;
+    }
+    return nullptr;
+}
+
+HashCache::Record *HashCache::recordFor(const FileStamp& stamp, int algorithm) {
+    const Key key(stamp.device, stamp.inode);
+    auto it = pending.find(key);
+    if (it == pending.end() || !matches(&it.value(), stamp, algorithm)) {
+        Record record;
+        const Record *existing = find(key);
+        if (existing && matches(existing, stamp, algorithm)) {
+            record = *existing;
+        } else {
+            std::memset(&record, 0, sizeof(record));
+            record.device = stamp.device;
+            record.inode = stamp.inode;
+            record.size = stamp.size;
+            record.mtimeNs = stamp.mtimeNs;
+            record.algorithm = quint8(algorithm);
+        }
+        it = pending.insert(key, record);
+    }
+
+    removed.remove(key);
+    it->lastSeen = currentTime();
+    dirty = true;
+    return &it.value();
+}
+
+bool HashCache::matches(const Record *record, const FileStamp& stamp, int algorithm) const {
+    return record->size == stamp.size && record->mtimeNs == stamp.mtimeNs
+        && record->algorithm == quint8(algorithm);
+}
+
+bool HashCache::write(bool force) {
+    if (!enabled || (!force && !dirty)) {
+        return true;
+    }
+
+    // Another HashCache, in this process or another, may have saved since
+    // the file was mapped. Re-read it under the lock so its entries are
+    // merged rather than overwritten by ours.
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QLockFile lock(path + ".lock");
+    if (!lock.tryLock(LockTimeoutMs)) {
+        return false;
+    }
+    unmap();
+    loaded = false;
+    ensureLoaded();
+
+    const quint32 now = currentTime();
+    const qint64 cutoff = qint64(now) - qint64(maxAgeDays) * SecondsPerDay;
+
+    QVector<Record> records;
+    records.reserve(int(mappedCount) + pending.size());
+    for (quint32 i = 0; i < mappedCount; ++i) {
+        Record record = mapped[i];
+        const Key key(record.device, record.inode);
+        if (pending.contains(key) || removed.contains(key)) {
+            continue;
+        }
+        if (touched.contains(key)) {
+            record.lastSeen = now;
+        }
+        if (qint64(record.lastSeen) < cutoff) {
+            continue;
+        }
+        records.append(record);
+    }
+    for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+        records.append(it.value());
+    }
+
+    std::sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+        return a.device < b.device || (a.device == b.device && a.inode < b.inode);
+    });
+
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.recordSize = sizeof(Record);
+    header.count = quint32(records.size());
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(records.constData()),
+              qint64(records.size()) * qint64(sizeof(Record)));
+
+    unmap();
+    if (!out.commit()) {
+        loaded = false;
+        return false;
+    }
+
+    pending.clear();
+    touched.clear();
+    removed.clear();
+    dirty = false;
+    loaded = false;
+    return true;
+}
@@ -0,0 +1,112 @@
+#ifndef HASHCACHE_H
+#define HASHCACHE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+// Persistent digest index keyed by (device, inode). Entries are only reused
+// while size and mtime still match. The file is a flat array of fixed-size
+// records sorted by key and memory-mapped, so opening a cache of millions of
+// entries costs a single mmap; new digests collect in memory until save().
+class HashCache {
+public:
+    struct FileStamp {
+        quint64 device = 0;
+        quint64 inode = 0;
+        qint64 size = -1;
+        qint64 mtimeNs = 0;
+
+        bool isValid() const { return size >= 0; }
+    };
+
+    explicit HashCache(const QString& filePath = defaultPath());
+    ~HashCache();
+
+    static QString defaultPath();
+    // Invalid unless filePath is a regular file; a symlink is followed
+    // only with followSymlinks
+    static FileStamp stampFor(const QString& filePath, bool followSymlinks = true);
+
+    QString filePath() const;
+    void setFilePath(const QString& filePath);
+    bool isEnabled() const;
+    void setEnabled(bool enabled);
+    // Lookups still answer, but nothing is inserted or kept in memory for
+    // the next save(), so the cache costs no memory per file looked up
+    bool isReadOnly() const;
+    void setReadOnly(bool readOnly);
+
+    QByteArray partialHash(const FileStamp& stamp, int algorithm);
+    QByteArray fullHash(const FileStamp& stamp, int algorithm);
+    void insertPartialHash(const FileStamp& stamp, int algorithm, const QByteArray& hash);
+    void insertFullHash(const FileStamp& stamp, int algorithm, const QByteArray& hash);
+    void invalidate(const FileStamp& stamp);
+    void clear();
+
+    // Merges pending digests into the file as it is on disk now, dropping
+    // entries not used for maxAgeDays. Saves of caches sharing the file are
+    // serialized by a lock file beside it, so none loses the other's
+    // entries. compact() rewrites the file even when nothing changed.
+    bool save();
+    bool compact();
+    void setMaxAgeDays(int days);
+
+    int size() const;
+    quint64 hits() const;
+    quint64 misses() const;
+    void resetCounters();
+
+    static constexpr int MaxDigestLength = 32;
+
+private:
+    struct Record {
+        quint64 device;
+        quint64 inode;
+        qint64 size;
+        qint64 mtimeNs;
+        quint32 lastSeen;
+        quint8 algorithm;
+        quint8 partialLength;
+        quint8 fullLength;
+        quint8 reserved;
+        char partial[MaxDigestLength];
+        char full[MaxDigestLength];
+    };
+
+    struct Header {
+        char magic[4];
+        quint32 version;
+        quint32 recordSize;
+        quint32 count;
+    };
+
+    using Key = QPair<quint64, quint64>;
+
+    void ensureLoaded();
+    void unmap();
+    const Record *find(const Key& key) const;
+    Record *recordFor(const FileStamp& stamp, int algorithm);
+    bool matches(const Record *record, const FileStamp& stamp, int algorithm) const;
+    bool write(bool force);
+
+    QString path;
+    QFile file;
+    const Record *mapped = nullptr;
+    quint32 mappedCount = 0;
+    bool loaded = false;
+    bool enabled = true;
+    bool readOnly = false;
+    bool dirty = false;
+    int maxAgeDays = 90;
+
+    QHash<Key, Record> pending;
+    QSet<Key> touched;
+    QSet<Key> removed;
+    quint64 hitCount = 0;
+    quint64 missCount = 0;
+};
+
+#endif // HASHCACHE_H
@@ -0,0 +1,141 @@
+#include "hashengine.h"
+#include <QThread>
+
+HashEngine::HashEngine(QObject *parent) : QObject(parent) {
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+HashEngine::~HashEngine() {
+    {
+        QMutexLocker locker(&mutex);
+        closed = true;
+        smallJobs.clear();
+        largeJobs.clear();
+        jobAvailable.wakeAll();
+    }
+    pool.waitForDone();
+}
+
+void HashEngine::setMaxThreadCount(int count) {
+    pool.setMaxThreadCount(qMax(1, count));
+}
+
+int HashEngine::maxThreadCount() const {
+    return pool.maxThreadCount();
+}
+
+QVector<QByteArray> HashEngine::hashFiles(const QStringList& files, const QVector<qint64>& sizes,
+                                          const HashFunction& hashFunction) {
+    begin(hashFunction);
+    for (int i = 0; i < files.size(); ++i) {
+        submit(files[i], sizes.value(i));
+    }
+    return finish();
+}
+
+void HashEngine::begin(const HashFunction& function) {
+    QMutexLocker locker(&mutex);
+    Q_ASSERT(closed);
+    hashFunction = function;
+    results.clear();
+    activeLarge = 0;
+    completed = 0;
+    closed = false;
+    locker.unlock();
+
+    for (int i = 0; i < pool.maxThreadCount(); ++i) {
+        pool.start([this]() { workerLoop(); });
+    }
+}
+
+int HashEngine::submit(const QString& filePath, qint64 size) {
+    QMutexLocker locker(&mutex);
+    Job job;
+    job.index = results.size();
+    job.filePath = filePath;
+    job.size = size;
+    results.append(QByteArray());
+
+    if (size >= LargeFileThreshold) {
+        largeJobs.enqueue(job);
+    } else {
+        smallJobs.enqueue(job);
+    }
+    jobAvailable.wakeOne();
+    return job.index;
+}
+
+QVector<QByteArray> HashEngine::finish() {
+    QMutexLocker locker(&mutex);
+    closed = true;
+    jobAvailable.wakeAll();
+
+    // Progress is emitted from the calling thread only, so receivers see a
+    // monotonic sequence no matter which worker finished first
+    const int total = results.size();
+    int reported = -1;
+    while (completed < total) {
+        jobFinished.wait(&mutex, 100);
+        if (completed != reported) {
+            reported = completed;
+            locker.unlock();
+            emit progressUpdated(reported, total);
+            locker.relock();
+        }
+    }
+    locker.unlock();
+
+    pool.waitForDone();
+    if (total > 0 && reported != total) {
+        emit progressUpdated(total, total);
+    }
+    return std::move(results);
+}
+
+void HashEngine::workerLoop() {
+    QMutexLocker locker(&mutex);
+    Job job;
+    bool large = false;
+    while (takeJob(job, large)) {
+        if (large) {
+            ++activeLarge;
+        }
+        locker.unlock();
+
+        QByteArray hash = hashFunction(job.filePath, job.size);
+
+        locker.relock();
+        if (large) {
+            --activeLarge;
+            jobAvailable.wakeAll();
+        }
+        results[job.index] = hash;
+        ++completed;
+        jobFinished.wakeAll();
+    }
+}
+
+bool HashEngine::takeJob(Job& job, bool& large) {
+    for (;;) {
+        // Large files get a bounded share of the workers until nothing else is left
+        if (!largeJobs.isEmpty()
+            && (activeLarge < largeFileLimit() || (closed && smallJobs.isEmpty()))) {
+            job = largeJobs.dequeue();
+            large = true;
+            return true;
+        }
+        if (!smallJobs.isEmpty()) {
+            job = smallJobs.dequeue();
+            large = false;
+            return true;
+        }
+        if (closed && largeJobs.isEmpty()) {
+            return false;
+        }
+        jobAvailable.wait(&mutex);
+    }
+}
+
+int HashEngine::largeFileLimit() const {
+    return qMax(1, pool.maxThreadCount() / 2);
+}
@@ -0,0 +1,69 @@
+#ifndef HASHENGINE_H
+#define HASHENGINE_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <functional>
+
+// Hashes many files concurrently on a private worker pool. Files above
+// LargeFileThreshold may only occupy half of the workers so that a few huge
+// files cannot hold up the rest of a scan.
+class HashEngine : public QObject {
+    Q_OBJECT
+
+public:
+    using HashFunction = std::function<QByteArray(const QString& filePath, qint64 size)>;
+
+    explicit HashEngine(QObject *parent = nullptr);
+    ~HashEngine();
+
+    void setMaxThreadCount(int count);
+    int maxThreadCount() const;
+
+    // Blocking convenience wrapper around begin/submit/finish
+    QVector<QByteArray> hashFiles(const QStringList& files, const QVector<qint64>& sizes,
+                                  const HashFunction& hashFunction);
+
+    // Streaming interface: jobs start as soon as they are submitted and
+    // finish() returns the digests in submission order
+    void begin(const HashFunction& hashFunction);
+    int submit(const QString& filePath, qint64 size);
+    QVector<QByteArray> finish();
+
+    static constexpr qint64 LargeFileThreshold = 64 * 1024 * 1024;
+
+signals:
+    void progressUpdated(int progress, int total);
+
+private:
+    struct Job {
+        int index = -1;
+        QString filePath;
+        qint64 size = 0;
+    };
+
+    void workerLoop();
+    bool takeJob(Job& job, bool& large);
+    int largeFileLimit() const;
+
+    QThreadPool pool;
+    HashFunction hashFunction;
+
+    QMutex mutex;
+    QWaitCondition jobAvailable;
+    QWaitCondition jobFinished;
+    QQueue<Job> smallJobs;
+    QQueue<Job> largeJobs;
+    QVector<QByteArray> results;
+    int activeLarge = 0;
+    int completed = 0;
+    bool closed = true;
+};
+
+#endif // HASHENGINE_H
@@ -0,0 +1,34 @@
+#include "jobprogressdialog.h"
+#include <QPushButton>
+#include <QStyle>
+#include "scanjob.h"
+
+JobProgressDialog::JobProgressDialog(ScanJob *job, const QString& label, QWidget *parent)
+    : QProgressDialog(label, QString(), 0, 0, parent)
+    , cancelButton(new QPushButton(tr("Cancel"), this))
+    , pauseButton(new QPushButton(tr("Pause"), this))
+{
+    setCancelButton(cancelButton);
+    pauseButton->setCheckable(true);
+    pauseButton->setAutoDefault(false);
+
+    connect(this, &QProgressDialog::canceled, job, &ScanJob::cancel);
+    connect(pauseButton, &QPushButton::toggled, job, [this, job](bool paused) {
+        if (paused) {
+            job->pause();
+        } else {
+            job->resume();
+        }
+        pauseButton->setText(paused ? tr("Resume") : tr("Pause"));
+    });
+}
+
+void JobProgressDialog::resizeEvent(QResizeEvent *event) {
+    // QProgressDialog only lays out its own widgets, so Pause follows Cancel
+    QProgressDialog::resizeEvent(event);
+    const int spacing = style()->pixelMetric(QStyle::PM_LayoutHorizontalSpacing, nullptr, this);
+    QRect geometry = cancelButton->geometry();
+    geometry.setWidth(qMax(geometry.width(), pauseButton->sizeHint().width()));
+    geometry.moveRight(cancelButton->geometry().left() - qMax(spacing, 6));
+    pauseButton->setGeometry(geometry);
+}
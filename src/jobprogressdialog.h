@@ -0,0 +1,25 @@
+#ifndef JOBPROGRESSDIALOG_H
+#define JOBPROGRESSDIALOG_H
+
+#include <QProgressDialog>
+
+class QPushButton;
+class ScanJob;
+
+// Progress dialog for a running ScanJob. Cancel cancels the job and a Pause
+// button beside it pauses and resumes the worker at its next checkpoint.
+class JobProgressDialog : public QProgressDialog {
+    Q_OBJECT
+
+public:
+    JobProgressDialog(ScanJob *job, const QString& label, QWidget *parent = nullptr);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    QPushButton *cancelButton;
+    QPushButton *pauseButton;
+};
+
+#endif // JOBPROGRESSDIALOG_H
@@ -3,6 +3,8 @@
 
 int main(int argc, char *argv[]) {
     QApplication app(argc, argv);
+    // Names the app data directory, which the startup benchmark shares
+    QApplication::setApplicationName("FileManager");
     MainWindow window;
     window.show();
     return app.exec();
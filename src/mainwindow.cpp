@@ -13,15 +13,40 @@
 #include <QLabel>
 #include <QProgressDialog>
 #include <QLineEdit>
-#include <QListWidget>
 #include <QSplitter>
+#include <QTime>
+#include <QLocale>
+#include <QApplication>
+#include <QPalette>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QTimer>
+#include <memory>
+#include "scanjob.h"
+#include "duplicateresultmodel.h"
+#include "directorysizemodel.h"
+#include "scansnapshot.h"
+#include "renamedialog.h"
+#include "jobprogressdialog.h"
+
+namespace {
+
+// Small per-user state that is restored at startup
+QString sessionPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/session.ini";
+}
+
+} // namespace
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
-    , fileModel(new QFileSystemModel(this))
     , fileManager(new FileManager(this))
+    , directorySizes(new DirectorySizeScanner(this))
+    , sizeModel(new DirectorySizeModel(directorySizes, this))
 {
+    setupDarkTheme();
     ui->setupUi(this);
     
     QMenu *fileMenu = menuBar()->addMenu(tr("&File"));
@@ -30,15 +55,35 @@ MainWindow::MainWindow(QWidget *parent)
     selectDirAction = new QAction(tr("Select Directory"), this);
     batchRenameAction = new QAction(tr("Batch Rename"), this);
     findDuplicatesAction = new QAction(tr("Find Duplicates"), this);
+    findSimilarAction = new QAction(tr("Find Similar Files"), this);
     analyzeContentAction = new QAction(tr("Analyze Content"), this);
+    watchAction = new QAction(tr("Watch for Changes"), this);
+    watchAction->setCheckable(true);
     
     fileMenu->addAction(selectDirAction);
     toolsMenu->addAction(batchRenameAction);
     toolsMenu->addAction(findDuplicatesAction);
+    toolsMenu->addAction(findSimilarAction);
     toolsMenu->addAction(analyzeContentAction);
+    toolsMenu->addAction(watchAction);
     
     setupUI();
     setupConnections();
+
+    // Each finished operation overwrites the trace file
+    if (qEnvironmentVariableIsSet("FILEMANAGER_TRACE")) {
+        fileManager->scanStats().setTracing(true);
+    }
+
+    // Everything that touches the file system waits for the first frame,
+    // unless the old eager startup is asked for, e.g. to compare the two
+    if (qEnvironmentVariableIsSet("FILEMANAGER_EAGER_START")) {
+        setupDuplicatesUI();
+        finishStartup();
+    } else {
+        setActionsEnabled(false);
+        treeView->viewport()->installEventFilter(this);
+    }
 }
 
 MainWindow::~MainWindow() {
@@ -46,32 +91,23 @@ MainWindow::~MainWindow() {
 }
 
 void MainWindow::setupUI() {
-    setupDarkTheme();
-    
     mainSplitter = new QSplitter(Qt::Horizontal, this);
     
     QWidget* leftWidget = new QWidget(this);
     QVBoxLayout* leftLayout = new QVBoxLayout(leftWidget);
     
+    // The file model is created and rooted by finishStartup()
     treeView = new QTreeView(this);
-    treeView->setModel(fileModel);
-    treeView->setRootIndex(fileModel->index(QDir::homePath()));
     treeView->setSelectionMode(QAbstractItemView::ExtendedSelection);
-    treeView->setColumnWidth(0, 250);
-    treeView->setSortingEnabled(true);
     
     leftLayout->addWidget(treeView);
     
     QWidget* rightWidget = new QWidget(this);
-    QVBoxLayout* rightLayout = new QVBoxLayout(rightWidget);
+    resultsLayout = new QVBoxLayout(rightWidget);
     
     detailsLabel = new QLabel(this);
     detailsLabel->setWordWrap(true);
-    rightLayout->addWidget(detailsLabel);
-    
-    setupDuplicatesUI();
-    rightLayout->addWidget(duplicatesList);
-    rightLayout->addWidget(removeDuplicatesButton);
+    resultsLayout->addWidget(detailsLabel);
     
     mainSplitter->addWidget(leftWidget);
     mainSplitter->addWidget(rightWidget);
@@ -82,81 +118,127 @@ void MainWindow::setupUI() {
 }
 
 void MainWindow::setupDarkTheme() {
-    QString darkStyle = R"(
-        QMainWindow, QWidget {
-            background-color: #2b2b2b;
-            color: #ffffff;
-        }
-        QTreeView, QListWidget {
-            background-color: #333333;
-            color: #ffffff;
-            border: 1px solid #555555;
-        }
-        QTreeView::item:selected, QListWidget::item:selected {
-            background-color: #2d5a88;
-        }
-        QLabel {
-            color: #ffffff;
-        }
-        QPushButton {
-            background-color: #444444;
-            color: #ffffff;
-            border: 1px solid #555555;
-            padding: 5px 15px;
-            border-radius: 3px;
-        }
-        QPushButton:hover {
-            background-color: #555555;
-        }
-        QPushButton:pressed {
-            background-color: #666666;
-        }
-        QMenuBar {
-            background-color: #2b2b2b;
-            color: #ffffff;
-        }
-        QMenuBar::item:selected {
-            background-color: #444444;
-        }
-        QMenu {
-            background-color: #2b2b2b;
-            color: #ffffff;
-        }
-        QMenu::item:selected {
-            background-color: #444444;
-        }
-        QToolBar {
-            background-color: #333333;
-            border: 1px solid #555555;
-        }
-        QStatusBar {
-            background-color: #2b2b2b;
-            color: #ffffff;
-        }
-    )";
-    
-    setStyleSheet(darkStyle);
+    // A palette rather than a style sheet: there is nothing to parse and
+    // widgets are not polished through QStyleSheetStyle one by one
+    QApplication::setStyle("Fusion");
+    QPalette dark;
+    dark.setColor(QPalette::Window, QColor(0x2b2b2b));
+    dark.setColor(QPalette::WindowText, Qt::white);
+    dark.setColor(QPalette::Base, QColor(0x333333));
+    dark.setColor(QPalette::AlternateBase, QColor(0x3a3a3a));
+    dark.setColor(QPalette::Text, Qt::white);
+    dark.setColor(QPalette::Button, QColor(0x444444));
+    dark.setColor(QPalette::ButtonText, Qt::white);
+    dark.setColor(QPalette::Mid, QColor(0x555555));
+    dark.setColor(QPalette::Highlight, QColor(0x2d5a88));
+    dark.setColor(QPalette::HighlightedText, Qt::white);
+    dark.setColor(QPalette::ToolTipBase, QColor(0x333333));
+    dark.setColor(QPalette::ToolTipText, Qt::white);
+    for (QPalette::ColorRole role : {QPalette::WindowText, QPalette::Text, QPalette::ButtonText}) {
+        dark.setColor(QPalette::Disabled, role, QColor(0x808080));
+    }
+    QApplication::setPalette(dark);
 }
 
+// Built on the first results, most sessions start without any
 void MainWindow::setupDuplicatesUI() {
-    duplicatesList = new QListWidget(this);
-    duplicatesList->setSelectionMode(QAbstractItemView::MultiSelection);
-    duplicatesList->setHidden(true);
+    if (duplicatesModel) {
+        return;
+    }
+    duplicatesModel = new DuplicateResultModel(this);
+    duplicatesView = new QTreeView(this);
+    duplicatesView->setModel(duplicatesModel);
+    duplicatesView->setUniformRowHeights(true);
+    duplicatesView->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    duplicatesView->setHidden(true);
     
     removeDuplicatesButton = new QPushButton("Remove Selected Duplicates", this);
     removeDuplicatesButton->setHidden(true);
     
+    resultsLayout->addWidget(duplicatesView);
+    resultsLayout->addWidget(removeDuplicatesButton);
     connect(removeDuplicatesButton, &QPushButton::clicked, this, &MainWindow::onRemoveDuplicates);
 }
 
+bool MainWindow::eventFilter(QObject *watched, QEvent *event) {
+    if (!started && event->type() == QEvent::Paint && watched == treeView->viewport()) {
+        // Queued, so this frame reaches the screen before any directory is read
+        QTimer::singleShot(0, this, &MainWindow::finishStartup);
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::finishStartup() {
+    if (started) {
+        return;
+    }
+    started = true;
+    treeView->viewport()->removeEventFilter(this);
+
+    // Directories show their recursive size, counted as they come into view
+    fileModel = new QFileSystemModel(this);
+    sizeModel->setSourceModel(fileModel);
+    sizeModel->setPathRole(QFileSystemModel::FilePathRole);
+    treeView->setModel(sizeModel);
+    treeView->setColumnWidth(0, 250);
+    treeView->setSortingEnabled(true);
+
+    QSettings session(sessionPath(), QSettings::IniFormat);
+    const QString root = session.value("root").toString();
+    const QString home = QDir::homePath();
+    setRootPath(home);
+    if (!root.isEmpty() && root != home) {
+        // The file model stats any root it is given, and a share that has
+        // gone away can take seconds to say so. The saved directory is
+        // therefore checked off the GUI thread and only opened once it is
+        // known to be there.
+        QPointer<MainWindow> window(this);
+        QThreadPool::globalInstance()->start([window, root, home]() {
+            if (!QFileInfo(root).isDir()) {
+                return;
+            }
+            QMetaObject::invokeMethod(qApp, [window, root, home]() {
+                if (window && window->rootPath == home) {
+                    window->setRootPath(root);
+                }
+            }, Qt::QueuedConnection);
+        });
+    }
+    setActionsEnabled(true);
+
+    // Duplicate scans leave a snapshot behind, so the last results are
+    // back on screen as soon as the window is up
+    fileManager->setSnapshotPath(ScanSnapshot::defaultPath());
+    showLastResults();
+    emit startupFinished();
+}
+
+void MainWindow::setRootPath(const QString& path) {
+    rootPath = path;
+    treeView->setRootIndex(sizeModel->mapFromSource(fileModel->setRootPath(path)));
+}
+
+void MainWindow::setActionsEnabled(bool enabled) {
+    for (QAction *action : {selectDirAction, batchRenameAction, findDuplicatesAction,
+                            findSimilarAction, analyzeContentAction, watchAction}) {
+        action->setEnabled(enabled);
+    }
+}
+
 void MainWindow::setupConnections() {
     connect(selectDirAction, &QAction::triggered, this, &MainWindow::onDirectorySelected);
     connect(batchRenameAction, &QAction::triggered, this, &MainWindow::onBatchRename);
     connect(findDuplicatesAction, &QAction::triggered, this, &MainWindow::onFindDuplicates);
+    connect(findSimilarAction, &QAction::triggered, this, &MainWindow::onFindSimilar);
     connect(analyzeContentAction, &QAction::triggered, this, &MainWindow::onAnalyzeContent);
+    connect(watchAction, &QAction::toggled, this, &MainWindow::onWatchToggled);
+    connect(treeView, &QTreeView::expanded, sizeModel, &DirectorySizeModel::refresh);
 }
 
 void MainWindow::onBatchRename() {
+    if (activeJob) {
+        return;
+    }
     QModelIndexList selection = treeView->selectionModel()->selectedRows();
     if (selection.isEmpty()) {
         QMessageBox::warning(this, "Error", "Please select files to rename");
@@ -165,100 +247,264 @@ void MainWindow::onBatchRename() {
 
     QStringList files;
     for (const QModelIndex& index : selection) {
-        files << fileModel->filePath(index);
+        files << sizeModel->filePath(index);
     }
 
-    bool ok;
-    QString helpText = "Available patterns:\n"
-                      "%n - number (001, 002, etc)\n"
-                      "%d - date (YYYYMMDD)\n"
-                      "%o - original name\n"
-                      "%e - extension";
-                      
-    QString pattern = QInputDialog::getText(this, "Batch Rename",
-                                          "Enter rename pattern:\n\n" + helpText,
-                                          QLineEdit::Normal,
-                                          "file_%n", &ok);
-    if (!ok || pattern.isEmpty()) {
+    RenameDialog dialog(files, this);
+    if (dialog.exec() != QDialog::Accepted) {
         return;
     }
 
-    QProgressDialog progress("Renaming files...", "Cancel", 0, files.size(), this);
-    progress.setWindowModality(Qt::WindowModal);
+    ScanJob *job = fileManager->batchRenameAsync(files, dialog.pattern(), dialog.match());
+    trackJob(job, "Renaming files...");
 
-    connect(fileManager, &FileManager::progressUpdated,
-            &progress, &QProgressDialog::setValue);
-    
-    connect(fileManager, &FileManager::operationCompleted,
-            this, [this](bool success, const QString& message) {
-                if (success) {
-                    QMessageBox::information(this, "Success", message);
-                } else {
-                    QMessageBox::warning(this, "Operation Complete", message);
-                }
-            });
-
-    fileManager->batchRename(files, pattern);
+    connect(job, &ScanJob::finished, this, [this](bool success, const QString& message) {
+        if (success) {
+            QMessageBox::information(this, "Success", message);
+        } else {
+            QMessageBox::warning(this, "Operation Complete", message);
+        }
+    });
 }
 
 void MainWindow::onAnalyzeContent() {
-    // Implementation coming soon
+    if (activeJob) {
+        return;
+    }
+
+    // A selected directory is analysed on its own, otherwise the whole view
+    QString path = sizeModel->filePath(treeView->rootIndex());
+    const QModelIndexList selection = treeView->selectionModel()->selectedRows();
+    if (!selection.isEmpty() && fileModel->isDir(sizeModel->mapToSource(selection.first()))) {
+        path = sizeModel->filePath(selection.first());
+    }
+
+    ScanJob *job = fileManager->analyzeContentAsync(path);
+    trackJob(job, "Analyzing content...");
+
+    connect(job, &ScanJob::finished, this, [this](bool success, const QString& message) {
+        if (success) {
+            detailsLabel->setText(message);
+            statusBar()->showMessage(message.section('\n', 0, 0));
+        } else {
+            statusBar()->showMessage(message);
+        }
+    });
 }
 
 void MainWindow::onFindDuplicates() {
-    QString currentPath = fileModel->filePath(treeView->rootIndex());
-    
-    QProgressDialog progress("Finding duplicates...", "Cancel", 0, 100, this);
-    progress.setWindowModality(Qt::WindowModal);
-    
-    connect(fileManager, &FileManager::progressUpdated,
-            &progress, &QProgressDialog::setValue);
-            
-    QStringList duplicates = fileManager->findDuplicatesByContent(currentPath);
-    onDuplicatesFound(duplicates);
+    if (activeJob) {
+        return;
+    }
+
+    // Several selected folders are scanned together, across volumes if need be
+    QStringList roots;
+    for (const QModelIndex& index : treeView->selectionModel()->selectedRows()) {
+        const QString path = sizeModel->filePath(index);
+        if (QFileInfo(path).isDir()) {
+            roots << path;
+        }
+    }
+    if (roots.size() < 2) {
+        roots = QStringList{sizeModel->filePath(treeView->rootIndex())};
+    }
+    showDuplicateResults(fileManager->findDuplicatesAsync(roots), "Finding duplicates...");
 }
 
-void MainWindow::onDuplicatesFound(const QStringList& duplicates) {
-    duplicatesList->clear();
-    
-    if (duplicates.isEmpty()) {
-        QMessageBox::information(this, "No Duplicates", "No duplicate files found.");
-        duplicatesList->setHidden(true);
-        removeDuplicatesButton->setHidden(true);
+void MainWindow::onFindSimilar() {
+    if (activeJob) {
         return;
     }
-    
-    for (const QString& file : duplicates) {
-        QListWidgetItem* item = new QListWidgetItem(file);
-        item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-        item->setCheckState(Qt::Unchecked);
-        duplicatesList->addItem(item);
+
+    QString currentPath = sizeModel->filePath(treeView->rootIndex());
+    showDuplicateResults(fileManager->findSimilarAsync(currentPath), "Finding similar files...");
+}
+
+void MainWindow::showDuplicateResults(ScanJob *job, const QString& label) {
+    stopWatching();
+    trackJob(job, label);
+    setupDuplicatesUI();
+
+    duplicatesModel->clear();
+    onDuplicatesFound(QList<QStringList>());
+    connect(job, &ScanJob::duplicatesFound, this, &MainWindow::onDuplicatesFound);
+    connect(job, &ScanJob::finished, this, [this](bool success, const QString& message) {
+        statusBar()->showMessage(QString(message).replace('\n', "; "));
+        if (success && duplicatesModel->groupCount() == 0) {
+            QMessageBox::information(this, "No Duplicates", "No duplicate files found.");
+        }
+    });
+}
+
+void MainWindow::showLastResults() {
+    auto snapshot = std::make_shared<ScanSnapshot>();
+    if (!snapshot->load(ScanSnapshot::defaultPath()) || snapshot->groupCount() == 0) {
+        return;
     }
-    
-    duplicatesList->setHidden(false);
-    removeDuplicatesButton->setHidden(false);
+    // Groups are read from the mapped snapshot as they are scrolled to
+    setupDuplicatesUI();
+    duplicatesModel->setGroupSource(int(snapshot->groupCount()), [snapshot](int first, int count) {
+        return snapshot->groups(first, count);
+    });
+    onDuplicatesFound(QList<QStringList>());
+    statusBar()->showMessage(QString("%1 duplicate groups from the scan of %2")
+                             .arg(snapshot->groupCount())
+                             .arg(QLocale().toString(snapshot->created(), QLocale::ShortFormat)));
 }
 
-void MainWindow::onRemoveDuplicates() {
-    QStringList filesToRemove;
-    
-    for (int i = 0; i < duplicatesList->count(); ++i) {
-        QListWidgetItem* item = duplicatesList->item(i);
-        if (item->checkState() == Qt::Checked) {
-            filesToRemove << item->text();
+void MainWindow::onWatchToggled(bool enabled) {
+    if (!enabled) {
+        stopWatching();
+        statusBar()->showMessage("Stopped watching for changes");
+        return;
+    }
+    if (watchJob) {
+        return;
+    }
+
+    // The watch runs in the background without a progress dialog and keeps
+    // the result view current until it is switched off
+    const QString currentPath = sizeModel->filePath(treeView->rootIndex());
+    ScanJob *job = fileManager->watchDuplicatesAsync(currentPath);
+    watchJob = job;
+    setupDuplicatesUI();
+
+    duplicatesModel->clear();
+    onDuplicatesFound(QList<QStringList>());
+    connect(job, &ScanJob::duplicatesFound, this, &MainWindow::onDuplicatesFound);
+    connect(job, &ScanJob::duplicatesChanged, this, &MainWindow::onDuplicatesChanged);
+    connect(job, &ScanJob::finished, this, [this, job](bool success, const QString& message) {
+        if (watchJob == job) {
+            // Ended on its own, e.g. the directory could not be watched
+            watchJob = nullptr;
+            const QSignalBlocker blocker(watchAction);
+            watchAction->setChecked(false);
+            if (!success) {
+                statusBar()->showMessage(message);
+            }
         }
+    });
+    connect(job, &ScanJob::finished, job, &QObject::deleteLater);
+    statusBar()->showMessage("Watching " + currentPath + " for changes");
+}
+
+void MainWindow::stopWatching() {
+    ScanJob *job = watchJob;
+    if (!job) {
+        return;
     }
-    
-    if (filesToRemove.isEmpty()) {
+    // Updates still queued from the worker must not reach the next scan's results
+    watchJob = nullptr;
+    disconnect(job, nullptr, this, nullptr);
+    job->cancel();
+    const QSignalBlocker blocker(watchAction);
+    watchAction->setChecked(false);
+}
+
+void MainWindow::onDuplicatesChanged(const QStringList& paths, const QList<QStringList>& groups) {
+    ScanJob *job = qobject_cast<ScanJob *>(sender());
+    ScanStats::Scope timing(job ? &job->stats() : nullptr, ScanStats::Ui);
+    setupDuplicatesUI();
+    duplicatesModel->replaceGroups(paths, groups);
+    onDuplicatesFound(QList<QStringList>());
+    statusBar()->showMessage(QString("%1 duplicate groups, updated %2")
+                             .arg(duplicatesModel->groupCount())
+                             .arg(QTime::currentTime().toString()));
+}
+
+void MainWindow::trackJob(ScanJob *job, const QString& label) {
+    activeJob = job;
+
+    // Owned by the window rather than the stack so the event loop keeps
+    // running and Cancel and Pause reach the worker while the job is in flight
+    JobProgressDialog *progress = new JobProgressDialog(job, label, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setAutoReset(false);
+    progress->setAutoClose(false);
+    progress->setMinimumDuration(300);
+    progress->setAttribute(Qt::WA_DeleteOnClose);
+
+    connect(job, &ScanJob::progressUpdated, progress, [progress](int value, int total) {
+        progress->setMaximum(total);
+        if (total > 0) {
+            progress->setValue(value);
+        }
+    });
+    connect(job, &ScanJob::statsUpdated, this, [this](const ScanStats::Snapshot& stats) {
+        statusBar()->showMessage(stats.summary());
+    });
+    connect(job, &ScanJob::finished, this, [this, job, progress]() {
+        progress->close();
+        if (job->stats().isTracing()) {
+            job->stats().writeChromeTrace(qEnvironmentVariable("FILEMANAGER_TRACE"));
+        }
+        if (activeJob == job) {
+            activeJob = nullptr;
+        }
+        job->deleteLater();
+    });
+}
+
+void MainWindow::onDuplicatesFound(const QList<QStringList>& groups) {
+    ScanJob *job = qobject_cast<ScanJob *>(sender());
+    ScanStats::Scope timing(job && !groups.isEmpty() ? &job->stats() : nullptr, ScanStats::Ui);
+    setupDuplicatesUI();
+    duplicatesModel->appendGroups(groups);
+
+    const bool empty = duplicatesModel->groupCount() == 0;
+    duplicatesView->setHidden(empty);
+    removeDuplicatesButton->setHidden(empty);
+}
+
+void MainWindow::onRemoveDuplicates() {
+    if (activeJob) {
+        return;
+    }
+
+    const QList<DuplicateRemover::Group> groups = duplicatesModel->checkedGroups();
+    int fileCount = 0;
+    for (const DuplicateRemover::Group& group : groups) {
+        fileCount += group.duplicates.size();
+    }
+
+    if (fileCount == 0) {
         QMessageBox::warning(this, "No Selection", "Please select files to remove");
         return;
     }
-    
-    if (QMessageBox::question(this, "Confirm Deletion",
-                            QString("Are you sure you want to remove %1 files?")
-                            .arg(filesToRemove.size())) == QMessageBox::Yes) {
-        fileManager->removeDuplicates(filesToRemove);
+
+    const QStringList modes = {"Delete", "Replace with hard links", "Replace with reflinks (btrfs, XFS)"};
+    bool ok;
+    const QString choice = QInputDialog::getItem(this, "Remove Duplicates",
+                                                 QString("Reclaim the space of %1 files by:").arg(fileCount),
+                                                 modes, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+    const DuplicateRemover::Mode mode = DuplicateRemover::Mode(modes.indexOf(choice));
+
+    if (mode == DuplicateRemover::Mode::Delete
+        && QMessageBox::question(this, "Confirm Deletion",
+                                 QString("Are you sure you want to remove %1 files?")
+                                 .arg(fileCount)) != QMessageBox::Yes) {
+        return;
     }
+
+    fileManager->setRemovalMode(mode);
+    ScanJob *job = fileManager->removeDuplicatesAsync(groups);
+    trackJob(job, "Removing duplicates...");
+
+    connect(job, &ScanJob::finished, this, [this](bool success, const QString& message) {
+        if (success) {
+            QMessageBox::information(this, "Success", message);
+        } else {
+            QMessageBox::warning(this, "Operation Complete", message);
+        }
+        // A running watch picks up the changes itself; otherwise rescanning
+        // is cheap now that the digests are cached
+        if (!watchJob) {
+            onFindDuplicates();
+        }
+    });
 }
 
 void MainWindow::onDirectorySelected() {
@@ -266,7 +512,10 @@ void MainWindow::onDirectorySelected() {
                                                   QDir::homePath(),
                                                   QFileDialog::ShowDirsOnly);
     if (!dir.isEmpty()) {
-        treeView->setRootIndex(fileModel->index(dir));
+        stopWatching();
+        setRootPath(dir);
+        // Reopened here next time
+        QSettings(sessionPath(), QSettings::IniFormat).setValue("root", dir);
         statusBar()->showMessage("Directory changed: " + dir);
     }
 }
@@ -274,7 +523,7 @@ void MainWindow::onDirectorySelected() {
 void MainWindow::onSelectionChanged() {
     QModelIndexList selection = treeView->selectionModel()->selectedIndexes();
     if (!selection.isEmpty()) {
-        QString path = fileModel->filePath(selection.first());
+        QString path = sizeModel->filePath(selection.first());
         QFileInfo fileInfo(path);
         
         detailsLabel->setText(QString("Name: %1\nSize: %2 bytes\nModified: %3")
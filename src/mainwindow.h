@@ -8,16 +8,20 @@
 #include <QToolBar>
 #include <QMenu>
 #include "filemanager.h"
-#include "fileanalyzer.h"
-#include <QListWidget>
 #include <QPushButton>
 #include <QSplitter>
+#include <QPointer>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
 class FileManager;  // Forward declaration
+class ScanJob;
+class DuplicateResultModel;
+class DirectorySizeScanner;
+class DirectorySizeModel;
+class QVBoxLayout;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -26,6 +30,13 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+signals:
+    // The file model is rooted and the last results are shown
+    void startupFinished();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private slots:
     void onBatchRename();
     void onAnalyzeContent();
@@ -33,13 +44,17 @@ private slots:
     void onDirectorySelected();
     void onSelectionChanged();
     void onFindDuplicates();
-    void onDuplicatesFound(const QStringList& duplicates);
+    void onFindSimilar();
+    void onDuplicatesFound(const QList<QStringList>& groups);
+    void onWatchToggled(bool enabled);
+    void onDuplicatesChanged(const QStringList& paths, const QList<QStringList>& groups);
 
 private:
     Ui::MainWindow *ui;
-    QFileSystemModel *fileModel;
+    QFileSystemModel *fileModel = nullptr;
     FileManager *fileManager;  // Fixed pointer declaration
-    FileAnalyzer *fileAnalyzer;
+    DirectorySizeScanner *directorySizes;
+    DirectorySizeModel *sizeModel;
     QTreeView *treeView;
     QLabel *detailsLabel;
     QToolBar *toolbar;
@@ -48,16 +63,32 @@ private:
     QAction *selectDirAction;
     QAction *batchRenameAction;
     QAction *findDuplicatesAction;
+    QAction *findSimilarAction;
     QAction *analyzeContentAction;
+    QAction *watchAction;
     
-    QListWidget* duplicatesList;
-    QPushButton* removeDuplicatesButton;
+    DuplicateResultModel* duplicatesModel = nullptr;
+    QTreeView* duplicatesView = nullptr;
+    QPushButton* removeDuplicatesButton = nullptr;
+    QVBoxLayout* resultsLayout;
     QSplitter* mainSplitter;
+    QPointer<ScanJob> activeJob;
+    QPointer<ScanJob> watchJob;
     
     void setupUI();
     void setupConnections();
     void setupDarkTheme();
     void setupDuplicatesUI();
+    void finishStartup();
+    void setRootPath(const QString& path);
+    void setActionsEnabled(bool enabled);
+    void trackJob(ScanJob *job, const QString& label);
+    void showDuplicateResults(ScanJob *job, const QString& label);
+    void showLastResults();
+    void stopWatching();
+
+    bool started = false;
+    QString rootPath;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,185 @@
+#include "metadataindex.h"
+#include <QHashFunctions>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace {
+
+inline quint64 mix(quint64 key, quint64 value) {
+    key = (key ^ value) * 0x9E3779B97F4A7C15ULL;
+    return key ^ (key >> 32);
+}
+
+} // namespace
+
+void MetadataIndex::reserve(int rows) {
+    sizes.reserve(rows);
+    mtimes.reserve(rows);
+    nameHashes.reserve(rows);
+    extensionHashes.reserve(rows);
+    directoryIds.reserve(rows);
+    nameOffsets.reserve(rows);
+}
+
+void MetadataIndex::clear() {
+    sizes.clear();
+    mtimes.clear();
+    nameHashes.clear();
+    extensionHashes.clear();
+    directoryIds.clear();
+    nameOffsets.clear();
+    names.clear();
+    directories.clear();
+    directoryIndex.clear();
+}
+
+void MetadataIndex::append(const QString& path, qint64 size, qint64 mtimeNs) {
+    const int slash = path.lastIndexOf('/');
+    const QString directory = path.left(qMax(slash, 0));
+    const QByteArray name = path.mid(slash + 1).toUtf8();
+
+    // A walk returns to a directory after its subdirectories, so every
+    // directory is looked up rather than compared with the previous one
+    auto id = directoryIndex.constFind(directory);
+    if (id == directoryIndex.cend()) {
+        id = directoryIndex.insert(directory, quint32(directories.size()));
+        directories.append(directory);
+    }
+
+    const int dot = name.lastIndexOf('.');
+    const QByteArray extension = dot > 0 ? name.mid(dot + 1).toLower() : QByteArray();
+
+    sizes.append(size);
+    mtimes.append(mtimeNs / 1000000000);
+    nameHashes.append(quint64(qHash(name, 0)));
+    extensionHashes.append(quint32(qHash(extension, 0)));
+    directoryIds.append(id.value());
+    nameOffsets.append(names.size());
+    names.append(name);
+    names.append('\0');
+}
+
+int MetadataIndex::size() const {
+    return sizes.size();
+}
+
+QString MetadataIndex::path(int row) const {
+    return directories[int(directoryIds[row])] + '/' + QString::fromUtf8(nameAt(row));
+}
+
+qint64 MetadataIndex::fileSize(int row) const {
+    return sizes[row];
+}
+
+qint64 MetadataIndex::modifiedTime(int row) const {
+    return mtimes[row];
+}
+
+QList<QVector<int>> MetadataIndex::findGroups(Keys keys) const {
+    QList<QVector<int>> groups;
+    if (!keys) {
+        return groups;
+    }
+
+    std::vector<std::pair<quint64, int>> keyed;
+    keyed.reserve(size_t(size()));
+    for (int row = 0; row < size(); ++row) {
+        quint64 key = 0;
+        if (keys & Size) {
+            key = mix(key, quint64(sizes[row]));
+        }
+        if (keys & ModifiedTime) {
+            key = mix(key, quint64(mtimes[row]));
+        }
+        if (keys & Name) {
+            key = mix(key, nameHashes[row]);
+        }
+        if (keys & Extension) {
+            key = mix(key, extensionHashes[row]);
+        }
+        keyed.emplace_back(key, row);
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    size_t runStart = 0;
+    while (runStart < keyed.size()) {
+        size_t runEnd = runStart + 1;
+        while (runEnd < keyed.size() && keyed[runEnd].first == keyed[runStart].first) {
+            ++runEnd;
+        }
+
+        if (runEnd - runStart > 1) {
+            // Equal keys almost always mean equal metadata, but a hash
+            // collision must not merge unrelated files
+            QList<QVector<int>> parts;
+            for (size_t i = runStart; i < runEnd; ++i) {
+                const int row = keyed[i].second;
+                bool placed = false;
+                for (QVector<int>& part : parts) {
+                    if (sameMetadata(part.first(), row, keys)) {
+                        part.append(row);
+                        placed = true;
+                        break;
+                    }
+                }
+                if (!placed) {
+                    parts.append(QVector<int>{row});
+                }
+            }
+            for (const QVector<int>& part : std::as_const(parts)) {
+                if (part.size() > 1) {
+                    groups.append(part);
+                }
+            }
+        }
+        runStart = runEnd;
+    }
+    return groups;
+}
+
+qint64 MetadataIndex::memoryUsage() const {
+    qint64 bytes = qint64(sizes.capacity()) * sizeof(qint64)
+        + qint64(mtimes.capacity()) * sizeof(qint64)
+        + qint64(nameHashes.capacity()) * sizeof(quint64)
+        + qint64(extensionHashes.capacity()) * sizeof(quint32)
+        + qint64(directoryIds.capacity()) * sizeof(quint32)
+        + qint64(nameOffsets.capacity()) * sizeof(qint64)
+        + names.capacity();
+    for (const QString& directory : directories) {
+        bytes += directory.capacity() * sizeof(QChar);
+    }
+    // Hash nodes only; their keys share the strings counted above
+    bytes += qint64(directoryIndex.capacity()) * qint64(sizeof(QString) + sizeof(quint32));
+    return bytes;
+}
+
+bool MetadataIndex::sameMetadata(int a, int b, Keys keys) const {
+    if ((keys & Size) && sizes[a] != sizes[b]) {
+        return false;
+    }
+    if ((keys & ModifiedTime) && mtimes[a] != mtimes[b]) {
+        return false;
+    }
+    if ((keys & Name) && std::strcmp(names.constData() + nameOffsets[a],
+                                     names.constData() + nameOffsets[b]) != 0) {
+        return false;
+    }
+    if (keys & Extension) {
+        const QByteArray nameA = nameAt(a);
+        const QByteArray nameB = nameAt(b);
+        const int dotA = nameA.lastIndexOf('.');
+        const int dotB = nameB.lastIndexOf('.');
+        const QByteArray extA = dotA > 0 ? nameA.mid(dotA + 1).toLower() : QByteArray();
+        const QByteArray extB = dotB > 0 ? nameB.mid(dotB + 1).toLower() : QByteArray();
+        if (extA != extB) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QByteArray MetadataIndex::nameAt(int row) const {
+    return QByteArray(names.constData() + nameOffsets[row]);
+}
@@ -0,0 +1,56 @@
+#ifndef METADATAINDEX_H
+#define METADATAINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Column-oriented table of file metadata filled from a single stat pass.
+// Each column is a flat array indexed by row; file names live in one shared
+// byte arena and directories are interned, so an entry costs roughly 40
+// bytes plus its name. Groups are found by hashing the selected columns into
+// one 64-bit key per row, sorting the keys and verifying each run exactly.
+class MetadataIndex {
+public:
+    enum Key {
+        Size = 0x1,
+        ModifiedTime = 0x2,
+        Name = 0x4,
+        Extension = 0x8
+    };
+    Q_DECLARE_FLAGS(Keys, Key)
+
+    void reserve(int rows);
+    void clear();
+    void append(const QString& path, qint64 size, qint64 mtimeNs);
+
+    int size() const;
+    QString path(int row) const;
+    qint64 fileSize(int row) const;
+    qint64 modifiedTime(int row) const;
+
+    QList<QVector<int>> findGroups(Keys keys) const;
+    qint64 memoryUsage() const;
+
+private:
+    bool sameMetadata(int a, int b, Keys keys) const;
+    QByteArray nameAt(int row) const;
+
+    QVector<qint64> sizes;
+    QVector<qint64> mtimes;         // whole seconds, copies rarely keep sub-second precision
+    QVector<quint64> nameHashes;
+    QVector<quint32> extensionHashes;
+    QVector<quint32> directoryIds;
+    QVector<qint64> nameOffsets;
+    QByteArray names;               // UTF-8, NUL separated
+
+    QStringList directories;
+    QHash<QString, quint32> directoryIndex;     // shares the strings of directories
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(MetadataIndex::Keys)
+
+#endif // METADATAINDEX_H
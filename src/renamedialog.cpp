@@ -0,0 +1,116 @@
+#include "renamedialog.h"
+#include <QDialogButtonBox>
+#include <QFileInfo>
+#include <QFormLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+RenameDialog::RenameDialog(const QStringList& files, QWidget *parent)
+    : QDialog(parent)
+    , files(files)
+    , compiled(QString())
+    , patternEdit(new QLineEdit("file_%n", this))
+    , matchEdit(new QLineEdit(this))
+    , statusLabel(new QLabel(this))
+    , previewList(new QTreeWidget(this))
+    , buttons(new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this))
+{
+    setWindowTitle("Batch Rename");
+    matchEdit->setPlaceholderText("optional, e.g. IMG_(\\d+)");
+
+    QFormLayout *form = new QFormLayout;
+    form->addRow("Pattern:", patternEdit);
+    form->addRow("Match:", matchEdit);
+
+    previewList->setColumnCount(2);
+    previewList->setHeaderLabels({"Current name", "New name"});
+    previewList->setRootIsDecorated(false);
+    previewList->setUniformRowHeights(true);
+    previewList->header()->setSectionResizeMode(QHeaderView::Stretch);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(form);
+    layout->addWidget(new QLabel(RenamePattern::syntaxHelp(), this));
+    layout->addWidget(previewList);
+    layout->addWidget(statusLabel);
+    layout->addWidget(buttons);
+    resize(640, 560);
+
+    // One worker, so an abandoned preview is done before the next starts
+    previewPool.setMaxThreadCount(1);
+    connect(this, &RenameDialog::previewReady, this, &RenameDialog::showPreview);
+    connect(patternEdit, &QLineEdit::textChanged, this, &RenameDialog::restartPreview);
+    connect(matchEdit, &QLineEdit::textChanged, this, &RenameDialog::restartPreview);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    restartPreview();
+}
+
+RenameDialog::~RenameDialog() {
+    ++generation;
+    previewPool.waitForDone();
+}
+
+QString RenameDialog::pattern() const {
+    return patternEdit->text();
+}
+
+QString RenameDialog::match() const {
+    return matchEdit->text();
+}
+
+void RenameDialog::restartPreview() {
+    const int run = ++generation;
+    previewList->clear();
+
+    compiled = RenamePattern(patternEdit->text(), matchEdit->text());
+    const bool valid = compiled.isValid() && !patternEdit->text().isEmpty();
+    buttons->button(QDialogButtonBox::Ok)->setEnabled(valid);
+    if (!valid) {
+        statusLabel->setText(compiled.errorString());
+        return;
+    }
+    statusLabel->setText(files.size() > PreviewRows
+        ? QString("Showing the first %1 of %2 files").arg(PreviewRows).arg(files.size())
+        : QString("%1 files").arg(files.size()));
+
+    const RenamePattern pattern = compiled;
+    const QStringList shown = files.mid(0, PreviewRows);
+    previewPool.start([this, run, pattern, shown]() {
+        QStringList names;
+        QStringList targets;
+        QStringList errors;
+        for (int i = 0; i < shown.size() && generation.load() == run; ++i) {
+            QString why;
+            names.append(QFileInfo(shown[i]).fileName());
+            targets.append(pattern.targetName(shown[i], i, &why));
+            errors.append(why);
+            if (names.size() == PreviewBatch || i + 1 == shown.size()) {
+                emit previewReady(run, names, targets, errors);
+                names.clear();
+                targets.clear();
+                errors.clear();
+            }
+        }
+    });
+}
+
+void RenameDialog::showPreview(int run, const QStringList& names, const QStringList& targets,
+                               const QStringList& errors) {
+    // Rows of a pattern that has since been edited
+    if (run != generation.load()) {
+        return;
+    }
+    for (int i = 0; i < names.size(); ++i) {
+        QTreeWidgetItem *item = new QTreeWidgetItem(previewList);
+        item->setText(0, names[i]);
+        item->setText(1, errors[i].isEmpty() ? targets[i] : errors[i]);
+        if (!errors[i].isEmpty()) {
+            item->setForeground(1, Qt::red);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef RENAMEDIALOG_H
+#define RENAMEDIALOG_H
+
+#include <QDialog>
+#include <QStringList>
+#include <QThreadPool>
+#include <atomic>
+#include "renamepattern.h"
+
+class QDialogButtonBox;
+class QLabel;
+class QLineEdit;
+class QTreeWidget;
+
+// Asks for a rename pattern and an optional match expression and shows
+// what the first PreviewRows files would be called. Every edit recompiles
+// the pattern and names those files on a private worker thread, which hands
+// the rows back in batches of PreviewBatch; an edit abandons the names still
+// being worked out. Patterns that read file dates over a slow share
+// therefore never hold up typing, and the size of the selection does not
+// matter.
+class RenameDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit RenameDialog(const QStringList& files, QWidget *parent = nullptr);
+    ~RenameDialog();
+
+    QString pattern() const;
+    QString match() const;
+
+    static constexpr int PreviewRows = 200;
+    static constexpr int PreviewBatch = 20;
+
+signals:
+    // Emitted from the worker thread; an empty target has its reason in errors
+    void previewReady(int generation, const QStringList& names, const QStringList& targets,
+                      const QStringList& errors);
+
+private:
+    void restartPreview();
+    void showPreview(int generation, const QStringList& names, const QStringList& targets,
+                     const QStringList& errors);
+
+    QStringList files;
+    RenamePattern compiled;
+    std::atomic<int> generation{0};
+    QThreadPool previewPool;
+    QLineEdit *patternEdit;
+    QLineEdit *matchEdit;
+    QLabel *statusLabel;
+    QTreeWidget *previewList;
+    QDialogButtonBox *buttons;
+};
+
+#endif // RENAMEDIALOG_H
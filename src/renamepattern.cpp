@@ -0,0 +1,391 @@
+#include "renamepattern.h"
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+#include <cstring>
+
+namespace {
+
+constexpr quint16 DateTimeTag = 0x0132;
+constexpr quint16 ExifIfdTag = 0x8769;
+constexpr quint16 DateTimeOriginalTag = 0x9003;
+constexpr int MaxCounterWidth = 32;
+
+// DateTimeOriginal, or DateTime where that is missing, from a TIFF
+// structure: a TIFF file itself or the block EXIF embeds in a JPEG
+QDateTime tiffDate(const uchar *tiff, qint64 length) {
+    if (length < 8) {
+        return QDateTime();
+    }
+    bool little;
+    if (tiff[0] == 'I' && tiff[1] == 'I') {
+        little = true;
+    } else if (tiff[0] == 'M' && tiff[1] == 'M') {
+        little = false;
+    } else {
+        return QDateTime();
+    }
+    auto u16 = [&](qint64 at) -> quint32 {
+        return little ? qFromLittleEndian<quint16>(tiff + at) : qFromBigEndian<quint16>(tiff + at);
+    };
+    auto u32 = [&](qint64 at) -> quint32 {
+        return little ? qFromLittleEndian<quint32>(tiff + at) : qFromBigEndian<quint32>(tiff + at);
+    };
+    if (u16(2) != 42) {
+        return QDateTime();
+    }
+
+    // Every offset comes from the file, so each one is checked before use
+    auto findTag = [&](qint64 ifd, quint16 tag, quint32& value, quint32& count) {
+        if (ifd + 2 > length) {
+            return false;
+        }
+        const quint32 entries = u16(ifd);
+        for (quint32 i = 0; i < entries; ++i) {
+            const qint64 entry = ifd + 2 + qint64(i) * 12;
+            if (entry + 12 > length) {
+                return false;
+            }
+            if (u16(entry) == tag) {
+                count = u32(entry + 4);
+                value = u32(entry + 8);
+                return true;
+            }
+        }
+        return false;
+    };
+    // "yyyy:MM:dd HH:mm:ss" plus the terminating NUL, always stored out of line
+    auto dateAt = [&](quint32 offset, quint32 count) {
+        if (count < 20 || qint64(offset) + 19 > length) {
+            return QDateTime();
+        }
+        return QDateTime::fromString(QString::fromLatin1(reinterpret_cast<const char *>(tiff + offset), 19),
+                                     "yyyy:MM:dd HH:mm:ss");
+    };
+
+    const qint64 ifd0 = u32(4);
+    quint32 value = 0;
+    quint32 count = 0;
+    if (findTag(ifd0, ExifIfdTag, value, count) && findTag(value, DateTimeOriginalTag, value, count)) {
+        const QDateTime taken = dateAt(value, count);
+        if (taken.isValid()) {
+            return taken;
+        }
+    }
+    if (findTag(ifd0, DateTimeTag, value, count)) {
+        return dateAt(value, count);
+    }
+    return QDateTime();
+}
+
+// Only the head of the file is read; EXIF sits in the first segments
+QDateTime exifDate(const QString& filePath) {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QDateTime();
+    }
+    const QByteArray head = file.read(RenamePattern::ExifScanSize);
+    const auto *data = reinterpret_cast<const uchar *>(head.constData());
+    const qint64 length = head.size();
+    if (length < 4 || data[0] != 0xff || data[1] != 0xd8) {
+        return tiffDate(data, length);
+    }
+
+    // JPEG: walk the marker segments up to the image data
+    qint64 at = 2;
+    while (at + 4 <= length && data[at] == 0xff) {
+        const uchar marker = data[at + 1];
+        const qint64 size = qFromBigEndian<quint16>(data + at + 2);
+        if (marker == 0xda || size < 2) {
+            break;
+        }
+        if (marker == 0xe1 && size >= 8 && at + 10 <= length
+            && std::memcmp(data + at + 4, "Exif\0\0", 6) == 0) {
+            return tiffDate(data + at + 10, qMin(size - 8, length - at - 10));
+        }
+        at += 2 + size;
+    }
+    return QDateTime();
+}
+
+QString counterText(qint64 value, int width) {
+    const QString digits = QString::number(qAbs(value)).rightJustified(width, '0');
+    return value < 0 ? '-' + digits : digits;
+}
+
+QString capitalised(const QString& text) {
+    QString result = text.toLower();
+    bool wordStart = true;
+    for (QChar& c : result) {
+        if (c.isLetterOrNumber()) {
+            if (wordStart) {
+                c = c.toUpper();
+            }
+            wordStart = false;
+        } else {
+            wordStart = true;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+RenamePattern::RenamePattern(const QString& pattern, const QString& match) {
+    if (!match.isEmpty()) {
+        matcher.setPattern(match);
+        if (!matcher.isValid()) {
+            fail("Invalid match expression: " + matcher.errorString());
+            return;
+        }
+        usesMatch = true;
+    }
+    compile(pattern);
+}
+
+void RenamePattern::compile(const QString& pattern) {
+    const QDateTime now = QDateTime::currentDateTime();
+    QVector<Case> groups;
+    QString literal;
+    auto flush = [&]() {
+        if (!literal.isEmpty()) {
+            Instruction instruction;
+            instruction.text = literal;
+            program.append(instruction);
+            literal.clear();
+        }
+    };
+    auto emitOp = [&](Op op) -> Instruction& {
+        flush();
+        Instruction instruction;
+        instruction.op = op;
+        program.append(instruction);
+        return program.last();
+    };
+
+    for (int i = 0; i < pattern.size() && error.isEmpty(); ++i) {
+        const QChar c = pattern[i];
+        if (c == '}' && !groups.isEmpty()) {
+            emitOp(Op::EndCase).start = qint64(groups.takeLast());
+            continue;
+        }
+        if (c != '%' || i + 1 == pattern.size()) {
+            literal += c;
+            continue;
+        }
+
+        const QChar token = pattern[++i];
+        QString argument;
+        switch (token.unicode()) {
+        case '%':
+        case '}':
+            literal += token;
+            break;
+        case 'n': {
+            Instruction& counter = emitOp(Op::Counter);
+            if (!parseArgument(pattern, i, argument)) {
+                break;
+            }
+            const QStringList parts = argument.split(',');
+            bool ok = parts.size() <= 3;
+            qint64 values[3] = {counter.start, counter.step, counter.width};
+            for (int part = 0; ok && part < parts.size(); ++part) {
+                if (!parts[part].trimmed().isEmpty()) {
+                    values[part] = parts[part].trimmed().toLongLong(&ok);
+                }
+            }
+            if (!ok || values[2] < 1 || values[2] > MaxCounterWidth) {
+                fail("Invalid counter %n{" + argument + "}, expected %n{start,step,width}");
+                break;
+            }
+            counter.start = values[0];
+            counter.step = values[1];
+            counter.width = int(values[2]);
+            break;
+        }
+        case 'd':
+        case 'm':
+        case 't': {
+            const bool custom = parseArgument(pattern, i, argument);
+            const QString format = custom ? argument : QString("yyyyMMdd");
+            if (!error.isEmpty()) {
+                break;
+            }
+            if (token == 'd') {
+                // Today is the same for every file, so it is folded in here
+                literal += now.toString(format);
+                break;
+            }
+            emitOp(token == 'm' ? Op::Modified : Op::Taken).text = format;
+            usesDates = true;
+            break;
+        }
+        case 'o':
+            emitOp(Op::BaseName);
+            break;
+        case 'e':
+            emitOp(Op::Suffix);
+            break;
+        case 'u':
+        case 'l':
+        case 'c':
+            if (i + 1 >= pattern.size() || pattern[i + 1] != '{') {
+                fail(QString("%%1 needs a group, e.g. %%1{%o}").arg(token));
+                break;
+            }
+            ++i;
+            groups.append(token == 'u' ? Case::Upper : token == 'l' ? Case::Lower : Case::Words);
+            emitOp(Op::BeginCase);
+            break;
+        default:
+            if (token.isDigit()) {
+                const int capture = token.digitValue();
+                if (!usesMatch) {
+                    fail(QString("%%1 needs a match expression").arg(capture));
+                } else if (capture > matcher.captureCount()) {
+                    fail(QString("The match expression has no capture group %1").arg(capture));
+                } else {
+                    emitOp(Op::Capture).start = capture;
+                }
+                break;
+            }
+            // Unknown tokens stay as they are
+            literal += '%';
+            literal += token;
+            break;
+        }
+    }
+    if (error.isEmpty() && !groups.isEmpty()) {
+        fail("Unclosed case group, missing }");
+    }
+    flush();
+}
+
+bool RenamePattern::parseArgument(const QString& pattern, int& i, QString& argument) {
+    if (i + 1 >= pattern.size() || pattern[i + 1] != '{') {
+        return false;
+    }
+    const int close = pattern.indexOf('}', i + 2);
+    if (close < 0) {
+        fail(QString("Unclosed argument of %%1").arg(pattern[i]));
+        return false;
+    }
+    argument = pattern.mid(i + 2, close - i - 2);
+    i = close;
+    return true;
+}
+
+void RenamePattern::fail(const QString& message) {
+    if (error.isEmpty()) {
+        error = message;
+    }
+}
+
+bool RenamePattern::isValid() const {
+    return error.isEmpty();
+}
+
+QString RenamePattern::errorString() const {
+    return error;
+}
+
+bool RenamePattern::readsFileDates() const {
+    return usesDates;
+}
+
+QString RenamePattern::targetName(const QString& filePath, int index, QString *why) const {
+    if (!error.isEmpty()) {
+        if (why) {
+            *why = error;
+        }
+        return QString();
+    }
+
+    // QFileInfo only stats once a date is asked for
+    const QFileInfo info(filePath);
+    const QString suffix = info.suffix();
+    QRegularExpressionMatch match;
+    if (usesMatch) {
+        match = matcher.match(info.completeBaseName());
+        if (!match.hasMatch()) {
+            if (why) {
+                *why = QString("%1 does not match %2").arg(info.fileName(), matcher.pattern());
+            }
+            return QString();
+        }
+    }
+
+    QDateTime taken;
+    QVector<int> groupStarts;
+    QString name;
+    for (const Instruction& instruction : program) {
+        switch (instruction.op) {
+        case Op::Literal:
+            name += instruction.text;
+            break;
+        case Op::Counter:
+            name += counterText(instruction.start + instruction.step * index, instruction.width);
+            break;
+        case Op::Modified:
+            name += info.lastModified().toString(instruction.text);
+            break;
+        case Op::Taken:
+            if (!taken.isValid()) {
+                taken = exifDate(filePath);
+                if (!taken.isValid()) {
+                    taken = info.lastModified();
+                }
+            }
+            name += taken.toString(instruction.text);
+            break;
+        case Op::BaseName:
+            name += info.completeBaseName();
+            break;
+        case Op::Suffix:
+            name += suffix;
+            break;
+        case Op::Capture:
+            name += match.captured(int(instruction.start));
+            break;
+        case Op::BeginCase:
+            groupStarts.append(name.size());
+            break;
+        case Op::EndCase: {
+            const int from = groupStarts.takeLast();
+            const QString group = name.mid(from);
+            name.truncate(from);
+            switch (Case(instruction.start)) {
+            case Case::Upper: name += group.toUpper(); break;
+            case Case::Lower: name += group.toLower(); break;
+            case Case::Words: name += capitalised(group); break;
+            }
+            break;
+        }
+        }
+    }
+    if (!suffix.isEmpty()) {
+        name += "." + suffix;
+    }
+    return name;
+}
+
+QStringList RenamePattern::preview(const QStringList& files, int count) const {
+    QStringList names;
+    const int total = qMin(count, int(files.size()));
+    names.reserve(total);
+    for (int i = 0; i < total; ++i) {
+        names.append(targetName(files[i], i));
+    }
+    return names;
+}
+
+QString RenamePattern::syntaxHelp() {
+    return "%n - counter (001, 002, ...), %n{start,step,width}\n"
+           "%d - today, %m - modified, %t - date taken (EXIF);\n"
+           "     optional format, e.g. %m{yyyy-MM-dd}\n"
+           "%o - original name without extension, %e - extension\n"
+           "%0 - whole match, %1..%9 - captures of the match expression\n"
+           "%u{...} %l{...} %c{...} - upper, lower, Capitalised\n"
+           "%% - a literal %, %} - a literal } inside %u{...}";
+}
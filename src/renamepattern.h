@@ -0,0 +1,78 @@
+#ifndef RENAMEPATTERN_H
+#define RENAMEPATTERN_H
+
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// A rename pattern compiled once into a flat program of operations, so
+// naming a file is one pass over the program with no parsing. Tokens:
+//
+//   %n  counter, %n{start,step,width} with each part optional (1,1,3)
+//   %d  today, %m  modification time, %t  date taken (EXIF DateTimeOriginal
+//       of JPEG and TIFF files, else the modification time); each takes an
+//       optional QDateTime format, default %d{yyyyMMdd}
+//   %o  original name without its suffix, %e  original suffix
+//   %0  whole match, %1..%9  captures of the match expression, which runs
+//       against the name without its suffix
+//   %u{...} %l{...} %c{...}  upper, lower and capitalised words; they nest
+//   %%  a literal %, %} a literal } inside a case group
+//
+// Unknown tokens are kept literally. File dates are only read by patterns
+// that use them, and then once per file. The original suffix is always kept.
+class RenamePattern {
+public:
+    explicit RenamePattern(const QString& pattern, const QString& match = QString());
+
+    bool isValid() const;
+    QString errorString() const;
+    bool readsFileDates() const;
+
+    // Target file name of filePath as the index-th file of the batch, or an
+    // empty string with error set when the file does not match
+    QString targetName(const QString& filePath, int index, QString *error = nullptr) const;
+    // Target names of the first count files; the cost does not depend on the
+    // length of files, so it can follow every keystroke
+    QStringList preview(const QStringList& files, int count) const;
+
+    static QString syntaxHelp();
+
+    static constexpr int DefaultCounterWidth = 3;
+    static constexpr int ExifScanSize = 64 * 1024;
+
+private:
+    enum class Op {
+        Literal,
+        Counter,
+        Modified,
+        Taken,
+        BaseName,
+        Suffix,
+        Capture,
+        BeginCase,
+        EndCase
+    };
+
+    enum class Case { Upper, Lower, Words };
+
+    struct Instruction {
+        Op op = Op::Literal;
+        QString text;       // literal text or date format
+        qint64 start = 1;   // counter start, capture number or Case
+        qint64 step = 1;
+        int width = DefaultCounterWidth;
+    };
+
+    void compile(const QString& pattern);
+    bool parseArgument(const QString& pattern, int& i, QString& argument);
+    void fail(const QString& message);
+
+    QVector<Instruction> program;
+    QRegularExpression matcher;
+    bool usesMatch = false;
+    bool usesDates = false;
+    QString error;
+};
+
+#endif // RENAMEPATTERN_H
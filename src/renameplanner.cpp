@@ -0,0 +1,424 @@
+#include "renameplanner.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <atomic>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+#endif
+
+namespace {
+
+#ifdef Q_OS_LINUX
+
+// One descriptor per directory so every rename is a single renameat2 call
+class DirectoryHandles {
+public:
+    explicit DirectoryHandles(const QStringList& directories) {
+        fds.reserve(directories.size());
+        for (const QString& directory : directories) {
+            fds.append(::open(QFile::encodeName(directory).constData(),
+                              O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+        }
+    }
+
+    ~DirectoryHandles() {
+        for (int fd : std::as_const(fds)) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+
+    int fd(int directory) const { return fds[directory]; }
+
+private:
+    QVector<int> fds;
+};
+
+std::atomic<bool> noReplaceUnsupported{false};
+
+int renameNoReplace(int dirfd, const char *from, const char *to) {
+    if (dirfd < 0) {
+        return ENOENT;
+    }
+    if (!noReplaceUnsupported.load(std::memory_order_relaxed)) {
+        if (::syscall(SYS_renameat2, dirfd, from, dirfd, to, RENAME_NOREPLACE) == 0) {
+            return 0;
+        }
+        if (errno != EINVAL && errno != ENOSYS) {
+            return errno;
+        }
+        noReplaceUnsupported.store(true, std::memory_order_relaxed);
+    }
+
+    // Filesystems without RENAME_NOREPLACE: check first, the window is small
+    struct stat st;
+    if (::fstatat(dirfd, to, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+        return EEXIST;
+    }
+    return ::renameat(dirfd, from, dirfd, to) == 0 ? 0 : errno;
+}
+
+#else
+
+class DirectoryHandles {
+public:
+    explicit DirectoryHandles(const QStringList& directories) : directories(directories) {}
+    const QString& directory(int index) const { return directories[index]; }
+
+private:
+    QStringList directories;
+};
+
+#endif
+
+} // namespace
+
+RenamePlanner::RenamePlanner(const QString& pattern, const Checkpoint& checkpoint)
+    : RenamePlanner(RenamePattern(pattern), checkpoint)
+{
+}
+
+RenamePlanner::RenamePlanner(const RenamePattern& pattern, const Checkpoint& checkpoint)
+    : pattern(pattern)
+    , checkpoint(checkpoint)
+    , threads(QThread::idealThreadCount())
+{
+}
+
+QString RenamePlanner::targetName(const QString& filePath, int index) const {
+    return pattern.targetName(filePath, index);
+}
+
+bool RenamePlanner::plan(const QStringList& files) {
+    plannedMoves.clear();
+    errorList.clear();
+    cancelled = false;
+    if (!pattern.isValid()) {
+        errorList << "Invalid pattern: " + pattern.errorString();
+        buildPhases();
+        return false;
+    }
+
+    QVector<Move> candidates;
+    QHash<QString, int> bySource;
+    QHash<QString, int> byTarget;
+    candidates.reserve(files.size());
+    bySource.reserve(files.size());
+    byTarget.reserve(files.size());
+
+    for (int i = 0; i < files.size(); ++i) {
+        const QFileInfo info(files[i]);
+        if (!info.exists()) {
+            errorList << QString("File not found: %1").arg(files[i]);
+            continue;
+        }
+
+        QString why;
+        const QString name = pattern.targetName(files[i], i, &why);
+        if (!why.isEmpty()) {
+            errorList << why;
+            continue;
+        }
+        if (name.isEmpty() || name == "." || name == ".." || name.contains('/')) {
+            errorList << QString("Invalid target name for %1: %2").arg(files[i], name);
+            continue;
+        }
+
+        Move move;
+        move.index = i;
+        move.source = info.absoluteFilePath();
+        move.target = info.absolutePath() + '/' + name;
+        if (bySource.contains(move.source)) {
+            errorList << QString("File listed more than once: %1").arg(files[i]);
+            continue;
+        }
+        if (move.target == move.source) {
+            // Already has its new name; it still occupies that name below
+            continue;
+        }
+        const auto clash = byTarget.constFind(move.target);
+        if (clash != byTarget.cend()) {
+            errorList << QString("Target %1 of %2 is also the target of %3")
+                .arg(move.target, files[i], candidates[*clash].source);
+            continue;
+        }
+
+        bySource.insert(move.source, candidates.size());
+        byTarget.insert(move.target, candidates.size());
+        candidates.append(move);
+    }
+
+    QVector<char> dropped(candidates.size(), 0);
+    auto drop = [&](int index, const QString& reason) {
+        dropped[index] = 1;
+        errorList << reason;
+        // That file keeps its name, so a move that wanted the name fails too
+        for (int next = byTarget.value(candidates[index].source, -1);
+             next >= 0 && !dropped[next];
+             next = byTarget.value(candidates[next].source, -1)) {
+            dropped[next] = 1;
+            errorList << QString("Target file already exists: %1").arg(candidates[next].target);
+        }
+    };
+
+    // Targets must be free unless another move in this batch vacates them
+    for (int i = 0; i < candidates.size(); ++i) {
+        if (!dropped[i] && !bySource.contains(candidates[i].target)
+            && (QFileInfo::exists(candidates[i].target) || QFileInfo(candidates[i].target).isSymLink())) {
+            drop(i, QString("Target file already exists: %1").arg(candidates[i].target));
+        }
+    }
+
+    plannedMoves.reserve(candidates.size());
+    for (int i = 0; i < candidates.size(); ++i) {
+        if (!dropped[i]) {
+            plannedMoves.append(candidates[i]);
+        }
+    }
+    buildPhases();
+    return errorList.isEmpty();
+}
+
+void RenamePlanner::buildPhases() {
+    directories.clear();
+    moveAside = Phase();
+    moveIntoPlace = Phase();
+
+    QSet<QString> targets;
+    targets.reserve(plannedMoves.size());
+    for (const Move& move : std::as_const(plannedMoves)) {
+        targets.insert(move.target);
+    }
+
+    // Anything another move wants to take over steps aside first. That
+    // breaks cycles and lets both phases run without ordering constraints.
+    const QString token = QString::number(QRandomGenerator::global()->generate64(), 16);
+    QHash<QString, int> directoryIds;
+    for (Move& move : plannedMoves) {
+        const QFileInfo info(move.source);
+        const QString directory = info.absolutePath();
+        auto id = directoryIds.constFind(directory);
+        if (id == directoryIds.cend()) {
+            id = directoryIds.insert(directory, directories.size());
+            directories.append(directory);
+        }
+
+        const QByteArray sourceName = QFile::encodeName(info.fileName());
+        const QByteArray targetName = QFile::encodeName(QFileInfo(move.target).fileName());
+        if (targets.contains(move.source)) {
+            const QString temporaryName = QString(".%1-%2.rename").arg(token).arg(move.index);
+            move.temporary = directory + '/' + temporaryName;
+            const QByteArray encoded = QFile::encodeName(temporaryName);
+            moveAside.steps.append({*id, sourceName, encoded});
+            moveIntoPlace.steps.append({*id, encoded, targetName});
+        } else {
+            moveIntoPlace.steps.append({*id, sourceName, targetName});
+        }
+    }
+    moveAside.done.fill(0, moveAside.steps.size());
+    moveIntoPlace.done.fill(0, moveIntoPlace.steps.size());
+}
+
+const QVector<RenamePlanner::Move>& RenamePlanner::moves() const {
+    return plannedMoves;
+}
+
+bool RenamePlanner::execute(const Progress& progress) {
+    cancelled = false;
+    const int total = moveAside.steps.size() + moveIntoPlace.steps.size();
+    int completed = 0;
+    if (runPhase(moveAside, completed, total, progress)
+        && runPhase(moveIntoPlace, completed, total, progress)) {
+        return true;
+    }
+
+    if (rollback()) {
+        errorList << (cancelled ? QString("Cancelled, renamed files were restored")
+                                : QString("All renamed files were restored"));
+    } else if (cancelled) {
+        errorList << "Cancelled";
+    }
+    return false;
+}
+
+bool RenamePlanner::runPhase(Phase& phase, int& completed, int total, const Progress& progress) {
+    const int count = phase.steps.size();
+    if (count == 0) {
+        return true;
+    }
+
+    const DirectoryHandles handles(directories);
+    const Step *steps = phase.steps.constData();
+    char *done = phase.done.data();
+    QVector<int> failures(count, 0);
+    int *failure = failures.data();
+
+    std::atomic<int> nextBatch{0};
+    std::atomic<int> finished{0};
+    std::atomic<bool> stop{false};
+    std::atomic<bool> stopped{false};
+    const int batches = (count + RenameBatch - 1) / RenameBatch;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMin(threads, batches));
+    for (int worker = 0; worker < pool.maxThreadCount(); ++worker) {
+        pool.start([&]() {
+            while (!stop.load(std::memory_order_relaxed)) {
+                const int batch = nextBatch.fetch_add(1);
+                if (batch >= batches) {
+                    return;
+                }
+                if (checkpoint && !checkpoint()) {
+                    stopped = true;
+                    stop = true;
+                    return;
+                }
+
+                const int end = qMin(count, (batch + 1) * RenameBatch);
+                for (int i = batch * RenameBatch; i < end; ++i) {
+#ifdef Q_OS_LINUX
+                    const int error = renameNoReplace(handles.fd(steps[i].directory),
+                                                      steps[i].from.constData(), steps[i].to.constData());
+#else
+                    const QString directory = handles.directory(steps[i].directory) + '/';
+                    const QString to = directory + QFile::decodeName(steps[i].to);
+                    const int error = (!QFileInfo::exists(to)
+                        && QFile::rename(directory + QFile::decodeName(steps[i].from), to)) ? 0 : 1;
+#endif
+                    if (error != 0) {
+                        failure[i] = error;
+                        stop = true;
+                        break;
+                    }
+                    done[i] = 1;
+                    finished.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+
+    // Progress goes out from this thread only, like HashEngine::finish()
+    int reported = -1;
+    while (!pool.waitForDone(50)) {
+        const int current = finished.load(std::memory_order_relaxed);
+        if (progress && current != reported) {
+            reported = current;
+            progress(completed + current, total);
+        }
+    }
+    completed += finished.load();
+    if (progress) {
+        progress(completed, total);
+    }
+
+    cancelled = stopped.load();
+    for (int i = 0; i < count; ++i) {
+        if (failure[i] != 0) {
+            errorList << QString("Failed to rename %1/%2: %3")
+                .arg(directories[steps[i].directory], QFile::decodeName(steps[i].from),
+#ifdef Q_OS_LINUX
+                     qt_error_string(failure[i]));
+#else
+                     QString("target exists or rename failed"));
+#endif
+        }
+    }
+    return !stop.load();
+}
+
+bool RenamePlanner::rollback() {
+    // Moves into place are undone first so the temporary names are back
+    const bool placed = undoPhase(moveIntoPlace);
+    const bool aside = undoPhase(moveAside);
+    return placed && aside;
+}
+
+bool RenamePlanner::undoPhase(Phase& phase) {
+    Phase undo;
+    QVector<int> origin;
+    for (int i = phase.steps.size() - 1; i >= 0; --i) {
+        if (phase.done[i]) {
+            const Step& step = phase.steps[i];
+            undo.steps.append({step.directory, step.to, step.from});
+            origin.append(i);
+        }
+    }
+    undo.done.fill(0, undo.steps.size());
+    if (undo.steps.isEmpty()) {
+        return true;
+    }
+
+    // Restoring must not be interrupted by the checkpoint that caused it
+    const Checkpoint saved = checkpoint;
+    const bool wasStopped = cancelled;
+    checkpoint = Checkpoint();
+    int completed = 0;
+    bool restored = runPhase(undo, completed, undo.steps.size(), Progress());
+    checkpoint = saved;
+    cancelled = wasStopped;
+
+    // Whatever could not be restored in parallel gets a second sequential try
+    if (!restored) {
+        restored = true;
+        const DirectoryHandles handles(directories);
+        for (int i = 0; i < undo.steps.size(); ++i) {
+            if (undo.done[i]) {
+                continue;
+            }
+            const Step& step = undo.steps[i];
+#ifdef Q_OS_LINUX
+            const bool ok = renameNoReplace(handles.fd(step.directory), step.from.constData(),
+                                            step.to.constData()) == 0;
+#else
+            const QString directory = handles.directory(step.directory) + '/';
+            const bool ok = QFile::rename(directory + QFile::decodeName(step.from),
+                                          directory + QFile::decodeName(step.to));
+#endif
+            if (ok) {
+                undo.done[i] = 1;
+            } else {
+                restored = false;
+                errorList << QString("Could not restore %1/%2")
+                    .arg(directories[step.directory], QFile::decodeName(step.to));
+            }
+        }
+    }
+
+    for (int i = 0; i < undo.steps.size(); ++i) {
+        if (undo.done[i]) {
+            phase.done[origin[i]] = 0;
+        }
+    }
+    return restored;
+}
+
+void RenamePlanner::setThreadCount(int count) {
+    threads = qMax(1, count);
+}
+
+int RenamePlanner::threadCount() const {
+    return threads;
+}
+
+QStringList RenamePlanner::errors() const {
+    return errorList;
+}
+
+bool RenamePlanner::wasCancelled() const {
+    return cancelled;
+}
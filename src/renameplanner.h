@@ -0,0 +1,79 @@
+#ifndef RENAMEPLANNER_H
+#define RENAMEPLANNER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+#include "renamepattern.h"
+
+// Plans and applies a batch rename as one transaction. The pattern is
+// compiled once into a RenamePattern, every target name is computed and
+// validated before the first rename, and files whose target is another
+// file's current name are first moved aside to a temporary name so chains
+// and cycles (a->b, b->a) resolve. Each rename is a single
+// renameat2(RENAME_NOREPLACE) inside the file's directory and never
+// replaces an existing file; the work runs in parallel batches and is
+// undone if any rename fails or the job is cancelled.
+class RenamePlanner {
+public:
+    using Checkpoint = std::function<bool()>;
+    using Progress = std::function<void(int done, int total)>;
+
+    struct Move {
+        int index = -1;         // position in the list given to plan()
+        QString source;
+        QString target;
+        QString temporary;      // empty unless the source is another move's target
+    };
+
+    explicit RenamePlanner(const QString& pattern, const Checkpoint& checkpoint = Checkpoint());
+    explicit RenamePlanner(const RenamePattern& pattern, const Checkpoint& checkpoint = Checkpoint());
+
+    QString targetName(const QString& filePath, int index) const;
+
+    // Computes the moves for files; files that cannot be renamed are left
+    // out and reported by errors(). Returns true if every file got a move.
+    bool plan(const QStringList& files);
+    const QVector<Move>& moves() const;
+
+    // Applies the planned moves. Returns false and restores every file that
+    // was already renamed if a rename fails or the checkpoint says stop.
+    bool execute(const Progress& progress = Progress());
+    bool rollback();
+
+    void setThreadCount(int count);
+    int threadCount() const;
+    QStringList errors() const;
+    bool wasCancelled() const;
+
+    static constexpr int RenameBatch = 256;
+
+private:
+    struct Step {
+        int directory = -1;
+        QByteArray from;
+        QByteArray to;
+    };
+
+    struct Phase {
+        QVector<Step> steps;
+        QVector<char> done;
+    };
+
+    void buildPhases();
+    bool runPhase(Phase& phase, int& completed, int total, const Progress& progress);
+    bool undoPhase(Phase& phase);
+
+    RenamePattern pattern;
+    Checkpoint checkpoint;
+    QVector<Move> plannedMoves;
+    QStringList directories;
+    Phase moveAside;
+    Phase moveIntoPlace;
+    QStringList errorList;
+    int threads;
+    bool cancelled = false;
+};
+
+#endif // RENAMEPLANNER_H
@@ -0,0 +1,94 @@
+#include "scanjob.h"
+#include <QThread>
+
+ScanJob::ScanJob(QObject *parent) : QObject(parent) {
+}
+
+ScanJob::~ScanJob() {
+    cancel();
+    wait();
+}
+
+bool ScanJob::isCancelled() const {
+    return cancelled.loadRelaxed();
+}
+
+bool ScanJob::isPaused() const {
+    return paused.loadRelaxed();
+}
+
+bool ScanJob::isFinished() const {
+    return done.loadAcquire();
+}
+
+bool ScanJob::checkpoint() {
+    if (cancelled.loadRelaxed()) {
+        return false;
+    }
+    if (paused.loadRelaxed()) {
+        QMutexLocker locker(&mutex);
+        while (paused.loadRelaxed() && !cancelled.loadRelaxed()) {
+            resumed.wait(&mutex);
+        }
+    }
+    return !cancelled.loadRelaxed();
+}
+
+void ScanJob::reportProgress(int progress, int total) {
+    QMutexLocker locker(&mutex);
+    pendingProgress = progress;
+    pendingTotal = total;
+
+    // Stage boundaries always go through so the receiver sees each total
+    const bool stageDone = total > 0 && progress >= total;
+    if (!stageDone && progressTimer.isValid() && progressTimer.elapsed() < ProgressInterval) {
+        return;
+    }
+    progressTimer.start();
+    pendingProgress = -1;
+    locker.unlock();
+
+    emit progressUpdated(progress, total);
+    emit statsUpdated(scanStats.snapshot());
+}
+
+void ScanJob::finish(bool success, const QString& message) {
+    QMutexLocker locker(&mutex);
+    const int progress = pendingProgress;
+    const int total = pendingTotal;
+    pendingProgress = -1;
+    locker.unlock();
+
+    if (progress >= 0) {
+        emit progressUpdated(progress, total);
+    }
+    emit statsUpdated(scanStats.snapshot());
+    done.storeRelease(1);
+    emit finished(success, message);
+}
+
+ScanStats& ScanJob::stats() {
+    return scanStats;
+}
+
+void ScanJob::cancel() {
+    QMutexLocker locker(&mutex);
+    cancelled.storeRelaxed(1);
+    resumed.wakeAll();
+}
+
+void ScanJob::pause() {
+    paused.storeRelaxed(1);
+}
+
+void ScanJob::resume() {
+    QMutexLocker locker(&mutex);
+    paused.storeRelaxed(0);
+    resumed.wakeAll();
+}
+
+void ScanJob::wait() {
+    if (thread && thread != QThread::currentThread()) {
+        thread->wait();
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef SCANJOB_H
+#define SCANJOB_H
+
+#include <QObject>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QStringList>
+#include <QWaitCondition>
+#include "scanstats.h"
+
+class QThread;
+
+// Handle for a FileManager operation running on a worker thread. Workers
+// call checkpoint() between units of work, which blocks while the job is
+// paused and fails once it is cancelled. Progress reports are coalesced and
+// re-emitted at most every ProgressInterval ms, each time together with a
+// snapshot of the job's ScanStats; all signals are emitted from the worker
+// and reach receivers in other threads as queued connections.
+class ScanJob : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ScanJob(QObject *parent = nullptr);
+    ~ScanJob();
+
+    bool isCancelled() const;
+    bool isPaused() const;
+    bool isFinished() const;
+
+    // Worker side
+    bool checkpoint();
+    void reportProgress(int progress, int total);
+    void finish(bool success, const QString& message);
+    ScanStats& stats();
+
+    static constexpr int ProgressInterval = 50;
+
+public slots:
+    void cancel();
+    void pause();
+    void resume();
+    void wait();
+
+signals:
+    void progressUpdated(int progress, int total);
+    // Emitted in batches while a duplicate scan is still running
+    void duplicatesFound(const QList<QStringList>& groups);
+    // Emitted by watch jobs: groups containing any of paths are replaced by groups
+    void duplicatesChanged(const QStringList& paths, const QList<QStringList>& groups);
+    void statsUpdated(const ScanStats::Snapshot& stats);
+    void finished(bool success, const QString& message);
+
+private:
+    friend class FileManager;
+
+    QThread *thread = nullptr;
+    QAtomicInteger<int> cancelled;
+    QAtomicInteger<int> paused;
+    QAtomicInteger<int> done;
+    ScanStats scanStats;
+
+    QMutex mutex;
+    QWaitCondition resumed;
+    QElapsedTimer progressTimer;
+    int pendingProgress = -1;
+    int pendingTotal = 0;
+};
+
+#endif // SCANJOB_H
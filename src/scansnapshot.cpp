@@ -0,0 +1,350 @@
+#include "scansnapshot.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <cstring>
+
+namespace {
+
+constexpr char Magic[4] = {'F', 'M', 'S', 'S'};
+constexpr quint64 Alignment = 8;
+// Written as is, so a snapshot from a machine of the other byte order is
+// recognised and refused on load
+constexpr quint32 ByteOrderMark = 0x01020304;
+
+quint64 aligned(quint64 offset) {
+    return (offset + Alignment - 1) & ~(Alignment - 1);
+}
+
+template <typename T>
+QByteArray bytesOf(const QVector<T>& values) {
+    return QByteArray(reinterpret_cast<const char *>(values.constData()), values.size() * qsizetype(sizeof(T)));
+}
+
+} // namespace
+
+ScanSnapshot::Writer::Writer(int algorithm, int digestLength)
+    : algorithm(algorithm)
+    , digestLength(digestLength)
+{
+    pathOffsets.append(0);
+    groupStarts.append(0);
+}
+
+int ScanSnapshot::Writer::addHost(const QString& name) {
+    const int existing = hosts.indexOf(name);
+    if (existing >= 0) {
+        return existing;
+    }
+    hosts.append(name);
+    return hosts.size() - 1;
+}
+
+qint64 ScanSnapshot::Writer::addFile(const QString& path, qint64 size, qint64 mtimeNs,
+                                     const QByteArray& digest, int host) {
+    sizes.append(size);
+    mtimes.append(mtimeNs);
+    QByteArray fixed = digest.left(digestLength);
+    fixed.append(QByteArray(digestLength - fixed.size(), '\0'));
+    digests.append(fixed);
+    flags.append(char(digest.isEmpty() ? 0 : HasDigest));
+    fileHosts.append(quint32(qMax(0, host)));
+    paths.append(path.toUtf8());
+    pathOffsets.append(quint64(paths.size()));
+    return sizes.size() - 1;
+}
+
+void ScanSnapshot::Writer::addGroup(const QVector<qint64>& files) {
+    for (qint64 file : files) {
+        groupFiles.append(quint32(file));
+    }
+    groupStarts.append(quint64(groupFiles.size()));
+}
+
+qint64 ScanSnapshot::Writer::fileCount() const {
+    return sizes.size();
+}
+
+bool ScanSnapshot::Writer::save(const QString& filePath) {
+    QStringList hostNames = hosts;
+    if (hostNames.isEmpty()) {
+        hostNames.append(QString());
+    }
+    QVector<quint64> hostOffsets{0};
+    QByteArray names;
+    for (const QString& name : std::as_const(hostNames)) {
+        names.append(name.toUtf8());
+        hostOffsets.append(quint64(names.size()));
+    }
+
+    QByteArray sections[SectionCount];
+    sections[Sizes] = bytesOf(sizes);
+    sections[MTimes] = bytesOf(mtimes);
+    sections[Digests] = digests;
+    sections[Flags] = flags;
+    sections[Hosts] = bytesOf(fileHosts);
+    sections[PathOffsets] = bytesOf(pathOffsets);
+    sections[Paths] = paths;
+    sections[GroupStarts] = bytesOf(groupStarts);
+    sections[GroupFiles] = bytesOf(groupFiles);
+    sections[HostOffsets] = bytesOf(hostOffsets);
+    sections[HostNames] = names;
+
+    Header header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.byteOrder = ByteOrderMark;
+    header.version = Version;
+    header.algorithm = quint32(algorithm);
+    header.digestLength = quint32(digestLength);
+    header.fileCount = quint64(sizes.size());
+    header.groupCount = quint64(groupStarts.size() - 1);
+    header.groupFileCount = quint64(groupFiles.size());
+    header.hostCount = quint64(hostNames.size());
+    header.createdMs = QDateTime::currentMSecsSinceEpoch();
+    quint64 offset = aligned(sizeof(Header));
+    for (int section = 0; section < SectionCount; ++section) {
+        header.offsets[section] = offset;
+        header.lengths[section] = quint64(sections[section].size());
+        offset = aligned(offset + header.lengths[section]);
+    }
+
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+    QSaveFile out(filePath);
+    if (!out.open(QIODevice::WriteOnly)) {
+        error = out.errorString();
+        return false;
+    }
+    const QByteArray padding(Alignment, '\0');
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(padding.constData(), qint64(aligned(sizeof(Header)) - sizeof(Header)));
+    for (const QByteArray& section : sections) {
+        out.write(section);
+        out.write(padding.constData(), qint64(aligned(quint64(section.size())) - quint64(section.size())));
+    }
+    if (!out.commit()) {
+        error = out.errorString();
+        return false;
+    }
+    return true;
+}
+
+QString ScanSnapshot::Writer::errorString() const {
+    return error;
+}
+
+ScanSnapshot::ScanSnapshot() = default;
+
+ScanSnapshot::~ScanSnapshot() {
+    close();
+}
+
+QString ScanSnapshot::defaultPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/lastscan.snapshot";
+}
+
+bool ScanSnapshot::load(const QString& filePath) {
+    close();
+    file.setFileName(filePath);
+    if (!file.open(QFile::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+    if (file.size() < qint64(sizeof(Header))) {
+        error = "Truncated snapshot";
+        file.close();
+        return false;
+    }
+    data = file.map(0, file.size());
+    if (!data) {
+        error = file.errorString();
+        file.close();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (!validate()) {
+        close();
+        return false;
+    }
+    error.clear();
+    return true;
+}
+
+bool ScanSnapshot::validate() {
+    if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0) {
+        error = "Not a snapshot";
+        return false;
+    }
+    if (header.byteOrder != ByteOrderMark) {
+        error = "Snapshot written with a different byte order";
+        return false;
+    }
+    if (header.version != Version) {
+        error = QString("Unsupported snapshot version %1").arg(header.version);
+        return false;
+    }
+
+    // Every column must lie inside the file with the length its count
+    // implies; bounding the counts first keeps those products from overflowing
+    const quint64 n = header.fileCount;
+    const quint64 fileSize = quint64(file.size());
+    if (n > fileSize || header.groupCount > fileSize || header.groupFileCount > fileSize
+        || header.hostCount > fileSize || header.digestLength > 64) {
+        error = "Corrupt snapshot";
+        return false;
+    }
+    const quint64 expected[SectionCount] = {
+        n * sizeof(qint64), n * sizeof(qint64), n * header.digestLength, n, n * sizeof(quint32),
+        (n + 1) * sizeof(quint64), header.lengths[Paths], (header.groupCount + 1) * sizeof(quint64),
+        header.groupFileCount * sizeof(quint32), (header.hostCount + 1) * sizeof(quint64),
+        header.lengths[HostNames]
+    };
+    for (int section = 0; section < SectionCount; ++section) {
+        const quint64 offset = header.offsets[section];
+        const quint64 length = header.lengths[section];
+        if (length != expected[section] || offset % Alignment != 0 || offset > fileSize
+            || length > fileSize - offset) {
+            error = "Corrupt snapshot";
+            return false;
+        }
+    }
+
+    // Offsets and indexes are trusted by the accessors from here on
+    auto ascending = [](const quint64 *offsets, quint64 count, quint64 end) {
+        for (quint64 i = 0; i < count; ++i) {
+            if (offsets[i] > offsets[i + 1]) {
+                return false;
+            }
+        }
+        return offsets[0] == 0 && offsets[count] == end;
+    };
+    bool ok = ascending(column<quint64>(PathOffsets), n, header.lengths[Paths])
+        && ascending(column<quint64>(GroupStarts), header.groupCount, header.groupFileCount)
+        && ascending(column<quint64>(HostOffsets), header.hostCount, header.lengths[HostNames]);
+    const quint32 *hosts = column<quint32>(Hosts);
+    for (quint64 i = 0; ok && i < n; ++i) {
+        ok = hosts[i] < header.hostCount;
+    }
+    const quint32 *members = column<quint32>(GroupFiles);
+    for (quint64 i = 0; ok && i < header.groupFileCount; ++i) {
+        ok = members[i] < n;
+    }
+    if (!ok) {
+        error = "Corrupt snapshot";
+    }
+    return ok;
+}
+
+void ScanSnapshot::close() {
+    if (data) {
+        file.unmap(const_cast<uchar *>(data));
+        data = nullptr;
+    }
+    file.close();
+    header = Header{};
+}
+
+bool ScanSnapshot::isLoaded() const {
+    return data != nullptr;
+}
+
+QString ScanSnapshot::errorString() const {
+    return error;
+}
+
+int ScanSnapshot::algorithm() const {
+    return int(header.algorithm);
+}
+
+int ScanSnapshot::digestLength() const {
+    return int(header.digestLength);
+}
+
+QDateTime ScanSnapshot::created() const {
+    return QDateTime::fromMSecsSinceEpoch(header.createdMs);
+}
+
+QStringList ScanSnapshot::hosts() const {
+    QStringList names;
+    for (quint64 i = 0; i < header.hostCount; ++i) {
+        names.append(hostAt(i));
+    }
+    return names;
+}
+
+qint64 ScanSnapshot::fileCount() const {
+    return qint64(header.fileCount);
+}
+
+QString ScanSnapshot::path(qint64 file) const {
+    const quint64 *offsets = column<quint64>(PathOffsets);
+    return QString::fromUtf8(column<char>(Paths) + offsets[file], qsizetype(offsets[file + 1] - offsets[file]));
+}
+
+QString ScanSnapshot::displayPath(qint64 file) const {
+    if (header.hostCount < 2) {
+        return path(file);
+    }
+    return hostName(host(file)) + ':' + path(file);
+}
+
+qint64 ScanSnapshot::size(qint64 file) const {
+    return column<qint64>(Sizes)[file];
+}
+
+qint64 ScanSnapshot::mtimeNs(qint64 file) const {
+    return column<qint64>(MTimes)[file];
+}
+
+QByteArray ScanSnapshot::digest(qint64 file) const {
+    if (!(column<quint8>(Flags)[file] & HasDigest)) {
+        return QByteArray();
+    }
+    return QByteArray(column<char>(Digests) + file * header.digestLength, header.digestLength);
+}
+
+int ScanSnapshot::host(qint64 file) const {
+    return int(column<quint32>(Hosts)[file]);
+}
+
+QString ScanSnapshot::hostName(int host) const {
+    return host >= 0 && quint64(host) < header.hostCount ? hostAt(quint64(host)) : QString();
+}
+
+QString ScanSnapshot::hostAt(quint64 host) const {
+    const quint64 *offsets = column<quint64>(HostOffsets);
+    return QString::fromUtf8(column<char>(HostNames) + offsets[host], qsizetype(offsets[host + 1] - offsets[host]));
+}
+
+qint64 ScanSnapshot::groupCount() const {
+    return qint64(header.groupCount);
+}
+
+QVector<qint64> ScanSnapshot::groupFiles(qint64 group) const {
+    const quint64 *starts = column<quint64>(GroupStarts);
+    const quint32 *members = column<quint32>(GroupFiles);
+    QVector<qint64> files;
+    files.reserve(qsizetype(starts[group + 1] - starts[group]));
+    for (quint64 i = starts[group]; i < starts[group + 1]; ++i) {
+        files.append(members[i]);
+    }
+    return files;
+}
+
+QList<QStringList> ScanSnapshot::groups() const {
+    return groups(0, groupCount());
+}
+
+QList<QStringList> ScanSnapshot::groups(qint64 first, qint64 count) const {
+    const qint64 end = qMin(groupCount(), first + count);
+    QList<QStringList> result;
+    result.reserve(qsizetype(qMax<qint64>(0, end - first)));
+    for (qint64 group = qMax<qint64>(0, first); group < end; ++group) {
+        QStringList paths;
+        for (qint64 file : groupFiles(group)) {
+            paths.append(displayPath(file));
+        }
+        result.append(paths);
+    }
+    return result;
+}
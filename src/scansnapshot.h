@@ -0,0 +1,137 @@
+#ifndef SCANSNAPSHOT_H
+#define SCANSNAPSHOT_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// A scan's files and duplicate groups in a versioned, columnar file: one
+// array per field (size, mtime, digest, host, path offset) next to UTF-8
+// blobs of paths and host names, every column 8-byte aligned. Columns are
+// stored in the writer's byte order, which the header records; load() refuses
+// a snapshot of the other byte order, then maps the file and checks the
+// columns once, after which each accessor reads
+// straight from the mapping, so snapshots of millions of files open in
+// milliseconds. Every file remembers the host it was scanned on, which is
+// what lets snapshots of several machines be merged and regrouped by digest
+// without reading a file again. Snapshots are built with Writer.
+class ScanSnapshot {
+public:
+    class Writer {
+    public:
+        Writer(int algorithm, int digestLength);
+
+        int addHost(const QString& name);
+        // digest may be empty where only the size is known
+        qint64 addFile(const QString& path, qint64 size, qint64 mtimeNs, const QByteArray& digest, int host = 0);
+        void addGroup(const QVector<qint64>& files);
+        qint64 fileCount() const;
+
+        bool save(const QString& filePath);
+        QString errorString() const;
+
+    private:
+        int algorithm;
+        int digestLength;
+        QStringList hosts;
+        QVector<qint64> sizes;
+        QVector<qint64> mtimes;
+        QByteArray digests;
+        QByteArray flags;
+        QVector<quint32> fileHosts;
+        QVector<quint64> pathOffsets;
+        QByteArray paths;
+        QVector<quint64> groupStarts;
+        QVector<quint32> groupFiles;
+        QString error;
+    };
+
+    ScanSnapshot();
+    ~ScanSnapshot();
+    ScanSnapshot(const ScanSnapshot&) = delete;
+    ScanSnapshot& operator=(const ScanSnapshot&) = delete;
+
+    static QString defaultPath();
+
+    bool load(const QString& filePath);
+    void close();
+    bool isLoaded() const;
+    QString errorString() const;
+
+    int algorithm() const;
+    int digestLength() const;
+    QDateTime created() const;
+    QStringList hosts() const;
+
+    qint64 fileCount() const;
+    QString path(qint64 file) const;
+    // "host:path" once the snapshot spans several hosts
+    QString displayPath(qint64 file) const;
+    qint64 size(qint64 file) const;
+    qint64 mtimeNs(qint64 file) const;
+    // Empty unless the file's full digest was computed
+    QByteArray digest(qint64 file) const;
+    int host(qint64 file) const;
+    QString hostName(int host) const;
+
+    qint64 groupCount() const;
+    QVector<qint64> groupFiles(qint64 group) const;
+    // Display paths of every group, or of count groups from first
+    QList<QStringList> groups() const;
+    QList<QStringList> groups(qint64 first, qint64 count) const;
+
+    static constexpr quint32 Version = 2;
+
+private:
+    enum Section {
+        Sizes,
+        MTimes,
+        Digests,
+        Flags,
+        Hosts,
+        PathOffsets,
+        Paths,
+        GroupStarts,
+        GroupFiles,
+        HostOffsets,
+        HostNames,
+        SectionCount
+    };
+
+    struct Header {
+        char magic[4];
+        quint32 byteOrder;
+        quint32 version;
+        quint32 algorithm;
+        quint32 digestLength;
+        quint64 fileCount;
+        quint64 groupCount;
+        quint64 groupFileCount;
+        quint64 hostCount;
+        qint64 createdMs;
+        quint64 offsets[SectionCount];
+        quint64 lengths[SectionCount];
+    };
+
+    enum FileFlag : quint8 {
+        HasDigest = 0x1
+    };
+
+    template <typename T>
+    const T *column(Section section) const {
+        return reinterpret_cast<const T *>(data + header.offsets[section]);
+    }
+    bool validate();
+    QString hostAt(quint64 host) const;
+
+    QFile file;
+    const uchar *data = nullptr;
+    Header header{};
+    QString error;
+};
+
+#endif // SCANSNAPSHOT_H
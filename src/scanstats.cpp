@@ -0,0 +1,258 @@
+#include "scanstats.h"
+#include <QFile>
+#include <QThread>
+#include <QtAlgorithms>
+
+namespace {
+
+std::atomic<quint64> nextStatsId{1};
+
+// Which block this thread last recorded into, keyed by the owner's id so a
+// destroyed or reset ScanStats is never written through a stale pointer
+struct LocalBlock {
+    quint64 owner = 0;
+    void *block = nullptr;
+};
+thread_local LocalBlock localCache;
+
+// Each block has a single writer, a plain load/store avoids a locked add
+inline void bump(std::atomic<quint64>& value, quint64 amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline int bucketFor(qint64 ns) {
+    if (ns <= 1) {
+        return 0;
+    }
+    return qMin(ScanStats::HistogramBuckets - 1, 63 - int(qCountLeadingZeroBits(quint64(ns))));
+}
+
+} // namespace
+
+quint64 ScanStats::StageStats::percentileNs(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+    const quint64 rank = qMax<quint64>(1, quint64(fraction * double(count) + 0.5));
+    quint64 seen = 0;
+    for (int bucket = 0; bucket < HistogramBuckets; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return quint64(1) << (bucket + 1);
+        }
+    }
+    return quint64(1) << HistogramBuckets;
+}
+
+QString ScanStats::Snapshot::summary() const {
+    const double seconds = elapsedNs / 1e9;
+    const double megabytes = counters[BytesRead] / 1e6;
+    const quint64 lookups = counters[CacheHits] + counters[CacheMisses];
+    auto milliseconds = [](quint64 ns) { return QString::number(ns / 1e6, 'f', 1); };
+
+    QString text = QString("%1 files listed, %2 hashed, %3 MB read (%4 MB/s)")
+        .arg(counters[FilesListed])
+        .arg(counters[FilesHashed])
+        .arg(megabytes, 0, 'f', 1)
+        .arg(seconds > 0 ? megabytes / seconds : 0.0, 0, 'f', 1);
+    if (lookups > 0) {
+        text += QString(", cache %1% hits").arg(100 * counters[CacheHits] / lookups);
+    }
+    for (Stage stage : {Walk, Read, Hash, Compare, Ui}) {
+        if (stages[stage].count > 0) {
+            text += QString(", %1 %2 ms (p99 %3 ms)")
+                .arg(stageName(stage), milliseconds(stages[stage].totalNs),
+                     milliseconds(stages[stage].percentileNs(0.99)));
+        }
+    }
+    return text;
+}
+
+ScanStats::Scope::Scope(ScanStats *stats, Stage stage)
+    : stats(stats)
+    , stage(stage)
+    , start(stats ? stats->now() : 0)
+{
+}
+
+ScanStats::Scope::~Scope() {
+    if (stats) {
+        stats->record(stage, start, stats->now() - start);
+    }
+}
+
+ScanStats::ScanStats()
+    : id(nextStatsId.fetch_add(1))
+{
+    clock.start();
+}
+
+ScanStats::~ScanStats() = default;
+
+void ScanStats::reset() {
+    QMutexLocker locker(&mutex);
+    blocks.clear();
+    id = nextStatsId.fetch_add(1);
+    clock.restart();
+}
+
+void ScanStats::setTracing(bool enabled) {
+    tracing.store(enabled, std::memory_order_relaxed);
+}
+
+bool ScanStats::isTracing() const {
+    return tracing.load(std::memory_order_relaxed);
+}
+
+qint64 ScanStats::now() const {
+    return clock.nsecsElapsed();
+}
+
+ScanStats::ThreadBlock *ScanStats::localBlock() {
+    if (localCache.owner == id) {
+        return static_cast<ThreadBlock *>(localCache.block);
+    }
+
+    // First record from this thread, or it switched between operations
+    const quint64 threadId = quint64(quintptr(QThread::currentThreadId()));
+    QMutexLocker locker(&mutex);
+    ThreadBlock *block = nullptr;
+    for (const std::unique_ptr<ThreadBlock>& candidate : blocks) {
+        if (candidate->threadId == threadId) {
+            block = candidate.get();
+            break;
+        }
+    }
+    if (!block) {
+        blocks.push_back(std::make_unique<ThreadBlock>());
+        block = blocks.back().get();
+        block->threadId = threadId;
+    }
+    localCache.owner = id;
+    localCache.block = block;
+    return block;
+}
+
+void ScanStats::add(Counter counter, quint64 value) {
+    bump(localBlock()->counters[counter], value);
+}
+
+void ScanStats::record(Stage stage, qint64 startNs, qint64 durationNs) {
+    ThreadBlock *block = localBlock();
+    bump(block->stageCount[stage], 1);
+    bump(block->stageNs[stage], quint64(qMax<qint64>(0, durationNs)));
+    bump(block->buckets[stage][bucketFor(durationNs)], 1);
+
+    if (isTracing()) {
+        QMutexLocker locker(&block->eventMutex);
+        if (block->events.size() < size_t(MaxTraceEventsPerThread)) {
+            block->events.push_back({startNs, durationNs, stage});
+        }
+    }
+}
+
+ScanStats::Snapshot ScanStats::snapshot() const {
+    Snapshot snapshot;
+    snapshot.elapsedNs = now();
+    QMutexLocker locker(&mutex);
+    for (const std::unique_ptr<ThreadBlock>& block : blocks) {
+        for (int counter = 0; counter < CounterCount; ++counter) {
+            snapshot.counters[counter] += block->counters[counter].load(std::memory_order_relaxed);
+        }
+        for (int stage = 0; stage < StageCount; ++stage) {
+            StageStats& stats = snapshot.stages[stage];
+            stats.count += block->stageCount[stage].load(std::memory_order_relaxed);
+            stats.totalNs += block->stageNs[stage].load(std::memory_order_relaxed);
+            for (int bucket = 0; bucket < HistogramBuckets; ++bucket) {
+                stats.buckets[bucket] += block->buckets[stage][bucket].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return snapshot;
+}
+
+bool ScanStats::writeChromeTrace(const QString& filePath) const {
+    QFile file(filePath);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        return false;
+    }
+
+    // Trace Event Format: complete ("X") events with microsecond timestamps
+    QByteArray out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&out, &first]() {
+        if (!first) {
+            out += ",\n";
+        }
+        first = false;
+    };
+
+    QMutexLocker locker(&mutex);
+    for (size_t tid = 0; tid < blocks.size(); ++tid) {
+        const ThreadBlock& block = *blocks[tid];
+        separator();
+        out += QString("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%1,"
+                       "\"args\":{\"name\":\"thread %2\"}}")
+                   .arg(tid).arg(block.threadId, 0, 16).toUtf8();
+
+        QMutexLocker eventLocker(&block.eventMutex);
+        for (const TraceEvent& event : block.events) {
+            separator();
+            out += "{\"name\":\"";
+            out += stageName(event.stage).toUtf8();
+            out += "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+            out += QByteArray::number(qulonglong(tid));
+            out += ",\"ts\":";
+            out += QByteArray::number(event.startNs / 1000.0, 'f', 3);
+            out += ",\"dur\":";
+            out += QByteArray::number(event.durationNs / 1000.0, 'f', 3);
+            out += '}';
+            if (out.size() > (1 << 20)) {
+                file.write(out);
+                out.clear();
+            }
+        }
+    }
+    locker.unlock();
+
+    const Snapshot totals = snapshot();
+    separator();
+    out += QString("{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%1,\"args\":{")
+               .arg(totals.elapsedNs / 1000.0, 0, 'f', 3).toUtf8();
+    for (int counter = 0; counter < CounterCount; ++counter) {
+        if (counter > 0) {
+            out += ',';
+        }
+        out += QString("\"%1\":%2").arg(counterName(Counter(counter))).arg(totals.counters[counter]).toUtf8();
+    }
+    out += "}}\n]}\n";
+    return file.write(out) == out.size() && file.flush();
+}
+
+QString ScanStats::stageName(Stage stage) {
+    switch (stage) {
+    case Walk: return "walk";
+    case Read: return "read";
+    case Hash: return "hash";
+    case Compare: return "compare";
+    case Publish: return "publish";
+    case Rename: return "rename";
+    case Remove: return "remove";
+    case Ui: return "ui";
+    case StageCount: break;
+    }
+    return QString();
+}
+
+QString ScanStats::counterName(Counter counter) {
+    switch (counter) {
+    case FilesListed: return "files_listed";
+    case FilesHashed: return "files_hashed";
+    case BytesRead: return "bytes_read";
+    case CacheHits: return "cache_hits";
+    case CacheMisses: return "cache_misses";
+    case GroupsFound: return "groups_found";
+    case CounterCount: break;
+    }
+    return QString();
+}
@@ -0,0 +1,126 @@
+#ifndef SCANSTATS_H
+#define SCANSTATS_H
+
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <QMutex>
+#include <QString>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Per-stage counters, latency histograms and optional trace events of one
+// operation. Every thread writes only to its own block (found through a
+// thread_local cache), so recording is a handful of uncontended relaxed
+// stores; snapshot() sums the blocks and may be taken from any thread while
+// the operation runs. With tracing enabled each timed scope also becomes a
+// complete event that writeChromeTrace() exports for chrome://tracing or
+// Perfetto.
+class ScanStats {
+public:
+    enum Stage {
+        Walk,       // directory listing and stat
+        Read,       // blocked in read()
+        Hash,       // digest computation
+        Compare,    // byte-exact comparison
+        Publish,    // emitting results
+        Rename,
+        Remove,
+        Ui,         // views updating from results
+        StageCount
+    };
+
+    enum Counter {
+        FilesListed,
+        FilesHashed,
+        BytesRead,
+        CacheHits,
+        CacheMisses,
+        GroupsFound,
+        CounterCount
+    };
+
+    // Bucket b counts durations in [2^b, 2^(b+1)) ns
+    static constexpr int HistogramBuckets = 40;
+    static constexpr int MaxTraceEventsPerThread = 256 * 1024;
+
+    struct StageStats {
+        quint64 count = 0;
+        quint64 totalNs = 0;
+        quint64 buckets[HistogramBuckets] = {};
+
+        // Upper bound of the bucket holding the given fraction of samples
+        quint64 percentileNs(double fraction) const;
+    };
+
+    struct Snapshot {
+        qint64 elapsedNs = 0;
+        quint64 counters[CounterCount] = {};
+        StageStats stages[StageCount];
+
+        QString summary() const;
+    };
+
+    // Times its lifetime into a stage; a null ScanStats makes it a no-op
+    class Scope {
+    public:
+        Scope(ScanStats *stats, Stage stage);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        ScanStats *stats;
+        Stage stage;
+        qint64 start;
+    };
+
+    ScanStats();
+    ~ScanStats();
+    ScanStats(const ScanStats&) = delete;
+    ScanStats& operator=(const ScanStats&) = delete;
+
+    // Only while no thread is recording
+    void reset();
+    void setTracing(bool enabled);
+    bool isTracing() const;
+
+    void add(Counter counter, quint64 value = 1);
+    void record(Stage stage, qint64 startNs, qint64 durationNs);
+    qint64 now() const;
+
+    Snapshot snapshot() const;
+    bool writeChromeTrace(const QString& filePath) const;
+
+    static QString stageName(Stage stage);
+    static QString counterName(Counter counter);
+
+private:
+    struct TraceEvent {
+        qint64 startNs;
+        qint64 durationNs;
+        Stage stage;
+    };
+
+    struct ThreadBlock {
+        quint64 threadId = 0;
+        std::atomic<quint64> counters[CounterCount] = {};
+        std::atomic<quint64> stageCount[StageCount] = {};
+        std::atomic<quint64> stageNs[StageCount] = {};
+        std::atomic<quint64> buckets[StageCount][HistogramBuckets] = {};
+        mutable QMutex eventMutex;
+        std::vector<TraceEvent> events;
+    };
+
+    ThreadBlock *localBlock();
+
+    quint64 id;
+    QElapsedTimer clock;
+    std::atomic<bool> tracing{false};
+    mutable QMutex mutex;
+    std::vector<std::unique_ptr<ThreadBlock>> blocks;
+};
+
+Q_DECLARE_METATYPE(ScanStats::Snapshot)
+
+#endif // SCANSTATS_H
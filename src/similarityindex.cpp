@@ -0,0 +1,121 @@
+#include "similarityindex.h"
+#include <QSet>
+#include <limits>
+
+namespace {
+
+inline quint64 mix64(quint64 z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+struct Seeds {
+    quint64 values[SimilarityIndex::SignatureLength];
+};
+
+constexpr Seeds makeSeeds() {
+    Seeds seeds{};
+    quint64 state = 0x4D696E4861736821ULL;
+    for (int i = 0; i < SimilarityIndex::SignatureLength; ++i) {
+        state += 0x9E3779B97F4A7C15ULL;
+        quint64 z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        seeds.values[i] = z ^ (z >> 31);
+    }
+    return seeds;
+}
+
+constexpr Seeds kSeeds = makeSeeds();
+
+quint64 bandKey(const SimilarityIndex::Signature& signature, int band) {
+    quint64 key = quint64(band) * 0x9E3779B97F4A7C15ULL;
+    for (int row = 0; row < SimilarityIndex::Rows; ++row) {
+        key = mix64(key ^ signature[band * SimilarityIndex::Rows + row]);
+    }
+    return key;
+}
+
+} // namespace
+
+SimilarityIndex::SimilarityIndex(double threshold)
+    : minimumSimilarity(threshold)
+{
+}
+
+SimilarityIndex::Signature SimilarityIndex::emptySignature() {
+    Signature signature;
+    signature.fill(std::numeric_limits<quint64>::max());
+    return signature;
+}
+
+void SimilarityIndex::addFingerprint(Signature& signature, quint64 fingerprint) {
+    // One independent hash per slot stands in for a random permutation
+    for (int i = 0; i < SignatureLength; ++i) {
+        signature[i] = qMin(signature[i], mix64(fingerprint ^ kSeeds.values[i]));
+    }
+}
+
+double SimilarityIndex::estimate(const Signature& a, const Signature& b) {
+    int equal = 0;
+    for (int i = 0; i < SignatureLength; ++i) {
+        equal += a[i] == b[i];
+    }
+    return double(equal) / SignatureLength;
+}
+
+int SimilarityIndex::add(const Signature& signature) {
+    const int id = signatures.size();
+    signatures.append(signature);
+    for (int band = 0; band < Bands; ++band) {
+        buckets[band][bandKey(signature, band)].append(id);
+    }
+    return id;
+}
+
+int SimilarityIndex::size() const {
+    return signatures.size();
+}
+
+void SimilarityIndex::clear() {
+    signatures.clear();
+    for (auto& band : buckets) {
+        band.clear();
+    }
+}
+
+QVector<SimilarityIndex::Match> SimilarityIndex::matches() const {
+    QVector<Match> result;
+    QSet<quint64> seen;
+    for (const auto& band : buckets) {
+        for (const QVector<int>& bucket : band) {
+            if (bucket.size() < 2 || bucket.size() > MaxBucketSize) {
+                continue;
+            }
+            for (int i = 0; i < bucket.size(); ++i) {
+                for (int j = i + 1; j < bucket.size(); ++j) {
+                    const quint64 pair = (quint64(quint32(bucket[i])) << 32) | quint32(bucket[j]);
+                    if (seen.contains(pair)) {
+                        continue;
+                    }
+                    seen.insert(pair);
+
+                    const double similarity = estimate(signatures[bucket[i]], signatures[bucket[j]]);
+                    if (similarity >= minimumSimilarity) {
+                        result.append({bucket[i], bucket[j], similarity});
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void SimilarityIndex::setThreshold(double threshold) {
+    minimumSimilarity = threshold;
+}
+
+double SimilarityIndex::threshold() const {
+    return minimumSimilarity;
+}
@@ -0,0 +1,57 @@
+#ifndef SIMILARITYINDEX_H
+#define SIMILARITYINDEX_H
+
+#include <QHash>
+#include <QVector>
+#include <array>
+
+// In-memory MinHash/LSH index for near-duplicate detection. A signature is
+// the per-permutation minimum over a file's chunk fingerprints, so the share
+// of equal slots between two signatures estimates the Jaccard similarity of
+// their chunk sets. Signatures are split into Bands of Rows slots and
+// bucketed per band; only files sharing a bucket are ever compared, which
+// with the defaults makes pairs above ~0.5 similarity very likely to meet.
+class SimilarityIndex {
+public:
+    static constexpr int SignatureLength = 64;
+    static constexpr int Bands = 16;
+    static constexpr int Rows = SignatureLength / Bands;
+
+    using Signature = std::array<quint64, SignatureLength>;
+
+    struct Match {
+        int first = -1;
+        int second = -1;
+        double similarity = 0.0;
+    };
+
+    explicit SimilarityIndex(double threshold = 0.7);
+
+    static Signature emptySignature();
+    // Folds one chunk fingerprint into a signature
+    static void addFingerprint(Signature& signature, quint64 fingerprint);
+    static double estimate(const Signature& a, const Signature& b);
+
+    // Returns the id the signature is reported under
+    int add(const Signature& signature);
+    int size() const;
+    void clear();
+
+    // Every pair of added signatures whose estimated similarity reaches the
+    // threshold, each pair once with first < second
+    QVector<Match> matches() const;
+
+    void setThreshold(double threshold);
+    double threshold() const;
+
+    // Buckets larger than this are skipped; they only form around
+    // degenerate content such as files of a single repeated chunk
+    static constexpr int MaxBucketSize = 2000;
+
+private:
+    QVector<Signature> signatures;
+    std::array<QHash<quint64, QVector<int>>, Bands> buckets;
+    double minimumSimilarity;
+};
+
+#endif // SIMILARITYINDEX_H
@@ -0,0 +1,97 @@
+#include "storagedevice.h"
+#include "batchreader.h"
+#include <QFile>
+#include <QFileInfo>
+
+#ifdef Q_OS_LINUX
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace {
+
+#ifdef Q_OS_LINUX
+// statfs magic numbers of file systems served over the network
+constexpr quint32 NetworkFileSystems[] = {
+    0x6969,         // NFS
+    0x517b,         // SMB
+    0xff534d42,     // CIFS
+    0xfe534d42,     // SMB2
+    0x564c,         // NCP
+    0x73757245,     // Coda
+    0x6b414653,     // AFS
+    0x01021997,     // 9p
+    0x00c36400      // Ceph
+};
+
+StorageDevice::Kind blockDeviceKind(dev_t device) {
+    QString directory = QFileInfo(QString("/sys/dev/block/%1:%2").arg(major(device)).arg(minor(device)))
+                            .canonicalFilePath();
+    if (directory.isEmpty()) {
+        return StorageDevice::Kind::Unknown;
+    }
+    // Partitions have no queue of their own, it belongs to the parent disk
+    if (!QFile::exists(directory + "/queue/rotational")) {
+        directory = QFileInfo(directory).path();
+    }
+    QFile rotational(directory + "/queue/rotational");
+    if (!rotational.open(QIODevice::ReadOnly)) {
+        return StorageDevice::Kind::Unknown;
+    }
+    return rotational.readAll().trimmed() == "1" ? StorageDevice::Kind::Rotational
+                                                 : StorageDevice::Kind::SolidState;
+}
+#endif
+
+} // namespace
+
+StorageDevice::Kind StorageDevice::detect(const QString& path) {
+#ifdef Q_OS_LINUX
+    const QByteArray encoded = QFile::encodeName(path);
+    struct statfs fs;
+    if (::statfs(encoded.constData(), &fs) == 0) {
+        for (quint32 magic : NetworkFileSystems) {
+            if (quint32(fs.f_type) == magic) {
+                return Kind::Network;
+            }
+        }
+    }
+    struct stat st;
+    // Major 0 is an anonymous device: tmpfs, overlay, btrfs subvolumes
+    if (::stat(encoded.constData(), &st) == 0 && major(st.st_dev) != 0) {
+        return blockDeviceKind(st.st_dev);
+    }
+#else
+    Q_UNUSED(path);
+#endif
+    return Kind::Unknown;
+}
+
+StorageDevice::Budget StorageDevice::budget(Kind kind, int cpuThreads) {
+    switch (kind) {
+    case Kind::Rotational:
+        // Concurrent streams only make the heads seek between them
+        return {1, 1};
+    case Kind::Network:
+        return {NetworkThreads, NetworkQueueDepth};
+    case Kind::SolidState:
+    case Kind::Unknown:
+        break;
+    }
+    return {qMax(1, cpuThreads), BatchReader::DefaultQueueDepth};
+}
+
+QString StorageDevice::kindName(Kind kind) {
+    switch (kind) {
+    case Kind::SolidState:
+        return "ssd";
+    case Kind::Rotational:
+        return "hdd";
+    case Kind::Network:
+        return "network";
+    case Kind::Unknown:
+        break;
+    }
+    return "unknown";
+}
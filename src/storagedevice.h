@@ -0,0 +1,35 @@
+#ifndef STORAGEDEVICE_H
+#define STORAGEDEVICE_H
+
+#include <QString>
+
+// Tells what kind of storage holds a path so reads can be paced to it: an
+// SSD wants a deep queue, a spinning disk a single sequential reader and a
+// network share a handful of requests in flight. On Linux the block device
+// behind st_dev is looked up in sysfs, partitions included; file systems
+// without one are told apart by their statfs magic. Anything else is
+// Unknown and read like an SSD.
+class StorageDevice {
+public:
+    enum class Kind {
+        Unknown,
+        SolidState,
+        Rotational,
+        Network
+    };
+
+    struct Budget {
+        int threads;
+        int queueDepth;     // files in flight across the threads
+    };
+
+    static Kind detect(const QString& path);
+    // Reader concurrency for kind; SSDs and unknown devices get cpuThreads
+    static Budget budget(Kind kind, int cpuThreads);
+    static QString kindName(Kind kind);
+
+    static constexpr int NetworkThreads = 4;
+    static constexpr int NetworkQueueDepth = 16;
+};
+
+#endif // STORAGEDEVICE_H
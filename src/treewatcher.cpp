@@ -0,0 +1,234 @@
+#include "treewatcher.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QtGlobal>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef Q_OS_LINUX
+constexpr uint32_t WatchEvents = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO
+                               | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW;
+constexpr int EventBufferSize = 64 * 1024;
+#endif
+
+} // namespace
+
+void TreeWatcher::Changes::clear() {
+    changed.clear();
+    removed.clear();
+    removedDirectories.clear();
+    overflow = false;
+    rootLost = false;
+}
+
+bool TreeWatcher::Changes::isEmpty() const {
+    return changed.isEmpty() && removed.isEmpty() && removedDirectories.isEmpty() && !overflow && !rootLost;
+}
+
+TreeWatcher::TreeWatcher() {
+#ifdef Q_OS_LINUX
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+TreeWatcher::~TreeWatcher() {
+#ifdef Q_OS_LINUX
+    if (fd >= 0) {
+        ::close(fd);
+    }
+#endif
+}
+
+bool TreeWatcher::watch(const QString& root, bool recursive) {
+    if (fd < 0 || !QDir(root).exists()) {
+        return false;
+    }
+    recursiveWatch = recursive;
+    const QString path = QDir::cleanPath(root);
+    addWatches(path, nullptr);
+    rootWatch = directories.key(path, -1);
+    return !directories.isEmpty();
+}
+
+bool TreeWatcher::isWatching() const {
+    return fd >= 0 && !directories.isEmpty();
+}
+
+int TreeWatcher::watchCount() const {
+    return directories.size();
+}
+
+void TreeWatcher::addWatches(const QString& directory, Changes *discovered) {
+#ifdef Q_OS_LINUX
+    QStringList pending{directory};
+    if (recursiveWatch) {
+        QDirIterator it(directory, QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::NoSymLinks,
+                        QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            pending.append(it.next());
+        }
+    }
+
+    for (const QString& path : pending) {
+        const int wd = inotify_add_watch(fd, QFile::encodeName(path).constData(), WatchEvents);
+        if (wd >= 0) {
+            directories.insert(wd, path);
+        }
+    }
+
+    // Files written before the watch was in place would otherwise be missed
+    if (discovered) {
+        QDirIterator it(directory, QDir::Files | QDir::Hidden | QDir::NoSymLinks,
+                        recursiveWatch ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+        while (it.hasNext()) {
+            const QString path = it.next();
+            discovered->changed.insert(path);
+            discovered->removed.remove(path);
+        }
+    }
+#else
+    Q_UNUSED(directory);
+    Q_UNUSED(discovered);
+#endif
+}
+
+void TreeWatcher::readEvents(Changes& changes) {
+#ifdef Q_OS_LINUX
+    alignas(inotify_event) char buffer[EventBufferSize];
+    for (;;) {
+        const ssize_t length = ::read(fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return;
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+            const auto *event = reinterpret_cast<const inotify_event *>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                changes.overflow = true;
+                continue;
+            }
+            if ((event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) && event->wd == rootWatch) {
+                // No parent of the root is watched to report this
+                changes.rootLost = true;
+                continue;
+            }
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                // The parent reports the removal; only forget the descriptor here
+                if (event->mask & IN_IGNORED) {
+                    directories.remove(event->wd);
+                }
+                continue;
+            }
+
+            const auto directory = directories.constFind(event->wd);
+            if (directory == directories.constEnd() || event->len == 0) {
+                continue;
+            }
+            const QString path = *directory + QLatin1Char('/') + QFile::decodeName(event->name);
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_MOVED_FROM | IN_DELETE)) {
+                    changes.removedDirectories.insert(path);
+                    // Watches below a moved-away directory keep reporting under the old path
+                    if (event->mask & IN_MOVED_FROM) {
+                        const QString prefix = path + QLatin1Char('/');
+                        for (auto it = directories.begin(); it != directories.end();) {
+                            if (it.value() == path || it.value().startsWith(prefix)) {
+                                inotify_rm_watch(fd, it.key());
+                                it = directories.erase(it);
+                            } else {
+                                ++it;
+                            }
+                        }
+                    }
+                } else if (recursiveWatch && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    changes.removedDirectories.remove(path);
+                    addWatches(path, &changes);
+                }
+                continue;
+            }
+
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                changes.removed.insert(path);
+                changes.changed.remove(path);
+            } else if (event->mask & (IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                changes.changed.insert(path);
+                changes.removed.remove(path);
+            }
+        }
+    }
+#else
+    Q_UNUSED(changes);
+#endif
+}
+
+void TreeWatcher::removeWatches() {
+#ifdef Q_OS_LINUX
+    for (auto it = directories.cbegin(); it != directories.cend(); ++it) {
+        inotify_rm_watch(fd, it.key());
+    }
+#endif
+    directories.clear();
+    rootWatch = -1;
+}
+
+bool TreeWatcher::waitForChanges(Changes& changes, const Checkpoint& checkpoint) {
+    changes.clear();
+#ifdef Q_OS_LINUX
+    QElapsedTimer sinceFirst;
+    QElapsedTimer sinceLast;
+    bool pending = false;
+
+    while (isWatching()) {
+        if (checkpoint && !checkpoint()) {
+            return false;
+        }
+
+        int timeout = PollInterval;
+        if (pending) {
+            const qint64 quietLeft = QuietPeriod - sinceLast.elapsed();
+            const qint64 latencyLeft = MaxLatency - sinceFirst.elapsed();
+            if (quietLeft <= 0 || latencyLeft <= 0) {
+                return true;
+            }
+            timeout = int(qMin<qint64>(PollInterval, qMin(quietLeft, latencyLeft)));
+        }
+
+        pollfd descriptor{fd, POLLIN, 0};
+        const int ready = ::poll(&descriptor, 1, timeout);
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        readEvents(changes);
+        if (changes.rootLost) {
+            removeWatches();
+            return true;
+        }
+        // A burst that cancelled itself out (created and deleted) still resets the quiet period
+        if (!pending) {
+            sinceFirst.start();
+        }
+        sinceLast.start();
+        pending = true;
+    }
+    return pending && !changes.isEmpty();
+#else
+    Q_UNUSED(checkpoint);
+    return false;
+#endif
+}
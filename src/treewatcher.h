@@ -0,0 +1,58 @@
+#ifndef TREEWATCHER_H
+#define TREEWATCHER_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <functional>
+
+// inotify subscription for a directory tree. Events are read without an
+// event loop from a blocking poll, folded into one set of changed and one
+// set of removed paths (create + delete cancels out, repeated writes count
+// once) and handed out only after the burst has settled, so copying a large
+// tree turns into a handful of batches instead of one rescan per file.
+// Directories created or moved in are watched as they appear and their
+// files are reported as changed. Removing or moving the root ends the watch.
+class TreeWatcher {
+public:
+    using Checkpoint = std::function<bool()>;
+
+    struct Changes {
+        QSet<QString> changed;
+        QSet<QString> removed;
+        QSet<QString> removedDirectories;
+        bool overflow = false;      // the kernel dropped events, rescan everything
+        bool rootLost = false;      // the root was removed or moved, the watch has ended
+
+        void clear();
+        bool isEmpty() const;
+    };
+
+    TreeWatcher();
+    ~TreeWatcher();
+
+    bool watch(const QString& root, bool recursive = true);
+    bool isWatching() const;
+    int watchCount() const;
+
+    // Blocks until events have been quiet for QuietPeriod or MaxLatency has
+    // passed since the first one. Returns false when the checkpoint says
+    // stop or the watch broke.
+    bool waitForChanges(Changes& changes, const Checkpoint& checkpoint = Checkpoint());
+
+    static constexpr int QuietPeriod = 500;
+    static constexpr int MaxLatency = 5000;
+    static constexpr int PollInterval = 100;
+
+private:
+    void addWatches(const QString& directory, Changes *discovered);
+    void readEvents(Changes& changes);
+    void removeWatches();
+
+    int fd = -1;
+    int rootWatch = -1;
+    bool recursiveWatch = true;
+    QHash<int, QString> directories;
+};
+
+#endif // TREEWATCHER_H
@@ -1,6 +1,31 @@
 #include <QtTest/QtTest>
 #include <QtCore/QString>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QStandardPaths>
 #include "../src/filemanager.h"
+#include "../src/hashengine.h"
+#include "../src/fasthash.h"
+#include "../src/directorywalker.h"
+#include "../src/scanjob.h"
+#include "../src/contentcomparator.h"
+#include "../src/duplicateresultmodel.h"
+#include "../src/renameplanner.h"
+#include "../src/renamepattern.h"
+#include "../src/fileanalyzer.h"
+#include "../src/contentchunker.h"
+#include "../src/scanstats.h"
+#include "../src/batchreader.h"
+#include "../src/directorysizescanner.h"
+#include "../src/digestindex.h"
+#include "../src/storagedevice.h"
+#include "../src/scansnapshot.h"
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
 
 // This is our test class
 class FileManagerTest : public QObject
@@ -10,6 +35,7 @@ class FileManagerTest : public QObject
 private slots:  // Test functions must be private slots
     // This function runs before all tests
     void initTestCase() {
+        QStandardPaths::setTestModeEnabled(true);
         testFileManager = new FileManager(this);
     }
 
@@ -31,6 +57,31 @@ private slots:  // Test functions must be private slots
         QVERIFY(result == false);
     }
 
+    // Renames that swap names are routed through temporary names
+    void test_batchRenameCycle() {
+        QTemporaryDir temp;
+        QVERIFY(temp.isValid());
+        QDir dir(temp.path());
+        writeFile(dir.filePath("001.txt"), "first");
+        writeFile(dir.filePath("002.txt"), "second");
+        writeFile(dir.filePath("taken.txt"), "taken");
+        writeFile(dir.filePath("other.txt"), "other");
+
+        // 002 -> 001 and 001 -> 002 form a cycle
+        QVERIFY(testFileManager->batchRename({dir.filePath("002.txt"), dir.filePath("001.txt")}, "%n"));
+        QCOMPARE(readFile(dir.filePath("001.txt")), QByteArray("second"));
+        QCOMPARE(readFile(dir.filePath("002.txt")), QByteArray("first"));
+        QCOMPARE(dir.entryList(QDir::Files | QDir::Hidden).size(), 4);
+
+        // A target that already exists is left alone and reported
+        RenamePlanner planner("taken");
+        QVERIFY(!planner.plan({dir.filePath("other.txt")}));
+        QVERIFY(planner.moves().isEmpty());
+        QVERIFY(planner.execute());
+        QCOMPARE(readFile(dir.filePath("taken.txt")), QByteArray("taken"));
+        QCOMPARE(readFile(dir.filePath("other.txt")), QByteArray("other"));
+    }
+
     // Test finding duplicates by content
     void test_findDuplicatesByContent() {
         QString testDir = "test_directory";
@@ -40,6 +91,959 @@ private slots:  // Test functions must be private slots
         QVERIFY(result.isEmpty());
     }
 
+    // Files must share size, head/tail and full content to be reported
+    void test_findDuplicateGroups() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        QByteArray content(64 * 1024, 'a');
+        QByteArray middleChanged = content;
+        middleChanged[content.size() / 2] = 'b';
+
+        writeFile(dir.filePath("a.bin"), content);
+        writeFile(dir.filePath("b.bin"), content);
+        writeFile(dir.filePath("c.bin"), middleChanged);
+        writeFile(dir.filePath("d.bin"), content + "unique");
+        writeFile(dir.filePath("e.txt"), "small");
+        writeFile(dir.filePath("f.txt"), "small");
+
+        QList<QStringList> groups = testFileManager->findDuplicateGroups(dir.path());
+        QCOMPARE(groups.size(), 2);
+
+        QStringList all;
+        for (QStringList group : groups) {
+            group.sort();
+            all << group;
+        }
+        all.sort();
+        QCOMPARE(all, QStringList({dir.filePath("a.bin"), dir.filePath("b.bin"),
+                                   dir.filePath("e.txt"), dir.filePath("f.txt")}));
+    }
+
+    // Same name and size in different directories is a metadata match
+    void test_findMetadataGroups() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(QDir(dir.path()).mkpath("one"));
+        QVERIFY(QDir(dir.path()).mkpath("two"));
+
+        writeFile(dir.filePath("one/report.pdf"), "12345");
+        writeFile(dir.filePath("two/report.pdf"), "abcde");
+        writeFile(dir.filePath("two/notes.txt"), "12345");
+        writeFile(dir.filePath("one/notes.txt"), "123");
+
+        FileManager manager;
+        QSignalSpy groupsSpy(&manager, &FileManager::duplicateGroupsFound);
+        QList<QStringList> groups = manager.findMetadataGroups(dir.path());
+        QCOMPARE(groups.size(), 1);
+        QCOMPARE(groupsSpy.size(), 1);
+        QStringList group = groups.first();
+        group.sort();
+        QCOMPARE(group, QStringList({dir.filePath("one/report.pdf"), dir.filePath("two/report.pdf")}));
+
+        manager.setMetadataKeys(MetadataIndex::Size);
+        QCOMPARE(manager.findMetadataGroups(dir.path()).size(), 1);
+        QCOMPARE(manager.findMetadataGroups(dir.path()).first().size(), 3);
+    }
+
+    // Byte comparison must tell apart files that only differ in the middle
+    void test_confirmByContent() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        QByteArray content(3 * ContentComparator::ChunkSize + 5, 'q');
+        QByteArray changed = content;
+        changed[ContentComparator::ChunkSize + 7] = 'r';
+        writeFile(dir.filePath("a.bin"), content);
+        writeFile(dir.filePath("b.bin"), content);
+        writeFile(dir.filePath("c.bin"), changed);
+        writeFile(dir.filePath("d.bin"), changed);
+        writeFile(dir.filePath("e.bin"), content);
+
+        FileManager manager;
+        manager.setConfirmationMode(FileManager::ConfirmationMode::ConfirmByContent);
+        QList<QStringList> groups = manager.findDuplicateGroups(dir.path());
+        QCOMPARE(groups.size(), 2);
+
+        QList<int> sizes;
+        for (const QStringList& group : groups) {
+            sizes << group.size();
+        }
+        std::sort(sizes.begin(), sizes.end());
+        QCOMPARE(sizes, QList<int>({2, 3}));
+
+        // Groups beyond the open file budget are compared in batches, and
+        // a file that cannot be opened is reported rather than dropped
+        const QByteArray tail = content.left(ContentComparator::ChunkSize + 3);
+        QByteArray otherTail = tail;
+        otherTail[otherTail.size() - 1] = 'x';
+        QVERIFY(QDir(dir.path()).mkpath("many"));
+        QStringList files;
+        for (int i = 0; i < 2 * ContentComparator::MaxOpenFiles + 5; ++i) {
+            files.append(dir.filePath(QString("many/%1.bin").arg(i)));
+            writeFile(files.last(), i % 3 == 0 ? otherTail : tail);
+        }
+        files.insert(7, dir.filePath("many/missing.bin"));
+        ContentComparator comparator;
+        sizes.clear();
+        for (const QStringList& group : comparator.partition(files)) {
+            sizes << group.size();
+        }
+        std::sort(sizes.begin(), sizes.end());
+        QCOMPARE(sizes, QList<int>({45, 88}));
+        QCOMPARE(comparator.unreadableFiles(), QStringList{dir.filePath("many/missing.bin")});
+    }
+
+    // A rescan of an unchanged tree must be served entirely from the hash cache
+    void test_hashCacheReuse() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        QByteArray content(32 * 1024, 'x');
+        writeFile(dir.filePath("a.bin"), content);
+        writeFile(dir.filePath("b.bin"), content);
+
+        FileManager manager;
+        manager.hashCache().clear();
+        QCOMPARE(manager.findDuplicateGroups(dir.path()).size(), 1);
+        QVERIFY(manager.hashCache().misses() > 0);
+
+        FileManager rescan;
+        QCOMPARE(rescan.findDuplicateGroups(dir.path()).size(), 1);
+        QCOMPARE(rescan.hashCache().misses(), quint64(0));
+        QCOMPARE(rescan.hashCache().hits(), quint64(4));
+
+        // A memory-bounded scan reads the cache but adds nothing to it
+        writeFile(dir.filePath("c.bin"), QByteArray(32 * 1024, 'y'));
+        writeFile(dir.filePath("d.bin"), QByteArray(32 * 1024, 'y'));
+        FileManager bounded;
+        bounded.setIndexMemoryLimit(1024 * 1024);
+        QCOMPARE(bounded.findDuplicateGroups(dir.path()).size(), 2);
+        QCOMPARE(bounded.hashCache().hits(), quint64(4));
+        FileManager after;
+        QCOMPARE(after.findDuplicateGroups(dir.path()).size(), 2);
+        QCOMPARE(after.hashCache().misses(), quint64(4));
+
+        // Two caches on one file each keep the other's entries when saving
+        const QString cachePath = dir.filePath("shared.bin");
+        const HashCache::FileStamp stampA = HashCache::stampFor(dir.filePath("a.bin"));
+        const HashCache::FileStamp stampC = HashCache::stampFor(dir.filePath("c.bin"));
+        HashCache first(cachePath);
+        HashCache second(cachePath);
+        QVERIFY(first.fullHash(stampA, 0).isEmpty());
+        QVERIFY(second.fullHash(stampC, 0).isEmpty());
+        first.insertFullHash(stampA, 0, "first");
+        second.insertFullHash(stampC, 0, "second");
+        QVERIFY(first.save());
+        QVERIFY(second.save());
+        HashCache merged(cachePath);
+        QCOMPARE(merged.fullHash(stampA, 0), QByteArray("first"));
+        QCOMPARE(merged.fullHash(stampC, 0), QByteArray("second"));
+    }
+
+    // Nested files are found, symlinks are ignored and hardlinks reported once
+    void test_directoryWalker() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QVERIFY(QDir(dir.path()).mkpath("a/b/c"));
+
+        writeFile(dir.filePath("top.txt"), "top");
+        writeFile(dir.filePath("a/b/c/deep.txt"), "deep");
+        QVERIFY(QFile::link(dir.filePath("top.txt"), dir.filePath("a/link.txt")));
+#ifdef Q_OS_UNIX
+        QCOMPARE(::link(QFile::encodeName(dir.filePath("top.txt")).constData(),
+                        QFile::encodeName(dir.filePath("a/b/hard.txt")).constData()), 0);
+#endif
+
+        QStringList found;
+        DirectoryWalker walker(dir.path());
+        QVERIFY(walker.walk([&found](const DirectoryWalker::Entry& entry) {
+            found << entry.path;
+            return true;
+        }));
+        QCOMPARE(found.size(), 2);
+        QVERIFY(found.contains(dir.filePath("a/b/c/deep.txt")));
+
+        DirectoryWalker flat(dir.path(), DirectoryWalker::StatFiles);
+        int flatCount = 0;
+        flat.walk([&flatCount](const DirectoryWalker::Entry&) {
+            ++flatCount;
+            return true;
+        });
+        QCOMPARE(flatCount, 1);
+
+        // Deeper than the descriptor budget, with files left on the way back up
+        QString deep = dir.filePath("deep");
+        for (int level = 0; level < 2 * DirectoryWalker::MaxOpenDirectories; ++level) {
+            QVERIFY(QDir().mkpath(deep));
+            writeFile(deep + "/file.txt", "level");
+            deep += "/d";
+        }
+        DirectoryWalker deepWalker(dir.filePath("deep"));
+        int deepCount = 0;
+        QVERIFY(deepWalker.walk([&deepCount](const DirectoryWalker::Entry&) {
+            ++deepCount;
+            return true;
+        }));
+        QCOMPARE(deepCount, 2 * DirectoryWalker::MaxOpenDirectories);
+        QCOMPARE(deepWalker.errors(), quint64(0));
+    }
+
+    // Async scans report their groups and completion through the job handle
+    void test_findDuplicatesAsync() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        writeFile(dir.filePath("a.txt"), "same");
+        writeFile(dir.filePath("b.txt"), "same");
+
+        ScanJob *job = testFileManager->findDuplicatesAsync(dir.path());
+        QSignalSpy groupsSpy(job, &ScanJob::duplicatesFound);
+        QSignalSpy finishedSpy(job, &ScanJob::finished);
+        QVERIFY(finishedSpy.wait(5000));
+
+        QCOMPARE(groupsSpy.size(), 1);
+        QCOMPARE(groupsSpy.first().first().value<QList<QStringList>>().size(), 1);
+        QCOMPARE(finishedSpy.first().first().toBool(), true);
+        QVERIFY(job->isFinished());
+        delete job;
+    }
+
+    // A cancelled job finishes without delivering results
+    void test_cancelAsync() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        writeFile(dir.filePath("a.txt"), "same");
+        writeFile(dir.filePath("b.txt"), "same");
+
+        ScanJob *job = testFileManager->findDuplicatesAsync(dir.path());
+        QSignalSpy groupsSpy(job, &ScanJob::duplicatesFound);
+        QSignalSpy finishedSpy(job, &ScanJob::finished);
+        job->cancel();
+        QVERIFY(finishedSpy.wait(5000));
+
+        QCOMPARE(groupsSpy.size(), 0);
+        QCOMPARE(finishedSpy.first().first().toBool(), false);
+        delete job;
+    }
+
+    // Groups are revealed in batches and check states map back to paths
+    void test_duplicateResultModel() {
+        DuplicateResultModel model;
+        QList<QStringList> groups;
+        for (int i = 0; i < DuplicateResultModel::FetchBatch + 10; ++i) {
+            groups << QStringList({QString("/a/%1.txt").arg(i), QString("/b/%1.txt").arg(i)});
+        }
+        model.appendGroups(groups);
+
+        QCOMPARE(model.groupCount(), groups.size());
+        QCOMPARE(model.rowCount(), int(DuplicateResultModel::FetchBatch));
+        QVERIFY(model.canFetchMore(QModelIndex()));
+        model.fetchMore(QModelIndex());
+        QCOMPARE(model.rowCount(), groups.size());
+
+        const QModelIndex group = model.index(3, 0);
+        QCOMPARE(model.rowCount(group), 2);
+        QCOMPARE(model.filePath(model.index(1, 0, group)), QString("/b/3.txt"));
+
+        QVERIFY(model.setData(model.index(1, 0, group), Qt::Checked, Qt::CheckStateRole));
+        QCOMPARE(model.data(group, Qt::CheckStateRole).toInt(), int(Qt::PartiallyChecked));
+        QCOMPARE(model.checkedPaths(), QStringList({"/b/3.txt"}));
+
+        QVERIFY(model.setData(group, Qt::Checked, Qt::CheckStateRole));
+        QCOMPARE(model.checkedPaths().size(), 2);
+
+        // A source is only asked for the groups that come into view
+        DuplicateResultModel deferred;
+        int requested = 0;
+        deferred.setGroupSource(groups.size(), [&](int first, int count) {
+            requested += count;
+            return groups.mid(first, count);
+        });
+        QCOMPARE(requested, int(DuplicateResultModel::FetchBatch));
+        QCOMPARE(deferred.rowCount(), int(DuplicateResultModel::FetchBatch));
+        QVERIFY(deferred.canFetchMore(QModelIndex()));
+        deferred.fetchMore(QModelIndex());
+        QCOMPARE(requested, groups.size());
+        QCOMPARE(deferred.rowCount(), groups.size());
+        QVERIFY(!deferred.canFetchMore(QModelIndex()));
+        QCOMPARE(deferred.filePath(deferred.index(1, 0, deferred.index(3, 0))), QString("/b/3.txt"));
+    }
+
+    // Results come back in submission order regardless of completion order
+    void test_hashEngineOrdering() {
+        HashEngine engine;
+        engine.setMaxThreadCount(4);
+
+        QStringList files;
+        QVector<qint64> sizes;
+        for (int i = 0; i < 100; ++i) {
+            files << QString::number(i);
+            sizes << (i % 10 == 0 ? HashEngine::LargeFileThreshold : i);
+        }
+
+        int lastProgress = 0;
+        connect(&engine, &HashEngine::progressUpdated, this, [&lastProgress](int progress, int) {
+            QVERIFY(progress >= lastProgress);
+            lastProgress = progress;
+        });
+
+        QVector<QByteArray> results = engine.hashFiles(files, sizes,
+            [](const QString& filePath, qint64) {
+                QThread::usleep(100 * (filePath.toInt() % 7));
+                return filePath.toUtf8();
+            });
+
+        QCOMPARE(lastProgress, files.size());
+        QCOMPARE(results.size(), files.size());
+        for (int i = 0; i < files.size(); ++i) {
+            QCOMPARE(results[i], files[i].toUtf8());
+        }
+    }
+
+    // Every SIMD kernel must agree with the scalar one however the input is split
+    void test_fastHashKernels() {
+        QByteArray data(100000, Qt::Uninitialized);
+        for (int i = 0; i < data.size(); ++i) {
+            data[i] = char((i * 131) ^ (i >> 5));
+        }
+
+        for (int length : {0, 1, 63, 64, 65, 511, 512, 513, 4096, 100000}) {
+            FastHash reference(FastHash::Scalar);
+            reference.addData(data.constData(), length);
+            const QByteArray expected = reference.result();
+            QCOMPARE(expected.size(), FastHash::DigestLength);
+
+            for (FastHash::Kernel kernel : {FastHash::Sse2, FastHash::Avx2}) {
+                if (!FastHash::isSupported(kernel)) {
+                    continue;
+                }
+                FastHash hash(kernel);
+                for (int offset = 0; offset < length; offset += 77) {
+                    hash.addData(data.constData() + offset, qMin(77, length - offset));
+                }
+                QCOMPARE(hash.result(), expected);
+            }
+        }
+    }
+
+    // Duplicates are re-verified against the kept file before they are linked
+    void test_removeDuplicateGroups() {
+        QTemporaryDir temp;
+        QVERIFY(temp.isValid());
+        QDir dir(temp.path());
+        writeFile(dir.filePath("keep.bin"), "same content");
+        writeFile(dir.filePath("copy.bin"), "same content");
+        writeFile(dir.filePath("edited.bin"), "same c0ntent");
+
+        FileManager manager;
+        manager.hashCache().setEnabled(false);
+        manager.setRemovalMode(DuplicateRemover::Mode::Hardlink);
+        DuplicateRemover::Group group{dir.filePath("keep.bin"),
+                                      {dir.filePath("copy.bin"), dir.filePath("edited.bin")}};
+        QVERIFY(!manager.removeDuplicates(QList<DuplicateRemover::Group>{group}));
+
+#ifdef Q_OS_LINUX
+        const HashCache::FileStamp kept = HashCache::stampFor(dir.filePath("keep.bin"));
+        const HashCache::FileStamp linked = HashCache::stampFor(dir.filePath("copy.bin"));
+        QCOMPARE(linked.inode, kept.inode);
+#endif
+        QCOMPARE(readFile(dir.filePath("edited.bin")), QByteArray("same c0ntent"));
+        QVERIFY(QFile::exists(dir.filePath("keep.bin")));
+        manager.setRemovalMode(DuplicateRemover::Mode::Delete);
+
+        // A group must keep a copy: one without an original, or whose only
+        // duplicate is the original seen through a symlinked directory, is refused
+        writeFile(dir.filePath("only.bin"), "only");
+        QVERIFY(QFile::link(temp.path(), dir.filePath("alias")));
+        QVERIFY(!manager.removeDuplicates(QList<DuplicateRemover::Group>{
+            DuplicateRemover::Group{QString(), {dir.filePath("only.bin")}}}));
+        QVERIFY(!manager.removeDuplicates(QList<DuplicateRemover::Group>{
+            DuplicateRemover::Group{dir.filePath("only.bin"), {dir.filePath("alias/only.bin")}}}));
+        QCOMPARE(readFile(dir.filePath("only.bin")), QByteArray("only"));
+
+        // An original edited after verification keeps its duplicate
+        writeFile(dir.filePath("first.bin"), "verified");
+        writeFile(dir.filePath("second.bin"), "verified");
+        bool edited = false;
+        DuplicateRemover remover(DuplicateRemover::Mode::Delete);
+        remover.run({DuplicateRemover::Group{dir.filePath("first.bin"), {dir.filePath("second.bin")}}},
+                    [&](int done, int total) {
+            if (!edited && done == total) {
+                edited = true;
+                writeFile(dir.filePath("first.bin"), "edited afterwards");
+            }
+        });
+        QCOMPARE(remover.processedCount(), 0);
+        QCOMPARE(readFile(dir.filePath("second.bin")), QByteArray("verified"));
+
+        // Removing a symlink frees nothing
+        QVERIFY(QFile::link(dir.filePath("second.bin"), dir.filePath("link.bin")));
+        writeFile(dir.filePath("third.bin"), "verified");
+        DuplicateRemover links(DuplicateRemover::Mode::Delete);
+        QCOMPARE(links.run({DuplicateRemover::Group{dir.filePath("third.bin"), {dir.filePath("link.bin")}}}), 1);
+        QCOMPARE(links.bytesReclaimed(), qint64(0));
+        QVERIFY(QFile::exists(dir.filePath("second.bin")));
+    }
+
+    // Type, text statistics and per-directory totals come from one pass
+    void test_fileAnalyzer() {
+        QTemporaryDir temp;
+        QVERIFY(temp.isValid());
+        QDir dir(temp.path());
+        QVERIFY(dir.mkpath("big"));
+        writeFile(dir.filePath("notes.txt"), "one\ntwo\nthree\n");
+        writeFile(dir.filePath("big/image.png"), QByteArray("\x89PNG\r\n\x1a\n", 8) + QByteArray(4000, '\0'));
+
+        FileAnalyzer analyzer;
+        const FileAnalyzer::Report report = analyzer.analyze(temp.path());
+        QCOMPARE(report.files.size(), 2);
+        QCOMPARE(report.textFiles, 1);
+        QCOMPARE(report.textLines, qint64(3));
+        QCOMPARE(report.bytesByType.value("image/png"), qint64(4008));
+        QCOMPARE(report.directories.first().path, QDir::cleanPath(temp.path()));
+        QCOMPARE(report.directories.first().totalSize, qint64(4022));
+
+        const FileAnalyzer::FileStats png = analyzer.analyzeFile(dir.filePath("big/image.png"));
+        QVERIFY(!png.text);
+        QVERIFY(png.compressibility < 0.1);
+
+        // Cut off mid-line, the head has one complete line in 6 of 12 bytes
+        writeFile(dir.filePath("head.txt"), "abcd\nefghij\n");
+        FileAnalyzer head;
+        head.setMaxBytesPerFile(6);
+        const FileAnalyzer::FileStats partial = head.analyzeFile(dir.filePath("head.txt"));
+        QVERIFY(partial.readable);
+        QCOMPARE(partial.lines, qint64(2));
+
+        QByteArray data(5000, Qt::Uninitialized);
+        for (int i = 0; i < data.size(); ++i) {
+            data[i] = char((i / 3) % 5);
+        }
+        const uchar *bytes = reinterpret_cast<const uchar *>(data.constData());
+        const qint64 expected = FileAnalyzer::countRepeats(FastHash::Scalar, bytes, data.size(), -1);
+        for (FastHash::Kernel kernel : {FastHash::Sse2, FastHash::Avx2}) {
+            if (FastHash::isSupported(kernel)) {
+                QCOMPARE(FileAnalyzer::countRepeats(kernel, bytes, data.size(), -1), expected);
+            }
+        }
+    }
+
+    // An edit in the middle leaves most content-defined chunks intact
+    void test_findSimilarGroups() {
+        QTemporaryDir temp;
+        QVERIFY(temp.isValid());
+        QDir dir(temp.path());
+
+        QByteArray original(512 * 1024, Qt::Uninitialized);
+        QByteArray unrelated(512 * 1024, Qt::Uninitialized);
+        quint64 state = 1;
+        for (int i = 0; i < original.size(); ++i) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            original[i] = char(state >> 56);
+            unrelated[i] = char(state >> 48);
+        }
+        QByteArray edited = original;
+        edited.insert(200000, QByteArray(300, 'x'));
+        edited.append("appended log line\n");
+
+        writeFile(dir.filePath("report.doc"), original);
+        writeFile(dir.filePath("report-resaved.doc"), edited);
+        writeFile(dir.filePath("other.bin"), unrelated);
+
+        ContentChunker chunker;
+        chunker.addData(original.constData(), original.size());
+        const SimilarityIndex::Signature first = chunker.signature();
+        chunker.reset();
+        chunker.addData(edited.constData(), edited.size());
+        QVERIFY(SimilarityIndex::estimate(first, chunker.signature()) > 0.7);
+
+        FileManager manager;
+        manager.hashCache().setEnabled(false);
+        const QList<QStringList> groups = manager.findSimilarGroups(temp.path());
+        QCOMPARE(groups.size(), 1);
+        QCOMPARE(groups.first().size(), 2);
+        QVERIFY(!groups.first().join(' ').contains("other.bin"));
+    }
+
+    // A watch job regroups files written after the initial scan
+    void test_watchDuplicates() {
+#ifndef Q_OS_LINUX
+        QSKIP("Watch mode needs inotify");
+#endif
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        writeFile(dir.filePath("a.txt"), "same");
+        writeFile(dir.filePath("b.txt"), "same");
+        writeFile(dir.filePath("c.txt"), "different");
+
+        ScanJob *job = testFileManager->watchDuplicatesAsync(dir.path());
+        QSignalSpy groupsSpy(job, &ScanJob::duplicatesFound);
+        QSignalSpy changedSpy(job, &ScanJob::duplicatesChanged);
+        QSignalSpy finishedSpy(job, &ScanJob::finished);
+        QVERIFY(groupsSpy.wait(5000));
+
+        DuplicateResultModel model;
+        model.appendGroups(groupsSpy.first().first().value<QList<QStringList>>());
+        QCOMPARE(model.groupCount(), 1);
+        QCOMPARE(model.fileCount(), 2);
+
+        writeFile(dir.filePath("c.txt"), "same");
+        QVERIFY(changedSpy.wait(10000));
+        model.replaceGroups(changedSpy.first().at(0).toStringList(),
+                            changedSpy.first().at(1).value<QList<QStringList>>());
+        QCOMPARE(model.groupCount(), 1);
+        QCOMPARE(model.fileCount(), 3);
+
+        QVERIFY(QFile::remove(dir.filePath("a.txt")));
+        QVERIFY(changedSpy.wait(10000));
+        model.replaceGroups(changedSpy.last().at(0).toStringList(),
+                            changedSpy.last().at(1).value<QList<QStringList>>());
+        QCOMPARE(model.groupCount(), 1);
+        QCOMPARE(model.fileCount(), 2);
+
+        // A symlink is not a copy of its target
+        QVERIFY(QFile::link(dir.filePath("b.txt"), dir.filePath("link.txt")));
+        writeFile(dir.filePath("d.txt"), "same");
+        QVERIFY(changedSpy.wait(10000));
+        model.replaceGroups(changedSpy.last().at(0).toStringList(),
+                            changedSpy.last().at(1).value<QList<QStringList>>());
+        QCOMPARE(model.groupCount(), 1);
+        QCOMPARE(model.fileCount(), 3);
+
+        job->cancel();
+        QVERIFY(finishedSpy.wait(5000));
+        QCOMPARE(finishedSpy.first().first().toBool(), true);
+        delete job;
+    }
+
+    // Removing the watched directory ends the watch and clears its groups
+    void test_watchRootRemoved() {
+#ifndef Q_OS_LINUX
+        QSKIP("Watch mode needs inotify");
+#endif
+        QTemporaryDir temp;
+        QVERIFY(temp.isValid());
+        const QString root = QDir(temp.path()).filePath("watched");
+        QVERIFY(QDir().mkpath(root));
+        writeFile(root + "/a.txt", "same");
+        writeFile(root + "/b.txt", "same");
+
+        ScanJob *job = testFileManager->watchDuplicatesAsync(root);
+        QSignalSpy groupsSpy(job, &ScanJob::duplicatesFound);
+        QSignalSpy changedSpy(job, &ScanJob::duplicatesChanged);
+        QSignalSpy finishedSpy(job, &ScanJob::finished);
+        QVERIFY(groupsSpy.wait(5000));
+
+        QVERIFY(QDir(root).removeRecursively());
+        QVERIFY(finishedSpy.wait(10000));
+        QCOMPARE(finishedSpy.first().first().toBool(), false);
+        QVERIFY(!changedSpy.isEmpty());
+        QVERIFY(changedSpy.last().at(1).value<QList<QStringList>>().isEmpty());
+        delete job;
+    }
+
+    // Scans count what they did per stage and export it as a Chrome trace
+    void test_scanStats() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        writeFile(dir.filePath("a.bin"), QByteArray(20000, 'x'));
+        writeFile(dir.filePath("b.bin"), QByteArray(20000, 'x'));
+        writeFile(dir.filePath("c.bin"), "unique");
+
+        FileManager manager;
+        manager.hashCache().setEnabled(false);
+        manager.scanStats().setTracing(true);
+        QCOMPARE(manager.findDuplicateGroups(dir.path()).size(), 1);
+
+        const ScanStats::Snapshot stats = manager.scanStats().snapshot();
+        QCOMPARE(stats.counters[ScanStats::FilesListed], quint64(3));
+        QCOMPARE(stats.counters[ScanStats::FilesHashed], quint64(4));
+        QVERIFY(stats.counters[ScanStats::BytesRead] >= 40000);
+        QCOMPARE(stats.counters[ScanStats::GroupsFound], quint64(1));
+        QCOMPARE(stats.stages[ScanStats::Walk].count, quint64(1));
+        QVERIFY(stats.stages[ScanStats::Read].count >= 4);
+        QVERIFY(stats.stages[ScanStats::Read].percentileNs(0.99) > 0);
+        QVERIFY(stats.summary().contains("3 files listed"));
+
+        const QString tracePath = dir.filePath("trace.json");
+        QVERIFY(manager.scanStats().writeChromeTrace(tracePath));
+        const QJsonObject trace = QJsonDocument::fromJson(readFile(tracePath)).object();
+        const QJsonArray events = trace["traceEvents"].toArray();
+        QVERIFY(events.size() > 4);
+        QVERIFY(std::any_of(events.begin(), events.end(), [](const QJsonValue& event) {
+            return event.toObject()["name"].toString() == "hash";
+        }));
+    }
+
+    void test_batchReader() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QStringList files;
+        QList<QByteArray> contents;
+        for (int i = 0; i < 40; ++i) {
+            QByteArray data(i * 7919 % 50000, Qt::Uninitialized);
+            for (int j = 0; j < data.size(); ++j) {
+                data[j] = char(j * 31 + i);
+            }
+            files.append(dir.filePath(QString("f%1.bin").arg(i)));
+            contents.append(data);
+            writeFile(files.last(), data);
+        }
+        files.append(dir.filePath("missing.bin"));
+        files.append(dir.path());
+
+        for (BatchReader::Backend backend : {BatchReader::Backend::IoUring, BatchReader::Backend::ThreadPool}) {
+            if (!BatchReader::isSupported(backend)) {
+                continue;
+            }
+            BatchReader reader(backend);
+            QCOMPARE(reader.backend(), backend);
+            reader.setQueueDepth(8);
+            reader.setChunkSize(4096);
+            QVector<QByteArray> read(files.size());
+            QVector<int> done(files.size(), -1);
+            QMutex mutex;
+            QVERIFY(reader.read(files,
+                [&](int index, const char *data, qint64 length) {
+                    QMutexLocker locker(&mutex);
+                    read[index].append(data, length);
+                },
+                [&](int index, bool ok) {
+                    QMutexLocker locker(&mutex);
+                    QCOMPARE(done[index], -1);
+                    done[index] = ok;
+                }));
+            for (int i = 0; i < contents.size(); ++i) {
+                QCOMPARE(done[i], 1);
+                QCOMPARE(read[i], contents[i]);
+            }
+            QCOMPARE(done[files.size() - 2], 0);
+            QCOMPARE(done[files.size() - 1], 0);
+        }
+
+        // Both backends give the same groups as the single-file hash
+        writeFile(dir.filePath("copy.bin"), contents[5]);
+        FileManager manager;
+        manager.hashCache().setEnabled(false);
+        manager.setReadBackend(BatchReader::Backend::ThreadPool);
+        const QList<QStringList> groups = manager.findDuplicateGroups(dir.path());
+        QCOMPARE(groups.size(), 1);
+        QCOMPARE(groups.first().size(), 2);
+        manager.setReadBackend(BatchReader::Backend::Auto);
+        QCOMPARE(manager.findDuplicateGroups(dir.path()), groups);
+        QCOMPARE(manager.calculateFileHash(files[5]), manager.calculateFileHash(dir.filePath("copy.bin")));
+    }
+
+    void test_directorySizes() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QDir root(dir.path());
+        QVERIFY(root.mkpath("a/b/c"));
+        QVERIFY(root.mkpath("d"));
+        writeFile(dir.filePath("top.bin"), QByteArray(100, 'x'));
+        writeFile(dir.filePath("a/one.bin"), QByteArray(1000, 'x'));
+        writeFile(dir.filePath("a/b/c/two.bin"), QByteArray(2000, 'x'));
+        writeFile(dir.filePath("d/three.bin"), QByteArray(30, 'x'));
+
+        DirectorySizeScanner scanner;
+        scanner.setThreadCount(3);
+        int published = 0;
+        connect(&scanner, &DirectorySizeScanner::sizesChanged, this,
+                [&published](const QStringList& directories) { published += directories.size(); });
+        DirectorySizeTree::Totals totals;
+        QVERIFY(!scanner.totals(dir.path(), totals));
+        scanner.request(dir.path());
+        QTRY_VERIFY(scanner.isIdle() && scanner.totals(dir.path(), totals));
+        QCOMPARE(totals.bytes, qint64(3130));
+        QCOMPARE(totals.files, qint64(4));
+        QCOMPARE(totals.directories, qint64(4));
+        QVERIFY(scanner.totals(dir.filePath("a/b"), totals));
+        QCOMPARE(totals.bytes, qint64(2000));
+        QTRY_VERIFY(published >= 5);
+
+        // Only the directory whose mtime moved is read again; the
+        // difference reaches every ancestor
+        QThread::msleep(50);
+        writeFile(dir.filePath("a/b/c/four.bin"), QByteArray(500, 'x'));
+        scanner.revalidate(dir.filePath("a"));
+        QTRY_VERIFY(scanner.isIdle());
+        QVERIFY(scanner.totals(dir.path(), totals));
+        QCOMPARE(totals.bytes, qint64(3130));
+        scanner.revalidate(dir.filePath("a/b/c"));
+        QTRY_VERIFY(scanner.isIdle());
+        QVERIFY(scanner.totals(dir.path(), totals));
+        QCOMPARE(totals.bytes, qint64(3630));
+        QCOMPARE(totals.files, qint64(5));
+        QVERIFY(scanner.totals(dir.filePath("a"), totals));
+        QCOMPARE(totals.bytes, qint64(3500));
+
+        QVERIFY(QDir(dir.filePath("d")).removeRecursively());
+        scanner.revalidate(dir.path());
+        QTRY_VERIFY(scanner.isIdle());
+        QVERIFY(scanner.totals(dir.path(), totals));
+        QCOMPARE(totals.bytes, qint64(3600));
+        QCOMPARE(totals.directories, qint64(3));
+        QCOMPARE(scanner.state(dir.filePath("d")), DirectorySizeTree::State::Unknown);
+    }
+
+    // Past its memory limit the index spills sorted runs and merges them
+    // back; the bounded scan returns and reports the same groups as the
+    // in-memory one
+    void test_boundedDuplicateGroups() {
+        DigestIndex index(1);
+        HashCache::FileStamp stamp;
+        for (int i = 0; i < 20000; ++i) {
+            stamp.size = i % 5000;
+            stamp.inode = quint64(i);
+            QVERIFY(index.insert(stamp.size, QByteArray(16, char(i % 3 == 0)), QString("file%1").arg(i), stamp));
+        }
+        QVERIFY(index.runCount() > 0);
+        int groups = 0;
+        QVERIFY(index.forEachGroup([&groups](qint64 size, const QByteArray&, const QVector<DigestIndex::Item>& items) {
+            for (const DigestIndex::Item& item : items) {
+                if (item.stamp.size != size || item.path != QString("file%1").arg(item.stamp.inode)) {
+                    return false;
+                }
+            }
+            ++groups;
+            return true;
+        }));
+        // Each size holds four files, split 2+2 by the digest for every third size
+        QCOMPARE(groups, 5000 + 1667);
+        QCOMPARE(index.count(), qint64(0));
+
+        // A run cut short fails the merge instead of losing its files
+        QTemporaryDir spill;
+        QVERIFY(spill.isValid());
+        DigestIndex truncated(1, spill.path());
+        for (int i = 0; i < 20000; ++i) {
+            stamp.size = i % 5000;
+            QVERIFY(truncated.insert(stamp.size, QByteArray(16, 'x'), QString("file%1").arg(i), stamp));
+        }
+        const QFileInfoList runs = QDir(spill.path()).entryInfoList(QDir::Files);
+        QVERIFY(!runs.isEmpty());
+        QFile run(runs.first().filePath());
+        QVERIFY(run.resize(run.size() - 5));
+        QVERIFY(!truncated.forEachGroup([](qint64, const QByteArray&, const QVector<DigestIndex::Item>&) {
+            return true;
+        }));
+        QVERIFY(truncated.errorString().contains("Truncated run"));
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QByteArray content(64 * 1024, 'a');
+        QByteArray middleChanged = content;
+        middleChanged[content.size() / 2] = 'b';
+        writeFile(dir.filePath("a.bin"), content);
+        writeFile(dir.filePath("b.bin"), content);
+        writeFile(dir.filePath("c.bin"), middleChanged);
+        writeFile(dir.filePath("d.txt"), "small");
+        writeFile(dir.filePath("e.txt"), "small");
+        writeFile(dir.filePath("f.txt"), "");
+        writeFile(dir.filePath("g.txt"), "");
+
+        auto flattened = [](const QList<QStringList>& groups) {
+            QStringList all;
+            for (QStringList group : groups) {
+                group.sort();
+                all << group.join('|');
+            }
+            all.sort();
+            return all;
+        };
+        FileManager manager;
+        manager.hashCache().setEnabled(false);
+        for (FileManager::ConfirmationMode mode : {FileManager::ConfirmationMode::ConfirmByHash,
+                                                   FileManager::ConfirmationMode::ConfirmByContent}) {
+            manager.setConfirmationMode(mode);
+            manager.setIndexMemoryLimit(0);
+            const QStringList unbounded = flattened(manager.findDuplicateGroups(dir.path()));
+            QCOMPARE(unbounded, QStringList({dir.filePath("a.bin") + '|' + dir.filePath("b.bin"),
+                                             dir.filePath("d.txt") + '|' + dir.filePath("e.txt"),
+                                             dir.filePath("f.txt") + '|' + dir.filePath("g.txt")}));
+
+            manager.setIndexMemoryLimit(1);
+            QSignalSpy found(&manager, &FileManager::duplicateGroupsFound);
+            QCOMPARE(flattened(manager.findDuplicateGroups(dir.path())), unbounded);
+            QList<QStringList> reported;
+            for (const QList<QVariant>& arguments : std::as_const(found)) {
+                reported += arguments.at(0).value<QList<QStringList>>();
+            }
+            QCOMPARE(flattened(reported), unbounded);
+            QCOMPARE(manager.findDuplicatesByContent(dir.path()).size(), 6);
+        }
+    }
+
+    // Roots are scanned as one tree; a root inside another adds nothing
+    void test_multiRootScan() {
+        QTemporaryDir first;
+        QTemporaryDir second;
+        QVERIFY(first.isValid() && second.isValid());
+        QVERIFY(QDir(first.path()).mkpath("nested"));
+        QByteArray content(64 * 1024, 'm');
+        writeFile(first.filePath("nested/a.bin"), content);
+        writeFile(second.filePath("b.bin"), content);
+        writeFile(second.filePath("c.bin"), content + "tail");
+
+        FileManager manager;
+        manager.hashCache().setEnabled(false);
+        const QList<QStringList> groups = manager.findDuplicateGroups(
+            QStringList{first.filePath("nested"), second.path(), first.path(), second.path() + "/"});
+        QCOMPARE(groups.size(), 1);
+        QStringList group = groups.first();
+        group.sort();
+        QCOMPARE(group, QStringList({first.filePath("nested/a.bin"), second.filePath("b.bin")}));
+
+        // A root that is a symlink to another is the same root, its files
+        // are not their own duplicates
+        QTemporaryDir third;
+        QVERIFY(QFile::link(second.path(), third.filePath("alias")));
+        QVERIFY(manager.findDuplicateGroups(QStringList{second.path(), third.filePath("alias")}).isEmpty());
+
+        const StorageDevice::Budget rotational = StorageDevice::budget(StorageDevice::Kind::Rotational, 8);
+        QCOMPARE(rotational.threads, 1);
+        QCOMPARE(StorageDevice::budget(StorageDevice::Kind::SolidState, 8).threads, 8);
+        QVERIFY(!StorageDevice::kindName(StorageDevice::detect(first.path())).isEmpty());
+    }
+
+    // Snapshots round-trip through the mapped file and merge across hosts
+    void test_scanSnapshot() {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        ScanSnapshot::Writer writer(0, 16);
+        const int alpha = writer.addHost("alpha");
+        const int beta = writer.addHost("beta");
+        const QByteArray digest(16, 'd');
+        const qint64 first = writer.addFile("/data/a.bin", 100, 5, digest, alpha);
+        const qint64 second = writer.addFile("/backup/a.bin", 100, 7, digest, beta);
+        writer.addFile("/data/lonely.bin", 3, 9, QByteArray(), alpha);
+        writer.addGroup({first, second});
+        QVERIFY(writer.save(dir.filePath("hosts.snapshot")));
+
+        ScanSnapshot snapshot;
+        QVERIFY(snapshot.load(dir.filePath("hosts.snapshot")));
+        QCOMPARE(snapshot.fileCount(), qint64(3));
+        QCOMPARE(snapshot.hosts(), QStringList({"alpha", "beta"}));
+        QCOMPARE(snapshot.path(1), QString("/backup/a.bin"));
+        QCOMPARE(snapshot.mtimeNs(1), qint64(7));
+        QCOMPARE(snapshot.digest(0), digest);
+        QVERIFY(snapshot.digest(2).isEmpty());
+        QCOMPARE(snapshot.groups(), QList<QStringList>{QStringList({"alpha:/data/a.bin", "beta:/backup/a.bin"})});
+
+        QFile corrupt(dir.filePath("hosts.snapshot"));
+        QVERIFY(corrupt.open(QIODevice::ReadWrite));
+        corrupt.resize(corrupt.size() - 8);
+        corrupt.close();
+        QVERIFY(!snapshot.load(dir.filePath("hosts.snapshot")));
+        QVERIFY(!snapshot.isLoaded());
+
+        // A snapshot of the other byte order is refused
+        QVERIFY(writer.save(dir.filePath("swapped.snapshot")));
+        QFile swapped(dir.filePath("swapped.snapshot"));
+        QVERIFY(swapped.open(QIODevice::ReadWrite));
+        QVERIFY(swapped.seek(4));
+        swapped.write(QByteArray("\x04\x03\x02\x01", 4));
+        swapped.close();
+        QVERIFY(!snapshot.load(dir.filePath("swapped.snapshot")));
+        QVERIFY(snapshot.errorString().contains("byte order"));
+
+        // Two exports of one host share no file but one content
+        QVERIFY(QDir(dir.path()).mkpath("one") && QDir(dir.path()).mkpath("two"));
+        const QByteArray content(32 * 1024, 's');
+        writeFile(dir.filePath("one/x.bin"), content);
+        writeFile(dir.filePath("one/y.bin"), "only here");
+        writeFile(dir.filePath("two/z.bin"), content);
+        FileManager manager;
+        manager.hashCache().setEnabled(false);
+        QVERIFY(manager.exportSnapshot({dir.filePath("one")}, dir.filePath("one.snapshot")));
+        QTest::qSleep(5);
+        QVERIFY(manager.exportSnapshot({dir.filePath("two")}, dir.filePath("two.snapshot")));
+        QVERIFY(snapshot.load(dir.filePath("one.snapshot")));
+        QCOMPARE(snapshot.fileCount(), qint64(2));
+        QCOMPARE(snapshot.groupCount(), qint64(0));
+
+        const int algorithm = snapshot.algorithm();
+        const int digestLength = snapshot.digestLength();
+
+        // The host's newer export replaces the older one
+        QSignalSpy found(&manager, &FileManager::duplicateGroupsFound);
+        QVERIFY(manager.mergeSnapshots({dir.filePath("one.snapshot"), dir.filePath("two.snapshot")},
+                                       dir.filePath("merged.snapshot")));
+        QCOMPARE(found.size(), 0);
+        QVERIFY(snapshot.load(dir.filePath("merged.snapshot")));
+        QCOMPARE(snapshot.fileCount(), qint64(1));
+        QCOMPARE(snapshot.path(0), dir.filePath("two/z.bin"));
+
+        // Another host with the same content groups with it
+        ScanSnapshot::Writer other(algorithm, digestLength);
+        const int elsewhere = other.addHost("elsewhere");
+        other.addFile("/backup/z.bin", content.size(), 0, manager.calculateFileHash(dir.filePath("one/x.bin")), elsewhere);
+        QVERIFY(other.save(dir.filePath("other.snapshot")));
+        QVERIFY(manager.mergeSnapshots({dir.filePath("one.snapshot"), dir.filePath("other.snapshot")},
+                                       dir.filePath("merged.snapshot")));
+        QCOMPARE(found.size(), 1);
+        QStringList group = found.first().first().value<QList<QStringList>>().first();
+        group.sort();
+        QStringList expected{"elsewhere:/backup/z.bin", QSysInfo::machineHostName() + ':' + dir.filePath("one/x.bin")};
+        expected.sort();
+        QCOMPARE(group, expected);
+        QVERIFY(snapshot.load(dir.filePath("merged.snapshot")));
+        QCOMPARE(snapshot.fileCount(), qint64(3));
+        QCOMPARE(snapshot.groupCount(), qint64(1));
+
+        // A regular scan leaves its groups behind
+        manager.setSnapshotPath(dir.filePath("scan.snapshot"));
+        QCOMPARE(manager.findDuplicateGroups(QStringList{dir.filePath("one"), dir.filePath("two")}).size(), 1);
+        QVERIFY(snapshot.load(dir.filePath("scan.snapshot")));
+        QCOMPARE(snapshot.groupCount(), qint64(1));
+        QCOMPARE(snapshot.digest(snapshot.groupFiles(0).first()), manager.calculateFileHash(dir.filePath("one/x.bin")));
+    }
+
+    // Patterns are compiled once; bad ones are refused before any file moves
+    void test_renamePattern() {
+        QCOMPARE(RenamePattern("file_%n").targetName("/x/a.txt", 0), QString("file_001.txt"));
+        QCOMPARE(RenamePattern("%n{10,5,4}").targetName("/x/a.txt", 2), QString("0020.txt"));
+        QCOMPARE(RenamePattern("%c{%o} %u{x}%%").targetName("/x/my holiday.jpg", 0), QString("My Holiday X%.jpg"));
+        QCOMPARE(RenamePattern("%2-%1", "(\\w+)_(\\d+)").targetName("/x/img_42.png", 0), QString("42-img.png"));
+        QCOMPARE(RenamePattern("%o_%0", "\\d+").targetName("/x/backup.2024.tar", 0), QString("backup.2024_2024.tar"));
+        QString why;
+        QVERIFY(RenamePattern("%1", "(\\d+)").targetName("/x/abc.png", 0, &why).isEmpty());
+        QVERIFY(!why.isEmpty());
+        for (const QString& bad : {"%1", "%u", "%l{x", "%n{a}", "%n{1,1,99}", "%m{yyyy"}) {
+            QVERIFY2(!RenamePattern(bad).isValid(), qPrintable(bad));
+        }
+        QVERIFY(!RenamePattern("%n").readsFileDates());
+
+        QTemporaryDir temp;
+        QVERIFY(temp.isValid());
+        QDir dir(temp.path());
+        writeFile(dir.filePath("IMG_7.jpg"), "seven");
+        writeFile(dir.filePath("IMG_8.jpg"), "eight");
+        QFile stamped(dir.filePath("IMG_7.jpg"));
+        QVERIFY(stamped.open(QIODevice::ReadWrite));
+        QVERIFY(stamped.setFileTime(QDateTime(QDate(2021, 3, 4), QTime(5, 6, 7)), QFileDevice::FileModificationTime));
+        stamped.close();
+        QCOMPARE(RenamePattern("%m{yyyy-MM-dd}").targetName(dir.filePath("IMG_7.jpg"), 0), QString("2021-03-04.jpg"));
+        // No EXIF in there, so the date taken falls back to the mtime
+        QCOMPARE(RenamePattern("%t").targetName(dir.filePath("IMG_7.jpg"), 0), QString("20210304.jpg"));
+
+        // The preview only names the files it shows
+        QStringList many;
+        for (int i = 0; i < 100000; ++i) {
+            many.append(QString("/missing/f%1.txt").arg(i));
+        }
+        const QStringList preview = RenamePattern("%n_%o").preview(many, 5);
+        QCOMPARE(preview.size(), 5);
+        QCOMPARE(preview.last(), QString("005_f4.txt"));
+
+        QVERIFY(!testFileManager->batchRename({dir.filePath("IMG_7.jpg")}, "%u{x"));
+        QVERIFY(testFileManager->batchRename({dir.filePath("IMG_7.jpg"), dir.filePath("IMG_8.jpg")},
+                                             "photo_%1", "IMG_(\\d+)"));
+        QCOMPARE(readFile(dir.filePath("photo_7.jpg")), QByteArray("seven"));
+        QCOMPARE(readFile(dir.filePath("photo_8.jpg")), QByteArray("eight"));
+    }
+
     // Test finding duplicates by metadata
     void test_findDuplicatesByMetadata() {
         QString testDir = "test_directory";
@@ -51,6 +1055,17 @@ private slots:  // Test functions must be private slots
 
 private:
     FileManager* testFileManager;
+
+    static void writeFile(const QString& path, const QByteArray& data) {
+        QFile file(path);
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write(data);
+    }
+
+    static QByteArray readFile(const QString& path) {
+        QFile file(path);
+        return file.open(QFile::ReadOnly) ? file.readAll() : QByteArray();
+    }
 };
 
 // This macro is needed to run the tests